@@ -19,8 +19,6 @@ biquad_allpass *biquad_allpass_new(float f0, float Q, float mix, float sampleRat
     x->Q = Q;
     x->mix = mix;
 
-    x->next = NULL;
-
     biquad_allpass_updateParameters(x);
     return x;
 }
@@ -46,7 +46,6 @@ typedef struct biquad_allpass{
     float b2_over_a0; /**< Pre-calculated fraction */
     float a1_over_a0; /**< Pre-calculated fraction */
     float a2_over_a0; /**< Pre-calculated fraction */
-    struct biquad_allpass *next; /**< Pointer to the next allpass filter instance */
 } biquad_allpass;
 
 /**
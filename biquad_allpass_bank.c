@@ -0,0 +1,823 @@
+#include "biquad_allpass_bank.h"
+#include "biquad_allpass_simd.h"
+#include "vas_mem.h"
+#include "math.h"
+
+// amount of coefficient and state arrays stored in the memory block
+#define BIQUAD_ALLPASS_BANK_COEFFICIENTS 7
+#define BIQUAD_ALLPASS_BANK_STATES 4
+
+// stages are reserved in multiples of one cache line worth of floats
+#define BIQUAD_ALLPASS_BANK_GRANULE (BIQUAD_ALLPASS_BANK_ALIGNMENT / sizeof(float))
+
+// doubles per stage in the wide arrays, the coefficients and the states of one channel
+#define BIQUAD_ALLPASS_BANK_WIDE_COEFFICIENTS 5
+#define BIQUAD_ALLPASS_BANK_WIDE_STATES 2
+
+// spread stages above the nyquist frequency are clamped below it, where the poles stay inside the unit circle
+#define BIQUAD_ALLPASS_BANK_MAX_W (0.995f * (float) M_PI)
+
+
+// cos and sin of w, reduced to [-pi/4, pi/4] around the nearest multiple of pi/2, without branches so loops over stages vectorise
+static inline void biquad_allpass_bank_sinCos(float w, float *sinW, float *cosW){
+
+    // rounding by truncation, floorf is a library call without sse4.1
+    const int quadrant = (int) (w * (float) M_2_PI + copysignf(0.5f, w));
+
+    // pi/2 split in two parts, so the reduction stays exact for the audible range
+    const float r = (w - quadrant * 1.5707963705062866f) - quadrant * -4.371139000186243e-08f;
+    const float r2 = r * r;
+
+    const float s = r * (1 + r2 * (-1.f/6 + r2 * (1.f/120 + r2 * (-1.f/5040 + r2 * (1.f/362880)))));
+    const float c = 1 + r2 * (-1.f/2 + r2 * (1.f/24 + r2 * (-1.f/720 + r2 * (1.f/40320))));
+
+    // quadrant 1 and 3 swap sin and cos, 2 and 3 negate sin, 1 and 2 negate cos
+    const float sinR = quadrant & 1 ? c : s;
+    const float cosR = quadrant & 1 ? s : c;
+
+    *sinW = quadrant & 2 ? -sinR : sinR;
+    *cosW = (quadrant + 1) & 2 ? -cosR : cosR;
+}
+
+
+// a cascade of identical allpass stages, the same sums as the generic loops without b0, b1 and b2
+static inline void biquad_allpass_bank_uniformRange(biquad_allpass_bank *x, int first, int last, int c, int stride,
+                                                    const float *in, float *out, int vectorSize, int fullyWet){
+
+    const float a1_over_a0 = x->a1_over_a0[first];
+    const float a2_over_a0 = x->a2_over_a0[first];
+    const float mix = x->mix[first];
+
+    for(int s=first; s<last; s++){
+
+        float lastOut = x->lastOut[s * stride + c];
+        float lastLastOut = x->lastLastOut[s * stride + c];
+        float lastIn = x->lastIn[s * stride + c];
+        float lastLastIn = x->lastLastIn[s * stride + c];
+
+        float currentIn;
+        float currentOut;
+
+        for(int n=0; n<vectorSize; n++){
+            currentIn = in[n * stride + c];
+
+            currentOut =   a2_over_a0 * currentIn
+                         + a1_over_a0 * lastIn
+                         + lastLastIn
+                         - a1_over_a0 * lastOut
+                         - a2_over_a0 * lastLastOut;
+
+            if(!fullyWet)
+                currentOut =  (1-mix) * currentIn
+                             +   mix  * currentOut;
+
+            out[n * stride + c] = currentOut;
+
+            lastLastOut = lastOut;
+            lastOut = currentOut;
+            lastLastIn = lastIn;
+            lastIn = currentIn;
+        }
+
+        x->lastLastIn[s * stride + c] = lastLastIn;
+        x->lastIn[s * stride + c] = lastIn;
+        x->lastLastOut[s * stride + c] = lastLastOut;
+        x->lastOut[s * stride + c] = lastOut;
+
+        in = out;
+    }
+}
+
+
+// transposed direct form II, the mix is folded into the coefficients of each stage
+static inline void biquad_allpass_bank_tdf2Range(biquad_allpass_bank *x, int first, int last, int c, int stride,
+                                                 const float *in, float *out, int vectorSize){
+
+    for(int s=first; s<last; s++){
+
+        const float mix = x->mix[s];
+        const float b0 = (1-mix) + mix * x->b0_over_a0[s];
+        const float b1 = mix * x->b1_over_a0[s];
+        const float b2 = mix * x->b2_over_a0[s];
+        const float a1 = mix * x->a1_over_a0[s];
+        const float a2 = mix * x->a2_over_a0[s];
+
+        float state1 = x->lastOut[s * stride + c];
+        float state2 = x->lastLastOut[s * stride + c];
+
+        for(int n=0; n<vectorSize; n++){
+            const float currentIn = in[n * stride + c];
+            const float currentOut = b0 * currentIn + state1;
+
+            state1 = b1 * currentIn - a1 * currentOut + state2;
+            state2 = b2 * currentIn - a2 * currentOut;
+
+            out[n * stride + c] = currentOut;
+        }
+
+        x->lastOut[s * stride + c] = state1;
+        x->lastLastOut[s * stride + c] = state2;
+
+        in = out;
+    }
+}
+
+
+// the same in double precision, only the output of each stage is rounded to float
+static inline void biquad_allpass_bank_tdf2DoubleRange(biquad_allpass_bank *x, int first, int last, int c, int stride,
+                                                       const float *in, float *out, int vectorSize){
+
+    for(int s=first; s<last; s++){
+
+        const double *k = x->wideCoefficients + s * BIQUAD_ALLPASS_BANK_WIDE_COEFFICIENTS;
+        const double b0 = k[0], b1 = k[1], b2 = k[2], a1 = k[3], a2 = k[4];
+        double *state = x->wideStates + (s * stride + c) * BIQUAD_ALLPASS_BANK_WIDE_STATES;
+
+        double state1 = state[0];
+        double state2 = state[1];
+
+        for(int n=0; n<vectorSize; n++){
+            const double currentIn = in[n * stride + c];
+            const double currentOut = b0 * currentIn + state1;
+
+            state1 = b1 * currentIn - a1 * currentOut + state2;
+            state2 = b2 * currentIn - a2 * currentOut;
+
+            out[n * stride + c] = (float) currentOut;
+        }
+
+        state[0] = state1;
+        state[1] = state2;
+
+        in = out;
+    }
+}
+
+
+// the double coefficients of a stage from a1 and a2 over a0, the same transfer function as the direct form I stage with its mix
+static void biquad_allpass_bank_setWideStage(biquad_allpass_bank *x, int stage, double a1, double a2){
+
+    double *k = x->wideCoefficients + stage * BIQUAD_ALLPASS_BANK_WIDE_COEFFICIENTS;
+    const double mix = x->mix[stage];
+
+    // b0 equals a2, b1 equals a1 and b2 equals a0
+    k[0] = (1-mix) + mix * a2;
+    k[1] = mix * a1;
+    k[2] = mix;
+    k[3] = mix * a1;
+    k[4] = mix * a2;
+}
+
+
+// the frequency ratios of a range of stages, see biquad_allpass_bank_setSpread
+static void biquad_allpass_bank_place(biquad_allpass_bank *x, int first, int last){
+
+    for(int s=first; s<last; s++){
+        float position = 0, weight = 0.5f;
+
+        // van der Corput sequence in base 2, shifted so stage 0 sits in the middle of the range
+        for(int i=s; i>0; i>>=1, weight*=0.5f)
+            position += (i & 1) * weight;
+        position = position < 0.5f ? 2*position : 2*position - 2;
+
+        position = position < 0 ? -powf(-position, x->curve) : powf(position, x->curve);
+        x->ratio[s] = (float) exp2(x->spread / 2 * position);
+    }
+}
+
+
+// every stage at f0 times its ratio, the exact trig mode calls the C library per stage, the polynomial one vectorises
+static void biquad_allpass_bank_spreadStages(biquad_allpass_bank *x, int first, int last, float f0, float Q, float mix){
+
+    const double w0 = 2*M_PI*f0/x->sampleRate;
+    const float *ratio = x->ratio;
+    float *a1 = x->a1_over_a0;
+    float *a2 = x->a2_over_a0;
+
+    // the angles are staged in a1, rounded once like the angle of an unspread stage, no ratio exceeds 2^(spread/2)
+    for(int s=first; s<last; s++)
+        a1[s] = (float) (w0 * ratio[s]);
+
+    // a float compare may trap, so it would keep the loops from vectorising
+    if(w0 * exp2(fabs(x->spread) / 2) >= BIQUAD_ALLPASS_BANK_MAX_W){
+        for(int s=first; s<last; s++)
+            a1[s] = fminf(a1[s], BIQUAD_ALLPASS_BANK_MAX_W);
+    }
+
+    if(x->trigMode == BIQUAD_ALLPASS_TRIG_POLYNOMIAL){
+        for(int s=first; s<last; s++){
+            float sinW, cosW, alpha;
+
+            biquad_allpass_bank_sinCos(a1[s], &sinW, &cosW);
+            alpha = sinW/2*Q;
+            a1[s] = -2 * cosW / (1 + alpha);
+            a2[s] = (1 - alpha) / (1 + alpha);
+        }
+    }
+    else{
+        for(int s=first; s<last; s++){
+            const float w = a1[s];
+            const float alpha = sinf(w)/2*Q;
+
+            a1[s] = -2 * cosf(w) / (1 + alpha);
+            a2[s] = (1 - alpha) / (1 + alpha);
+        }
+    }
+
+    // b0 equals a2, b1 equals a1 and b2 equals a0
+    for(int s=first; s<last; s++){
+        x->b0_over_a0[s] = x->a2_over_a0[s];
+        x->b1_over_a0[s] = x->a1_over_a0[s];
+        x->b2_over_a0[s] = 1;
+    }
+
+    if (mix <= 1 && mix >=0){
+        for(int s=first; s<last; s++)
+            x->mix[s] = mix;
+    }
+
+    if(x->form == BIQUAD_ALLPASS_FORM_TDF2_DOUBLE){
+        for(int s=first; s<last; s++){
+            const double w = fmin(2*M_PI*f0/x->sampleRate * x->ratio[s], BIQUAD_ALLPASS_BANK_MAX_W);
+            const double alpha = sin(w)/2*Q;
+
+            biquad_allpass_bank_setWideStage(x, s, -2 * cos(w) / (1 + alpha), (1 - alpha) / (1 + alpha));
+        }
+    }
+
+    // the shared cache belongs to unspread stages
+    x->cacheValid = 0;
+    x->uniformity = -1;
+}
+
+
+// the wide arrays exist in the double precision form only
+static void biquad_allpass_bank_allocateWide(biquad_allpass_bank *x, int oldCapacity){
+
+    void *oldMemory = x->wideMemory;
+    const double *oldCoefficients = x->wideCoefficients;
+    const double *oldStates = x->wideStates;
+    const size_t coefficients = (size_t) BIQUAD_ALLPASS_BANK_WIDE_COEFFICIENTS * x->capacity;
+    const size_t states = (size_t) BIQUAD_ALLPASS_BANK_WIDE_STATES * x->channelStride * x->capacity;
+
+    if(x->form != BIQUAD_ALLPASS_FORM_TDF2_DOUBLE){
+        vas_mem_free(oldMemory);
+        x->wideMemory = NULL;
+        x->wideCoefficients = NULL;
+        x->wideStates = NULL;
+        return;
+    }
+
+    // the capacity is a multiple of the granule, so the states start on a cache line
+    x->wideMemory = vas_mem_alignedAlloc((long) ((coefficients + states) * sizeof(double)), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    x->wideCoefficients = (double *) x->wideMemory;
+    x->wideStates = x->wideCoefficients + coefficients;
+
+    if(oldMemory != NULL){
+        memcpy(x->wideCoefficients, oldCoefficients, (size_t) BIQUAD_ALLPASS_BANK_WIDE_COEFFICIENTS * oldCapacity * sizeof(double));
+        memcpy(x->wideStates, oldStates, (size_t) BIQUAD_ALLPASS_BANK_WIDE_STATES * x->channelStride * oldCapacity * sizeof(double));
+    }
+
+    vas_mem_free(oldMemory);
+}
+
+
+static void biquad_allpass_bank_allocate(biquad_allpass_bank *x, int capacity){
+
+    void *oldMemory = x->memory;
+    const int oldCapacity = x->capacity;
+    float *oldArrays[BIQUAD_ALLPASS_BANK_COEFFICIENTS + BIQUAD_ALLPASS_BANK_STATES] = {
+        x->b0_over_a0, x->b1_over_a0, x->b2_over_a0, x->a1_over_a0, x->a2_over_a0, x->mix, x->ratio,
+        x->lastIn, x->lastLastIn, x->lastOut, x->lastLastOut
+    };
+    float *newArrays[BIQUAD_ALLPASS_BANK_COEFFICIENTS + BIQUAD_ALLPASS_BANK_STATES];
+    size_t size;
+    float *next;
+
+    // round up to full cache lines, so every array starts aligned
+    capacity = (int) ((capacity + BIQUAD_ALLPASS_BANK_GRANULE - 1) / BIQUAD_ALLPASS_BANK_GRANULE * BIQUAD_ALLPASS_BANK_GRANULE);
+
+    size = (BIQUAD_ALLPASS_BANK_COEFFICIENTS + BIQUAD_ALLPASS_BANK_STATES * x->channelStride) * capacity * sizeof(float);
+
+    x->memory = vas_mem_alignedAlloc((long) size, BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    next = (float *) x->memory;
+
+    for(int i=0; i<BIQUAD_ALLPASS_BANK_COEFFICIENTS + BIQUAD_ALLPASS_BANK_STATES; i++){
+        const int length = i < BIQUAD_ALLPASS_BANK_COEFFICIENTS ? 1 : x->channelStride;
+
+        newArrays[i] = next;
+        next += length * capacity;
+
+        // keep coefficients and states of existing stages
+        if(oldMemory != NULL)
+            memcpy(newArrays[i], oldArrays[i], length * oldCapacity * sizeof(float));
+    }
+
+    x->b0_over_a0 = newArrays[0];
+    x->b1_over_a0 = newArrays[1];
+    x->b2_over_a0 = newArrays[2];
+    x->a1_over_a0 = newArrays[3];
+    x->a2_over_a0 = newArrays[4];
+    x->mix = newArrays[5];
+    x->ratio = newArrays[6];
+    x->lastIn = newArrays[7];
+    x->lastLastIn = newArrays[8];
+    x->lastOut = newArrays[9];
+    x->lastLastOut = newArrays[10];
+
+    x->capacity = capacity;
+    biquad_allpass_bank_allocateWide(x, oldCapacity);
+
+    vas_mem_free(oldMemory);
+}
+
+
+biquad_allpass_bank *biquad_allpass_bank_new(int capacity, int nChannels, float sampleRate){
+
+    biquad_allpass_bank *x = (biquad_allpass_bank *) vas_mem_alloc(sizeof(biquad_allpass_bank));
+
+    if(nChannels < 1)
+        nChannels = 1;
+
+    x->nStages = 0;
+    x->capacity = 0;
+    x->nChannels = nChannels;
+    // stereo shares the registers of the pipelined kernel, more channels fill registers of their own
+    if(nChannels <= 2)
+        x->channelStride = nChannels;
+    else
+        x->channelStride = (nChannels + BIQUAD_ALLPASS_BANK_LANES - 1) / BIQUAD_ALLPASS_BANK_LANES * BIQUAD_ALLPASS_BANK_LANES;
+    x->backend = biquad_allpass_simd_detect();
+    x->sampleRate = sampleRate;
+    x->trigMode = BIQUAD_ALLPASS_TRIG_EXACT;
+    x->cacheValid = 0;
+    x->uniformity = -1;
+    x->specialised = 1;
+    x->form = BIQUAD_ALLPASS_FORM_DF1;
+    x->spread = 0;
+    x->curve = 1;
+    x->memory = NULL;
+    x->wideMemory = NULL;
+
+    if(capacity < 1)
+        capacity = 1;
+
+    biquad_allpass_bank_allocate(x, capacity);
+
+    return x;
+}
+
+
+void biquad_allpass_bank_free(biquad_allpass_bank *x){
+    vas_mem_free(x->wideMemory);
+    vas_mem_free(x->memory);
+    vas_mem_free(x);
+}
+
+
+void biquad_allpass_bank_reserve(biquad_allpass_bank *x, int capacity){
+    if(capacity > x->capacity)
+        biquad_allpass_bank_allocate(x, capacity);
+}
+
+
+void biquad_allpass_bank_setStageCount(biquad_allpass_bank *x, int nStages){
+
+    if(nStages < 0)
+        nStages = 0;
+
+    if(nStages > x->capacity)
+        biquad_allpass_bank_allocate(x, nStages > 2 * x->capacity ? nStages : 2 * x->capacity);
+
+    // clear states of stages which become active
+    for(int i=x->nStages; i<nStages; i++)
+        x->mix[i] = 1;
+
+    if(nStages > x->nStages){
+        biquad_allpass_bank_place(x, x->nStages, nStages);
+        biquad_allpass_bank_clearStates(x, x->nStages, nStages);
+    }
+
+    if(nStages != x->nStages)
+        x->uniformity = -1;
+
+    x->nStages = nStages;
+}
+
+
+void biquad_allpass_bank_clearStates(biquad_allpass_bank *x, int first, int last){
+
+    const size_t size = (size_t) (last - first) * x->channelStride * sizeof(float);
+
+    if(last <= first)
+        return;
+
+    memset(x->lastIn + first * x->channelStride, 0, size);
+    memset(x->lastLastIn + first * x->channelStride, 0, size);
+    memset(x->lastOut + first * x->channelStride, 0, size);
+    memset(x->lastLastOut + first * x->channelStride, 0, size);
+
+    if(x->wideStates != NULL)
+        memset(x->wideStates + (size_t) first * x->channelStride * BIQUAD_ALLPASS_BANK_WIDE_STATES, 0,
+               (size_t) (last - first) * x->channelStride * BIQUAD_ALLPASS_BANK_WIDE_STATES * sizeof(double));
+}
+
+
+int biquad_allpass_bank_decayed(biquad_allpass_bank *x, int first, int last, float threshold){
+
+    for(int i=first * x->channelStride; i<last * x->channelStride; i++){
+        if(fabsf(x->lastIn[i]) >= threshold || fabsf(x->lastLastIn[i]) >= threshold
+           || fabsf(x->lastOut[i]) >= threshold || fabsf(x->lastLastOut[i]) >= threshold)
+            return 0;
+    }
+
+    if(x->wideStates != NULL){
+        for(int i=first * x->channelStride * BIQUAD_ALLPASS_BANK_WIDE_STATES; i<last * x->channelStride * BIQUAD_ALLPASS_BANK_WIDE_STATES; i++){
+            if(fabs(x->wideStates[i]) >= threshold)
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+void biquad_allpass_bank_setForm(biquad_allpass_bank *x, int form){
+
+    if(form != BIQUAD_ALLPASS_FORM_TDF2 && form != BIQUAD_ALLPASS_FORM_TDF2_DOUBLE)
+        form = BIQUAD_ALLPASS_FORM_DF1;
+
+    x->form = form;
+    biquad_allpass_bank_allocateWide(x, 0);
+    biquad_allpass_bank_clearStates(x, 0, x->capacity);
+
+    x->cacheValid = 0;
+    x->uniformity = -1;
+}
+
+
+void biquad_allpass_bank_copyCoefficients(biquad_allpass_bank *x, const biquad_allpass_bank *source, int nStages){
+
+    const size_t size = (size_t) nStages * sizeof(float);
+
+    memcpy(x->b0_over_a0, source->b0_over_a0, size);
+    memcpy(x->b1_over_a0, source->b1_over_a0, size);
+    memcpy(x->b2_over_a0, source->b2_over_a0, size);
+    memcpy(x->a1_over_a0, source->a1_over_a0, size);
+    memcpy(x->a2_over_a0, source->a2_over_a0, size);
+    memcpy(x->mix, source->mix, size);
+
+    if(x->wideCoefficients != NULL && source->wideCoefficients != NULL)
+        memcpy(x->wideCoefficients, source->wideCoefficients, (size_t) BIQUAD_ALLPASS_BANK_WIDE_COEFFICIENTS * nStages * sizeof(double));
+
+    x->uniformity = -1;
+}
+
+
+int biquad_allpass_bank_sameCoefficients(const biquad_allpass_bank *x, const biquad_allpass_bank *other){
+
+    const size_t size = (size_t) x->nStages * sizeof(float);
+
+    if(x->nStages != other->nStages || x->form != other->form)
+        return 0;
+
+    if(x->form == BIQUAD_ALLPASS_FORM_TDF2_DOUBLE)
+        return memcmp(x->wideCoefficients, other->wideCoefficients, (size_t) BIQUAD_ALLPASS_BANK_WIDE_COEFFICIENTS * x->nStages * sizeof(double)) == 0;
+
+    return memcmp(x->b0_over_a0, other->b0_over_a0, size) == 0 && memcmp(x->b1_over_a0, other->b1_over_a0, size) == 0
+        && memcmp(x->b2_over_a0, other->b2_over_a0, size) == 0 && memcmp(x->a1_over_a0, other->a1_over_a0, size) == 0
+        && memcmp(x->a2_over_a0, other->a2_over_a0, size) == 0 && memcmp(x->mix, other->mix, size) == 0;
+}
+
+
+void biquad_allpass_bank_copyStates(biquad_allpass_bank *x, int channel, const biquad_allpass_bank *source, int sourceChannel, int nStages){
+
+    for(int s=0; s<nStages; s++){
+        const int i = s * x->channelStride + channel;
+        const int j = s * source->channelStride + sourceChannel;
+
+        x->lastIn[i] = source->lastIn[j];
+        x->lastLastIn[i] = source->lastLastIn[j];
+        x->lastOut[i] = source->lastOut[j];
+        x->lastLastOut[i] = source->lastLastOut[j];
+    }
+
+    if(x->wideStates != NULL && source->wideStates != NULL){
+        for(int s=0; s<nStages; s++){
+            for(int k=0; k<BIQUAD_ALLPASS_BANK_WIDE_STATES; k++)
+                x->wideStates[(s * x->channelStride + channel) * BIQUAD_ALLPASS_BANK_WIDE_STATES + k]
+                    = source->wideStates[(s * source->channelStride + sourceChannel) * BIQUAD_ALLPASS_BANK_WIDE_STATES + k];
+        }
+    }
+}
+
+
+void biquad_allpass_bank_setStage(biquad_allpass_bank *x, int stage, float f0, float Q, float mix){
+    biquad_allpass_bank_setStages(x, stage, stage + 1, f0, Q, mix);
+}
+
+
+void biquad_allpass_bank_setStages(biquad_allpass_bank *x, int first, int last, float f0, float Q, float mix){
+
+    float *c = x->cacheCoefficients;
+
+    if(x->spread != 0){
+        biquad_allpass_bank_spreadStages(x, first, last, f0, Q, mix);
+        return;
+    }
+
+    if(!x->cacheValid || f0 != x->cacheF0 || Q != x->cacheQ){
+
+        float w0, cosW0, sinW0, alpha;
+        float a0, a1, a2;
+
+        // biquad coefficients, see biquad_allpass_updateParameters
+        w0 = 2*M_PI*f0/x->sampleRate;
+        if(x->trigMode == BIQUAD_ALLPASS_TRIG_POLYNOMIAL)
+            biquad_allpass_bank_sinCos(w0, &sinW0, &cosW0);
+        else{
+            cosW0 = cosf(w0);
+            sinW0 = sinf(w0);
+        }
+        alpha = sinW0/2*Q;
+
+        // allpass coefficients, b0 equals a2, b1 equals a1 and b2 equals a0
+        a0 = 1 + alpha;
+        a1 = -2 * cosW0;
+        a2 = 1 - alpha;
+
+        // two divisions give the same fractions as the five of biquad_allpass_updateParameters
+        c[3] = a1/a0;
+        c[4] = a2/a0;
+        c[0] = c[4];
+        c[1] = c[3];
+        c[2] = 1;
+
+        if(x->form == BIQUAD_ALLPASS_FORM_TDF2_DOUBLE){
+            const double wideW0 = 2*M_PI*f0/x->sampleRate;
+            const double wideAlpha = sin(wideW0)/2*Q;
+
+            x->wideCache[0] = -2 * cos(wideW0) / (1 + wideAlpha);
+            x->wideCache[1] = (1 - wideAlpha) / (1 + wideAlpha);
+        }
+
+        x->cacheF0 = f0;
+        x->cacheQ = Q;
+        x->cacheValid = 1;
+    }
+
+    for(int s=first; s<last; s++){
+        x->b0_over_a0[s] = c[0];
+        x->b1_over_a0[s] = c[1];
+        x->b2_over_a0[s] = c[2];
+        x->a1_over_a0[s] = c[3];
+        x->a2_over_a0[s] = c[4];
+
+        if (mix <= 1 && mix >=0)
+            x->mix[s] = mix;
+
+        if(x->form == BIQUAD_ALLPASS_FORM_TDF2_DOUBLE)
+            biquad_allpass_bank_setWideStage(x, s, x->wideCache[0], x->wideCache[1]);
+    }
+
+    x->uniformity = -1;
+}
+
+
+void biquad_allpass_bank_setSpread(biquad_allpass_bank *x, float spread, float curve){
+
+    if(curve <= 0)
+        curve = 1;
+
+    if(spread == x->spread && curve == x->curve)
+        return;
+
+    x->spread = spread;
+    x->curve = curve;
+
+    // inactive stages are placed once they become active
+    biquad_allpass_bank_place(x, 0, x->nStages);
+}
+
+
+void biquad_allpass_bank_setSpecialised(biquad_allpass_bank *x, int specialised){
+    x->specialised = specialised != 0;
+}
+
+
+int biquad_allpass_bank_uniformity(biquad_allpass_bank *x){
+
+    if(x->uniformity >= 0)
+        return x->uniformity;
+
+    x->uniformity = BIQUAD_ALLPASS_UNIFORMITY_MIXED;
+
+    if(x->nStages < 1)
+        return x->uniformity;
+
+    // the specialised kernels rely on the allpass symmetry of the coefficients
+    if(x->b0_over_a0[0] != x->a2_over_a0[0] || x->b1_over_a0[0] != x->a1_over_a0[0] || x->b2_over_a0[0] != 1)
+        return x->uniformity;
+
+    for(int s=1; s<x->nStages; s++){
+        if(x->b0_over_a0[s] != x->b0_over_a0[0] || x->b1_over_a0[s] != x->b1_over_a0[0] || x->b2_over_a0[s] != x->b2_over_a0[0]
+           || x->a1_over_a0[s] != x->a1_over_a0[0] || x->a2_over_a0[s] != x->a2_over_a0[0] || x->mix[s] != x->mix[0])
+            return x->uniformity;
+    }
+
+    x->uniformity = x->mix[0] == 1 ? BIQUAD_ALLPASS_UNIFORMITY_WET : BIQUAD_ALLPASS_UNIFORMITY_UNIFORM;
+
+    return x->uniformity;
+}
+
+
+void biquad_allpass_bank_setBackend(biquad_allpass_bank *x, int backend){
+    x->backend = biquad_allpass_simd_resolve((biquad_allpass_backend) backend);
+}
+
+
+void biquad_allpass_bank_setTrigMode(biquad_allpass_bank *x, int trigMode){
+    x->trigMode = trigMode == BIQUAD_ALLPASS_TRIG_POLYNOMIAL ? BIQUAD_ALLPASS_TRIG_POLYNOMIAL : BIQUAD_ALLPASS_TRIG_EXACT;
+    x->cacheValid = 0;
+}
+
+
+void biquad_allpass_bank_setSampleRate(biquad_allpass_bank *x, float sampleRate){
+    x->sampleRate = sampleRate;
+    x->cacheValid = 0;
+}
+
+
+void biquad_allpass_bank_process(biquad_allpass_bank *x, float *in, float *out, int vectorSize){
+    biquad_allpass_bank_processStages(x, 0, x->nStages, in, out, vectorSize);
+}
+
+
+void biquad_allpass_bank_processStages(biquad_allpass_bank *x, int first, int last, float *in, float *out, int vectorSize){
+
+    if(x->backend == BIQUAD_ALLPASS_BACKEND_SCALAR || x->form != BIQUAD_ALLPASS_FORM_DF1)
+        biquad_allpass_bank_processRange(x, first, last, in, out, vectorSize);
+    else
+        biquad_allpass_simd_process(x, (biquad_allpass_backend) x->backend, first, last, in, out, vectorSize);
+}
+
+
+void biquad_allpass_bank_processInterleaved(biquad_allpass_bank *x, float *buffer, int vectorSize){
+    biquad_allpass_bank_processInterleavedStages(x, 0, x->nStages, buffer, vectorSize);
+}
+
+
+void biquad_allpass_bank_processInterleavedStages(biquad_allpass_bank *x, int first, int last, float *buffer, int vectorSize){
+
+    if(x->backend == BIQUAD_ALLPASS_BACKEND_SCALAR || x->form != BIQUAD_ALLPASS_FORM_DF1)
+        biquad_allpass_bank_processInterleavedRange(x, first, last, 0, x->nChannels, buffer, vectorSize);
+    else
+        biquad_allpass_simd_processInterleaved(x, (biquad_allpass_backend) x->backend, first, last, buffer, vectorSize);
+}
+
+
+void biquad_allpass_bank_processRange(biquad_allpass_bank *x, int first, int last, float *in, float *out, int vectorSize){
+
+    if(first >= last && in != out)
+        memmove(out, in, vectorSize * sizeof(float));
+
+    if(x->form == BIQUAD_ALLPASS_FORM_TDF2){
+        biquad_allpass_bank_tdf2Range(x, first, last, 0, 1, in, out, vectorSize);
+        return;
+    }
+    if(x->form == BIQUAD_ALLPASS_FORM_TDF2_DOUBLE){
+        biquad_allpass_bank_tdf2DoubleRange(x, first, last, 0, 1, in, out, vectorSize);
+        return;
+    }
+
+    if(first < last && x->specialised){
+        switch(biquad_allpass_bank_uniformity(x)){
+            case BIQUAD_ALLPASS_UNIFORMITY_WET:
+                biquad_allpass_bank_uniformRange(x, first, last, 0, 1, in, out, vectorSize, 1);
+                return;
+            case BIQUAD_ALLPASS_UNIFORMITY_UNIFORM:
+                biquad_allpass_bank_uniformRange(x, first, last, 0, 1, in, out, vectorSize, 0);
+                return;
+            default:
+                break;
+        }
+    }
+
+    for(int s=first; s<last; s++){
+
+        // coefficients stay in registers for the whole buffer
+        const float b0_over_a0 = x->b0_over_a0[s];
+        const float b1_over_a0 = x->b1_over_a0[s];
+        const float b2_over_a0 = x->b2_over_a0[s];
+        const float a1_over_a0 = x->a1_over_a0[s];
+        const float a2_over_a0 = x->a2_over_a0[s];
+        const float mix = x->mix[s];
+
+        float lastOut = x->lastOut[s];
+        float lastLastOut = x->lastLastOut[s];
+        float lastIn = x->lastIn[s];
+        float lastLastIn = x->lastLastIn[s];
+
+        float currentIn;
+        float currentOut;
+
+        for(int n=0; n<vectorSize; n++){
+            currentIn = *(in+n);
+
+            currentOut =   b0_over_a0 * currentIn
+                         + b1_over_a0 * lastIn
+                         + b2_over_a0 * lastLastIn
+                         - a1_over_a0 * lastOut
+                         - a2_over_a0 * lastLastOut;
+
+            currentOut =  (1-mix) * currentIn
+                         +   mix  * currentOut;
+
+            *(out+n) = currentOut;
+
+            lastLastOut = lastOut;
+            lastOut = currentOut;
+            lastLastIn = lastIn;
+            lastIn = currentIn;
+        }
+
+        x->lastLastIn[s] = lastLastIn;
+        x->lastIn[s] = lastIn;
+        x->lastLastOut[s] = lastLastOut;
+        x->lastOut[s] = lastOut;
+
+        in = out;
+    }
+}
+
+
+void biquad_allpass_bank_processInterleavedRange(biquad_allpass_bank *x, int first, int last, int firstChannel, int lastChannel, float *buffer, int vectorSize){
+
+    const int stride = x->channelStride;
+    const int uniformity = first < last && x->specialised && x->form == BIQUAD_ALLPASS_FORM_DF1
+                           ? biquad_allpass_bank_uniformity(x) : BIQUAD_ALLPASS_UNIFORMITY_MIXED;
+
+    for(int c=firstChannel; c<lastChannel; c++){
+
+        if(x->form == BIQUAD_ALLPASS_FORM_TDF2){
+            biquad_allpass_bank_tdf2Range(x, first, last, c, stride, buffer, buffer, vectorSize);
+            continue;
+        }
+        if(x->form == BIQUAD_ALLPASS_FORM_TDF2_DOUBLE){
+            biquad_allpass_bank_tdf2DoubleRange(x, first, last, c, stride, buffer, buffer, vectorSize);
+            continue;
+        }
+
+        if(uniformity == BIQUAD_ALLPASS_UNIFORMITY_WET){
+            biquad_allpass_bank_uniformRange(x, first, last, c, stride, buffer, buffer, vectorSize, 1);
+            continue;
+        }
+        if(uniformity == BIQUAD_ALLPASS_UNIFORMITY_UNIFORM){
+            biquad_allpass_bank_uniformRange(x, first, last, c, stride, buffer, buffer, vectorSize, 0);
+            continue;
+        }
+
+        for(int s=first; s<last; s++){
+
+            const float b0_over_a0 = x->b0_over_a0[s];
+            const float b1_over_a0 = x->b1_over_a0[s];
+            const float b2_over_a0 = x->b2_over_a0[s];
+            const float a1_over_a0 = x->a1_over_a0[s];
+            const float a2_over_a0 = x->a2_over_a0[s];
+            const float mix = x->mix[s];
+
+            float lastOut = x->lastOut[s * stride + c];
+            float lastLastOut = x->lastLastOut[s * stride + c];
+            float lastIn = x->lastIn[s * stride + c];
+            float lastLastIn = x->lastLastIn[s * stride + c];
+
+            float currentIn;
+            float currentOut;
+
+            for(int n=0; n<vectorSize; n++){
+                currentIn = buffer[n * stride + c];
+
+                currentOut =   b0_over_a0 * currentIn
+                             + b1_over_a0 * lastIn
+                             + b2_over_a0 * lastLastIn
+                             - a1_over_a0 * lastOut
+                             - a2_over_a0 * lastLastOut;
+
+                currentOut =  (1-mix) * currentIn
+                             +   mix  * currentOut;
+
+                buffer[n * stride + c] = currentOut;
+
+                lastLastOut = lastOut;
+                lastOut = currentOut;
+                lastLastIn = lastIn;
+                lastIn = currentIn;
+            }
+
+            x->lastLastIn[s * stride + c] = lastLastIn;
+            x->lastIn[s * stride + c] = lastIn;
+            x->lastLastOut[s * stride + c] = lastLastOut;
+            x->lastOut[s * stride + c] = lastOut;
+        }
+    }
+}
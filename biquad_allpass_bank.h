@@ -0,0 +1,393 @@
+/**
+ * @file biquad_allpass_bank.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief A contiguous bank of serially connected biquad allpass filters
+ *
+ * biquad_allpass_bank stores the coefficients and states of all filter stages in a structure of arrays. <br>
+ * Every array lives in one aligned memory block, so processing a cascade is a linear sweep through memory. <br>
+ * The math of each stage is identical to the biquad_allpass filter. <br>
+ * <br>
+ * A bank can filter several channels with the same coefficients. <br>
+ * The states of all channels of a stage are stored next to each other, so one SIMD lane processes one channel. <br>
+ * <br>
+ * The coefficients of the last parameter set are cached, stages sharing the parameters only copy them. <br>
+ * The cache belongs to the bank. A table shared by all banks was slower than calculating the coefficients and saved no memory,
+ * since the kernels read the contiguous arrays of each bank. <br>
+ * <br>
+ * If all active stages share their parameters, the cascade is processed by kernels specialised for uniform stages. <br>
+ * They broadcast the coefficients once, skip the multiplication with b2 and, for a mix of 1, the dry wet mix. <br>
+ * The output stays identical to the generic kernels. <br>
+ * <br>
+ * The stages can also run in transposed direct form II, with two states per stage and channel instead of four, <br>
+ * optionally with coefficients, states and sums in double precision. The mix is folded into the coefficients, <br>
+ * which gives the transfer function of the direct form I stage. These forms always use the scalar loops. <br>
+ * <br>
+ * A spread places the center frequencies of the stages across a range of octaves around f0. <br>
+ * The position of every stage within the range is fixed by its index, so stages which become active never move the others. <br>
+ * The coefficients of spread stages are calculated in one pass over the arrays, which the compiler vectorises in the polynomial trig mode. <br>
+ */
+
+#ifndef bq_allpass_bank
+#define bq_allpass_bank
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Alignment in bytes of every array inside the bank (one cache line) <br>
+ */
+#define BIQUAD_ALLPASS_BANK_ALIGNMENT 64
+
+/**
+ * @brief Banks with more than two channels pad their channel count to a multiple of this lane count <br>
+ */
+#define BIQUAD_ALLPASS_BANK_LANES 4
+
+/**
+ * @brief The ways of evaluating cos and sin for the coefficients <br>
+ */
+typedef enum biquad_allpass_trig{
+    BIQUAD_ALLPASS_TRIG_EXACT = 0, /**< cosf and sinf of the C library, same results as biquad_allpass */
+    BIQUAD_ALLPASS_TRIG_POLYNOMIAL /**< Quadrant reduction and Taylor polynomials, max absolute error 1.3e-7 for f0 up to sampleRate / 2 (cosf: 3.3e-8) */
+} biquad_allpass_trig;
+
+/**
+ * @brief How the active stages of a bank relate to each other <br>
+ */
+typedef enum biquad_allpass_uniformity{
+    BIQUAD_ALLPASS_UNIFORMITY_MIXED = 0, /**< The stages differ, every stage uses its own coefficients */
+    BIQUAD_ALLPASS_UNIFORMITY_UNIFORM, /**< All stages share the same allpass coefficients and mix */
+    BIQUAD_ALLPASS_UNIFORMITY_WET /**< All stages share the same allpass coefficients and a mix of 1 */
+} biquad_allpass_uniformity;
+
+/**
+ * @brief The filter structures of the stages <br>
+ */
+typedef enum biquad_allpass_form{
+    BIQUAD_ALLPASS_FORM_DF1 = 0, /**< Direct form I, four float states per stage, every backend */
+    BIQUAD_ALLPASS_FORM_TDF2, /**< Transposed direct form II, two float states per stage, scalar loop */
+    BIQUAD_ALLPASS_FORM_TDF2_DOUBLE /**< Transposed direct form II in double precision, scalar loop, the signal between stages stays float */
+} biquad_allpass_form;
+
+/**
+ * @struct biquad_allpass_bank
+ * @brief A struct holding a cascade of biquad allpass filters in a structure of arrays <br>
+ *
+ * Index i of every coefficient array belongs to filter stage i. <br>
+ * Index i * channelStride + c of every state array belongs to channel c of filter stage i. <br>
+ * Only the first nStages entries are processed, the remaining entries up to capacity are reserved. <br>
+ * In BIQUAD_ALLPASS_FORM_TDF2 lastOut and lastLastOut hold the two states, in BIQUAD_ALLPASS_FORM_TDF2_DOUBLE the wide arrays do. <br>
+ */
+typedef struct biquad_allpass_bank{
+    int nStages; /**< The amount of active filter stages */
+    int capacity; /**< The amount of stages the arrays can hold */
+    int nChannels; /**< The amount of channels filtered with the same coefficients */
+    int channelStride; /**< The distance between the states of two stages, nChannels, padded to full SIMD registers above two channels */
+    int backend; /**< The biquad_allpass_backend used for processing */
+    float sampleRate; /**< The sample rate of the incoming audio stream */
+    int trigMode; /**< The biquad_allpass_trig mode used for the coefficients */
+    int cacheValid; /**< 1 if the cached coefficients belong to cacheF0 and cacheQ */
+    float cacheF0; /**< The center frequency of the cached coefficients */
+    float cacheQ; /**< The q factor of the cached coefficients */
+    float cacheCoefficients[5]; /**< The cached fractions b0, b1, b2, a1 and a2 over a0 */
+    int uniformity; /**< The biquad_allpass_uniformity of the active stages, -1 until it is checked again */
+    int specialised; /**< 1 if uniform cascades are processed by the specialised kernels */
+    int form; /**< The biquad_allpass_form of the stages */
+    double wideCache[2]; /**< a1 and a2 over a0 of the cached coefficients in double precision, BIQUAD_ALLPASS_FORM_TDF2_DOUBLE only */
+    float spread; /**< The width of the frequency range of the stages in octaves, 0 places every stage at f0 */
+    float curve; /**< The exponent of the distribution, 1 spaces the stages evenly in octaves, above 1 gathers them around f0 */
+    float *b0_over_a0; /**< Pre-calculated fraction for each stage */
+    float *b1_over_a0; /**< Pre-calculated fraction for each stage */
+    float *b2_over_a0; /**< Pre-calculated fraction for each stage */
+    float *a1_over_a0; /**< Pre-calculated fraction for each stage */
+    float *a2_over_a0; /**< Pre-calculated fraction for each stage */
+    float *mix; /**< The dry wet mix of each stage */
+    float *ratio; /**< The center frequency of each stage relative to f0, following spread and curve */
+    float *lastIn; /**< The last unprocessed audio sample of each stage and channel */
+    float *lastLastIn; /**< The second last unprocessed audio sample of each stage and channel */
+    float *lastOut; /**< The last processed audio sample of each stage and channel */
+    float *lastLastOut; /**< The second last processed audio sample of each stage and channel */
+    void *memory; /**< The aligned memory block holding all arrays */
+    double *wideCoefficients; /**< b0, b1, b2, a1 and a2 over a0 of each stage with the mix folded in, BIQUAD_ALLPASS_FORM_TDF2_DOUBLE only */
+    double *wideStates; /**< The two states of each stage and channel, BIQUAD_ALLPASS_FORM_TDF2_DOUBLE only */
+    void *wideMemory; /**< The aligned memory block of the wide arrays, NULL in the float forms */
+} biquad_allpass_bank;
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Creates a new biquad_allpass_bank object <br>
+ * @returns an instance of the biquad_allpass_bank object <br>
+ * @param capacity The initial amount of stages to reserve memory for <br>
+ * @param nChannels The amount of channels to filter <br>
+ * @param sampleRate The systems sample rate <br>
+ *
+ * The bank starts without active stages and uses the fastest backend the cpu supports. <br>
+ */
+biquad_allpass_bank *biquad_allpass_bank_new(int capacity, int nChannels, float sampleRate);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Frees the biquad_allpass_bank object. <br>
+ * @param x A pointer the biquad_allpass_bank object <br>
+ */
+void biquad_allpass_bank_free(biquad_allpass_bank *x);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Sets the amount of active filter stages. <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param nStages The new amount of active stages <br>
+ *
+ * Grows the arrays if nStages exceeds the capacity. Existing stages keep their coefficients and states. <br>
+ * Stages which become active start with cleared states and have to be configured with biquad_allpass_bank_setStage. <br>
+ */
+void biquad_allpass_bank_setStageCount(biquad_allpass_bank *x, int nStages);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Grows the arrays to hold at least capacity stages. <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param capacity The amount of stages the arrays have to hold <br>
+ *
+ * Existing stages keep their coefficients and states, a smaller capacity does nothing. <br>
+ */
+void biquad_allpass_bank_reserve(biquad_allpass_bank *x, int capacity);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Clears the states of a range of stages, the coefficients are kept. <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ */
+void biquad_allpass_bank_clearStates(biquad_allpass_bank *x, int first, int last);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Checks whether the states of a range of stages have decayed <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param threshold The magnitude every state of every channel has to stay below <br>
+ * @returns 1 if all states are below the threshold <br>
+ */
+int biquad_allpass_bank_decayed(biquad_allpass_bank *x, int first, int last, float threshold);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Selects the filter structure of all stages. <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param form A biquad_allpass_form <br>
+ *
+ * Clears all states. The coefficients have to be set again with biquad_allpass_bank_setStages. <br>
+ * The double precision form allocates its arrays here and ignores the trig mode, cos and sin are always exact. <br>
+ */
+void biquad_allpass_bank_setForm(biquad_allpass_bank *x, int form);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Copies the coefficients of stages from another bank of the same form <br>
+ * @param x A pointer to the biquad_allpass_bank object receiving the coefficients <br>
+ * @param source The bank to copy from <br>
+ * @param nStages The amount of stages to copy, starting at stage 0 <br>
+ */
+void biquad_allpass_bank_copyCoefficients(biquad_allpass_bank *x, const biquad_allpass_bank *source, int nStages);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Checks if two banks filter with the same coefficients <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param other The bank to compare with <br>
+ * @returns 1 if the form, the amount of active stages and all their coefficients and mixes match bit by bit, 0 otherwise <br>
+ */
+int biquad_allpass_bank_sameCoefficients(const biquad_allpass_bank *x, const biquad_allpass_bank *other);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Copies the states of one channel from another bank of the same form <br>
+ * @param x A pointer to the biquad_allpass_bank object receiving the states <br>
+ * @param channel The channel of x receiving the states <br>
+ * @param source The bank to copy from, may be x itself <br>
+ * @param sourceChannel The channel of source to copy <br>
+ * @param nStages The amount of stages to copy, starting at stage 0 <br>
+ *
+ * Moves a channel between banks with different channel counts, e.g. a single channel into one lane of a multichannel bank. <br>
+ */
+void biquad_allpass_bank_copyStates(biquad_allpass_bank *x, int channel, const biquad_allpass_bank *source, int sourceChannel, int nStages);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Calculates the filter coefficients of a single stage <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param stage The index of the stage <br>
+ * @param f0 The filters center frequency parameter <br>
+ * @param Q The filters q factor parameter <br>
+ * @param mix The filters dry-wet mix parameter <br>
+ *
+ * Uses the same formulas as biquad_allpass_updateParameters. <br>
+ */
+void biquad_allpass_bank_setStage(biquad_allpass_bank *x, int stage, float f0, float Q, float mix);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Sets a range of stages to the same parameters <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param f0 The filters center frequency parameter <br>
+ * @param Q The filters q factor parameter <br>
+ * @param mix The filters dry-wet mix parameter <br>
+ *
+ * The coefficients are calculated once and copied to every stage of the range. <br>
+ * If f0 and Q match the last call only mix changes, the cached coefficients are copied without any cos, sin or division. <br>
+ * With a spread every stage gets the coefficients of f0 times its ratio, calculated in a single pass over the range. <br>
+ */
+void biquad_allpass_bank_setStages(biquad_allpass_bank *x, int first, int last, float f0, float Q, float mix);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Spreads the center frequencies of the stages across a range around f0 <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param spread The width of the range in octaves, 0 places every stage at f0 <br>
+ * @param curve The exponent of the distribution, 1 spaces the stages evenly in octaves, values above 1 gather them around f0 <br>
+ *
+ * Stage 0 stays at f0, the following ones fill the range in a van der Corput sequence, so every prefix of stages covers it evenly. <br>
+ * Only affects coefficients calculated afterwards. The ratios are recalculated for every change, a moving spread costs one exp2 per active stage. <br>
+ */
+void biquad_allpass_bank_setSpread(biquad_allpass_bank *x, float spread, float curve);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Selects the processing backend. <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param backend A biquad_allpass_backend, unsupported backends fall back to the scalar loop <br>
+ */
+void biquad_allpass_bank_setBackend(biquad_allpass_bank *x, int backend);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Enables or disables the kernels specialised for uniform stages <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param specialised 1 to use them for uniform cascades (default), 0 to always use the generic kernels <br>
+ */
+void biquad_allpass_bank_setSpecialised(biquad_allpass_bank *x, int specialised);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Returns how the active stages relate to each other <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @returns a biquad_allpass_uniformity <br>
+ *
+ * The stages are compared once after they changed, the result is cached until the next call of a setter. <br>
+ * Code writing the coefficient arrays directly has to set uniformity to -1. <br>
+ */
+int biquad_allpass_bank_uniformity(biquad_allpass_bank *x);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Selects how cos and sin of the coefficients are evaluated. <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param trigMode A biquad_allpass_trig mode <br>
+ *
+ * Only affects coefficients calculated afterwards. <br>
+ */
+void biquad_allpass_bank_setTrigMode(biquad_allpass_bank *x, int trigMode);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Sets the sample rate the coefficients are calculated for. <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param sampleRate The sample rate in Hz <br>
+ *
+ * Only affects coefficients calculated afterwards, the states are kept. <br>
+ */
+void biquad_allpass_bank_setSampleRate(biquad_allpass_bank *x, float sampleRate);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Process the incoming audio <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param in A pointer to audio input buffer <br>
+ * @param out A pointer to audio output buffer <br>
+ * @param vectorSize Size of the audio buffer <br>
+ *
+ * Filters the buffer with every active stage in a series, the output of a stage is the input of the next one. <br>
+ * Only valid for banks with a single channel. in and out may point to the same buffer. <br>
+ */
+void biquad_allpass_bank_process(biquad_allpass_bank *x, float *in, float *out, int vectorSize);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Process interleaved multichannel audio in place <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param buffer A pointer to vectorSize frames of channelStride samples each <br>
+ * @param vectorSize Amount of frames in the buffer <br>
+ *
+ * Sample n of channel c is stored at buffer[n * channelStride + c]. <br>
+ * Padding channels should be zero. <br>
+ */
+void biquad_allpass_bank_processInterleaved(biquad_allpass_bank *x, float *buffer, int vectorSize);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Process the incoming audio with a range of stages <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param in A pointer to audio input buffer <br>
+ * @param out A pointer to audio output buffer <br>
+ * @param vectorSize Size of the audio buffer <br>
+ *
+ * Same as biquad_allpass_bank_process for stages first to last - 1, the range may start at any stage. <br>
+ */
+void biquad_allpass_bank_processStages(biquad_allpass_bank *x, int first, int last, float *in, float *out, int vectorSize);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Process interleaved multichannel audio in place with a range of stages <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param buffer A pointer to vectorSize frames of channelStride samples each <br>
+ * @param vectorSize Amount of frames in the buffer <br>
+ *
+ * Same as biquad_allpass_bank_processInterleaved for stages first to last - 1. <br>
+ */
+void biquad_allpass_bank_processInterleavedStages(biquad_allpass_bank *x, int first, int last, float *buffer, int vectorSize);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Process the incoming audio with a range of stages using the scalar loop <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param in A pointer to audio input buffer <br>
+ * @param out A pointer to audio output buffer <br>
+ * @param vectorSize Size of the audio buffer <br>
+ *
+ * If the range is empty the input is copied to the output. <br>
+ */
+void biquad_allpass_bank_processRange(biquad_allpass_bank *x, int first, int last, float *in, float *out, int vectorSize);
+
+/**
+ * @related biquad_allpass_bank
+ * @brief Process a range of interleaved channels with a range of stages using the scalar loop <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param firstChannel The index of the first channel <br>
+ * @param lastChannel The index behind the last channel <br>
+ * @param buffer A pointer to vectorSize frames of channelStride samples each <br>
+ * @param vectorSize Amount of frames in the buffer <br>
+ */
+void biquad_allpass_bank_processInterleavedRange(biquad_allpass_bank *x, int first, int last, int firstChannel, int lastChannel, float *buffer, int vectorSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,829 @@
+#include "biquad_allpass_simd.h"
+#include "biquad_allpass_bank.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BQ_HAVE_X86 1
+#endif
+
+#if defined(BQ_HAVE_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define BQ_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(BQ_HAVE_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define BQ_HAVE_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BQ_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// registers per pipeline of the uniform kernels, without coefficients of their own three groups still fit into 16 registers
+#define BQ_UNIFORM_GROUPS 3
+
+typedef void (*biquad_allpass_simd_kernel)(biquad_allpass_bank *x, int first, const float *in, float *out, int vectorSize);
+typedef void (*biquad_allpass_simd_channelKernel)(biquad_allpass_bank *x, int first, int firstChannel, float *buffer, int vectorSize);
+
+
+static void biquad_allpass_simd_run(biquad_allpass_bank *x, int first, int last, biquad_allpass_simd_kernel pair, biquad_allpass_simd_kernel single, int width,
+                                    biquad_allpass_simd_kernel narrow, int narrowWidth, float *in, float *out, int vectorSize){
+    int s = first;
+
+    // width is the amount of stages per register, two registers per step hide the latency of the recursion
+    while(s + 2 * width <= last){
+        pair(x, s, in, out, vectorSize);
+        in = out;
+        s += 2 * width;
+    }
+
+    if(s + width <= last){
+        single(x, s, in, out, vectorSize);
+        in = out;
+        s += width;
+    }
+
+    // a narrower register for the stages which do not fill a wide one
+    if(narrow != NULL && s + narrowWidth <= last){
+        narrow(x, s, in, out, vectorSize);
+        in = out;
+        s += narrowWidth;
+    }
+
+    if(x->channelStride == 2)
+        biquad_allpass_bank_processInterleavedRange(x, s, last, 0, 2, out, vectorSize);
+    else
+        biquad_allpass_bank_processRange(x, s, last, in, out, vectorSize);
+}
+
+
+// a deep pipeline for uniform stages, the remaining stages through the generic kernels
+static void biquad_allpass_simd_runUniform(biquad_allpass_bank *x, int first, int last, biquad_allpass_simd_kernel deep, int depth,
+                                           biquad_allpass_simd_kernel pair, biquad_allpass_simd_kernel single, int width,
+                                           biquad_allpass_simd_kernel narrow, int narrowWidth, float *in, float *out, int vectorSize){
+    int s = first;
+
+    while(deep != NULL && s + depth <= last){
+        deep(x, s, in, out, vectorSize);
+        in = out;
+        s += depth;
+    }
+
+    biquad_allpass_simd_run(x, s, last, pair, single, width, narrow, narrowWidth, in, out, vectorSize);
+}
+
+
+static int biquad_allpass_simd_uniformity(biquad_allpass_bank *x){
+    return x->specialised ? biquad_allpass_bank_uniformity(x) : BIQUAD_ALLPASS_UNIFORMITY_MIXED;
+}
+
+
+// the kernel specialised for the uniformity of the bank, fallback if the stages differ
+static biquad_allpass_simd_kernel biquad_allpass_simd_pick(biquad_allpass_bank *x, biquad_allpass_simd_kernel uniform, biquad_allpass_simd_kernel wet,
+                                                           biquad_allpass_simd_kernel fallback){
+    switch(biquad_allpass_simd_uniformity(x)){
+        case BIQUAD_ALLPASS_UNIFORMITY_UNIFORM: return uniform;
+        case BIQUAD_ALLPASS_UNIFORMITY_WET: return wet;
+        default: return fallback;
+    }
+}
+
+
+static biquad_allpass_simd_channelKernel biquad_allpass_simd_pickChannels(biquad_allpass_bank *x, biquad_allpass_simd_channelKernel uniform,
+                                                                          biquad_allpass_simd_channelKernel wet, biquad_allpass_simd_channelKernel fallback){
+    switch(biquad_allpass_simd_uniformity(x)){
+        case BIQUAD_ALLPASS_UNIFORMITY_UNIFORM: return uniform;
+        case BIQUAD_ALLPASS_UNIFORMITY_WET: return wet;
+        default: return fallback;
+    }
+}
+
+
+static void biquad_allpass_simd_runLanes(biquad_allpass_bank *x, int first, int last, biquad_allpass_simd_channelKernel deep, biquad_allpass_simd_channelKernel single,
+                                         int firstChannel, float *buffer, int vectorSize){
+    int s = first;
+
+    // four stages per step hide the latency of the recursion
+    while(s + 4 <= last){
+        deep(x, s, firstChannel, buffer, vectorSize);
+        s += 4;
+    }
+
+    while(s < last){
+        single(x, s, firstChannel, buffer, vectorSize);
+        s++;
+    }
+}
+
+
+static void biquad_allpass_simd_runChannels(biquad_allpass_bank *x, int first, int last, biquad_allpass_simd_channelKernel deep, biquad_allpass_simd_channelKernel single, int width,
+                                            biquad_allpass_simd_channelKernel narrowDeep, biquad_allpass_simd_channelKernel narrowSingle, int narrowWidth,
+                                            float *buffer, int vectorSize){
+    int c = 0;
+
+    // padding channels are processed as well, they are silent
+    while(c + width <= x->channelStride){
+        biquad_allpass_simd_runLanes(x, first, last, deep, single, c, buffer, vectorSize);
+        c += width;
+    }
+
+    if(narrowDeep != NULL && c + narrowWidth <= x->channelStride){
+        biquad_allpass_simd_runLanes(x, first, last, narrowDeep, narrowSingle, c, buffer, vectorSize);
+        c += narrowWidth;
+    }
+
+    biquad_allpass_bank_processInterleavedRange(x, first, last, c, x->channelStride, buffer, vectorSize);
+}
+
+
+#ifdef BQ_HAVE_SSE2
+
+// coefficients of two stages, each repeated for both channels
+static inline __m128 biquad_allpass_simd_sse2_loadPairs(const float *p){
+    const __m128 v = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) p);
+    return _mm_unpacklo_ps(v, v);
+}
+
+#define BQ_TARGET
+#define BQ_WIDTH 4
+#define BQ_VEC __m128
+#define BQ_IVEC __m128i
+#define BQ_MASK __m128
+// stage ranges start anywhere, so states are accessed unaligned
+#define BQ_LOAD _mm_loadu_ps
+#define BQ_STORE _mm_storeu_ps
+#define BQ_SET1 _mm_set1_ps
+#define BQ_ADD _mm_add_ps
+#define BQ_SUB _mm_sub_ps
+#define BQ_MUL _mm_mul_ps
+#define BQ_ACTIVE(lanes, t, n) _mm_castsi128_ps(_mm_andnot_si128(_mm_cmpgt_epi32((lanes), _mm_set1_epi32(t)), \
+                                                                 _mm_cmpgt_epi32((lanes), _mm_set1_epi32((t) - (n)))))
+#define BQ_SELECT(mask, a, b) _mm_or_ps(_mm_and_ps((mask), (a)), _mm_andnot_ps((mask), (b)))
+
+#define BQ_CH 1
+#define BQ_LOADC _mm_loadu_ps
+#define BQ_LANES(first) _mm_setr_epi32((first), (first) + 1, (first) + 2, (first) + 3)
+#define BQ_SHIFT_UP(v) _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4))
+#define BQ_SHIFT_IN(v, src) _mm_move_ss(BQ_SHIFT_UP(v), _mm_load_ss(src))
+#define BQ_CARRY(v, below) _mm_move_ss(BQ_SHIFT_UP(v), _mm_shuffle_ps((below), (below), _MM_SHUFFLE(3, 3, 3, 3)))
+#define BQ_OUT(dst, v) _mm_store_ss((dst), _mm_shuffle_ps((v), (v), _MM_SHUFFLE(3, 3, 3, 3)))
+
+#define BQ_GROUPS 1
+#define BQ_KERNEL biquad_allpass_simd_sse2_single
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS 2
+#define BQ_KERNEL biquad_allpass_simd_sse2_pair
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS BQ_UNIFORM_GROUPS
+#define BQ_UNIFORM 1
+#define BQ_KERNEL biquad_allpass_simd_sse2_uniform
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_KERNEL biquad_allpass_simd_sse2_wet
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+#undef BQ_GROUPS
+
+#undef BQ_CH
+#undef BQ_LOADC
+#undef BQ_LANES
+#undef BQ_SHIFT_UP
+#undef BQ_SHIFT_IN
+#undef BQ_CARRY
+#undef BQ_OUT
+
+#define BQ_CH 2
+#define BQ_LOADC biquad_allpass_simd_sse2_loadPairs
+#define BQ_LANES(first) _mm_setr_epi32((first), (first), (first) + 1, (first) + 1)
+#define BQ_SHIFT_IN(v, src) _mm_shuffle_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) (src)), (v), _MM_SHUFFLE(1, 0, 1, 0))
+#define BQ_CARRY(v, below) _mm_shuffle_ps((below), (v), _MM_SHUFFLE(1, 0, 3, 2))
+#define BQ_OUT(dst, v) _mm_storeh_pi((__m64 *) (dst), (v))
+
+#define BQ_GROUPS 1
+#define BQ_KERNEL biquad_allpass_simd_sse2_stereo_single
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS 2
+#define BQ_KERNEL biquad_allpass_simd_sse2_stereo_pair
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS BQ_UNIFORM_GROUPS
+#define BQ_UNIFORM 1
+#define BQ_KERNEL biquad_allpass_simd_sse2_stereo_uniform
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_KERNEL biquad_allpass_simd_sse2_stereo_wet
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+#undef BQ_GROUPS
+
+#undef BQ_CH
+#undef BQ_LOADC
+#undef BQ_LANES
+#undef BQ_SHIFT_IN
+#undef BQ_CARRY
+#undef BQ_OUT
+
+#define BQ_DEPTH 1
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_sse2_channels_single
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_DEPTH
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_DEPTH 4
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_sse2_channels_deep
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_DEPTH
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_DEPTH 4
+#define BQ_UNIFORM 1
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_sse2_channels_uniform
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_UNIFORM
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_sse2_channels_wet
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_UNIFORM
+#undef BQ_CHANNEL_KERNEL
+#undef BQ_DEPTH
+
+#undef BQ_TARGET
+#undef BQ_WIDTH
+#undef BQ_VEC
+#undef BQ_IVEC
+#undef BQ_MASK
+#undef BQ_LOAD
+#undef BQ_STORE
+#undef BQ_SET1
+#undef BQ_ADD
+#undef BQ_SUB
+#undef BQ_MUL
+#undef BQ_ACTIVE
+#undef BQ_SELECT
+
+#endif
+
+
+#ifdef BQ_HAVE_AVX2
+
+#ifdef __GNUC__
+#define BQ_TARGET __attribute__((target("avx2")))
+#else
+#define BQ_TARGET
+#endif
+
+// coefficients of four stages, each repeated for both channels
+BQ_TARGET static inline __m256 biquad_allpass_simd_avx2_loadPairs(const float *p){
+    return _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+}
+#define BQ_WIDTH 8
+#define BQ_VEC __m256
+#define BQ_IVEC __m256i
+#define BQ_MASK __m256
+// stage ranges start anywhere, so states are accessed unaligned
+#define BQ_LOAD _mm256_loadu_ps
+#define BQ_STORE _mm256_storeu_ps
+#define BQ_SET1 _mm256_set1_ps
+#define BQ_ADD _mm256_add_ps
+#define BQ_SUB _mm256_sub_ps
+#define BQ_MUL _mm256_mul_ps
+#define BQ_ACTIVE(lanes, t, n) _mm256_castsi256_ps(_mm256_andnot_si256(_mm256_cmpgt_epi32((lanes), _mm256_set1_epi32(t)), \
+                                                                       _mm256_cmpgt_epi32((lanes), _mm256_set1_epi32((t) - (n)))))
+#define BQ_SELECT(mask, a, b) _mm256_blendv_ps((b), (a), (mask))
+#define BQ_HIGH(v) _mm256_extractf128_ps((v), 1)
+
+#define BQ_CH 1
+#define BQ_LOADC _mm256_loadu_ps
+#define BQ_LANES(first) _mm256_setr_epi32((first), (first) + 1, (first) + 2, (first) + 3, \
+                                          (first) + 4, (first) + 5, (first) + 6, (first) + 7)
+#define BQ_ROTATE(v) _mm256_permutevar8x32_ps((v), _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6))
+#define BQ_SHIFT_IN(v, src) _mm256_blend_ps(BQ_ROTATE(v), _mm256_broadcast_ss(src), 1)
+#define BQ_CARRY(v, below) _mm256_blend_ps(BQ_ROTATE(v), BQ_ROTATE(below), 1)
+#define BQ_OUT(dst, v) _mm_store_ss((dst), _mm_shuffle_ps(BQ_HIGH(v), BQ_HIGH(v), _MM_SHUFFLE(3, 3, 3, 3)))
+
+#define BQ_GROUPS 1
+#define BQ_KERNEL biquad_allpass_simd_avx2_single
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS 2
+#define BQ_KERNEL biquad_allpass_simd_avx2_pair
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS BQ_UNIFORM_GROUPS
+#define BQ_UNIFORM 1
+#define BQ_KERNEL biquad_allpass_simd_avx2_uniform
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_KERNEL biquad_allpass_simd_avx2_wet
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+#undef BQ_GROUPS
+
+#undef BQ_CH
+#undef BQ_LOADC
+#undef BQ_LANES
+#undef BQ_ROTATE
+#undef BQ_SHIFT_IN
+#undef BQ_CARRY
+#undef BQ_OUT
+
+#define BQ_CH 2
+#define BQ_LOADC biquad_allpass_simd_avx2_loadPairs
+#define BQ_LANES(first) _mm256_setr_epi32((first), (first), (first) + 1, (first) + 1, \
+                                          (first) + 2, (first) + 2, (first) + 3, (first) + 3)
+#define BQ_ROTATE(v) _mm256_permutevar8x32_ps((v), _mm256_setr_epi32(6, 7, 0, 1, 2, 3, 4, 5))
+#define BQ_SHIFT_IN(v, src) _mm256_blend_ps(BQ_ROTATE(v), _mm256_castpd_ps(_mm256_broadcast_sd((const double *) (src))), 3)
+#define BQ_CARRY(v, below) _mm256_blend_ps(BQ_ROTATE(v), BQ_ROTATE(below), 3)
+#define BQ_OUT(dst, v) _mm_storeh_pi((__m64 *) (dst), BQ_HIGH(v))
+
+#define BQ_GROUPS 1
+#define BQ_KERNEL biquad_allpass_simd_avx2_stereo_single
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS 2
+#define BQ_KERNEL biquad_allpass_simd_avx2_stereo_pair
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS BQ_UNIFORM_GROUPS
+#define BQ_UNIFORM 1
+#define BQ_KERNEL biquad_allpass_simd_avx2_stereo_uniform
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_KERNEL biquad_allpass_simd_avx2_stereo_wet
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+#undef BQ_GROUPS
+
+#undef BQ_CH
+#undef BQ_LOADC
+#undef BQ_LANES
+#undef BQ_ROTATE
+#undef BQ_SHIFT_IN
+#undef BQ_CARRY
+#undef BQ_OUT
+
+#define BQ_DEPTH 1
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_avx2_channels_single
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_DEPTH
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_DEPTH 4
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_avx2_channels_deep
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_DEPTH
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_DEPTH 4
+#define BQ_UNIFORM 1
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_avx2_channels_uniform
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_UNIFORM
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_avx2_channels_wet
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_UNIFORM
+#undef BQ_CHANNEL_KERNEL
+#undef BQ_DEPTH
+
+#undef BQ_TARGET
+#undef BQ_WIDTH
+#undef BQ_VEC
+#undef BQ_IVEC
+#undef BQ_MASK
+#undef BQ_LOAD
+#undef BQ_STORE
+#undef BQ_SET1
+#undef BQ_ADD
+#undef BQ_SUB
+#undef BQ_MUL
+#undef BQ_ACTIVE
+#undef BQ_SELECT
+#undef BQ_HIGH
+
+#endif
+
+
+#ifdef BQ_HAVE_NEON
+
+// stage index of every lane with channels lanes per stage
+static inline int32x4_t biquad_allpass_simd_neon_lanes(int first, int channels){
+    const int32_t lanes[4] = {first, first + 1 / channels, first + 2 / channels, first + 3 / channels};
+    return vld1q_s32(lanes);
+}
+
+// coefficients of two stages, each repeated for both channels
+static inline float32x4_t biquad_allpass_simd_neon_loadPairs(const float *p){
+    const float32x2_t v = vld1_f32(p);
+    return vcombine_f32(vdup_lane_f32(v, 0), vdup_lane_f32(v, 1));
+}
+
+#define BQ_TARGET
+#define BQ_WIDTH 4
+#define BQ_VEC float32x4_t
+#define BQ_IVEC int32x4_t
+#define BQ_MASK uint32x4_t
+#define BQ_LOAD vld1q_f32
+#define BQ_STORE vst1q_f32
+#define BQ_SET1 vdupq_n_f32
+#define BQ_ADD vaddq_f32
+#define BQ_SUB vsubq_f32
+#define BQ_MUL vmulq_f32
+#define BQ_ACTIVE(lanes, t, n) vandq_u32(vcleq_s32((lanes), vdupq_n_s32(t)), vcgtq_s32((lanes), vdupq_n_s32((t) - (n))))
+#define BQ_SELECT(mask, a, b) vbslq_f32((mask), (a), (b))
+
+#define BQ_CH 1
+#define BQ_LOADC vld1q_f32
+#define BQ_LANES(first) biquad_allpass_simd_neon_lanes(first, 1)
+#define BQ_SHIFT_IN(v, src) vextq_f32(vld1q_dup_f32(src), (v), 3)
+#define BQ_CARRY(v, below) vextq_f32((below), (v), 3)
+#define BQ_OUT(dst, v) vst1q_lane_f32((dst), (v), 3)
+
+#define BQ_GROUPS 1
+#define BQ_KERNEL biquad_allpass_simd_neon_single
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS 2
+#define BQ_KERNEL biquad_allpass_simd_neon_pair
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS BQ_UNIFORM_GROUPS
+#define BQ_UNIFORM 1
+#define BQ_KERNEL biquad_allpass_simd_neon_uniform
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_KERNEL biquad_allpass_simd_neon_wet
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+#undef BQ_GROUPS
+
+#undef BQ_CH
+#undef BQ_LOADC
+#undef BQ_LANES
+#undef BQ_SHIFT_IN
+#undef BQ_CARRY
+#undef BQ_OUT
+
+#define BQ_CH 2
+#define BQ_LOADC biquad_allpass_simd_neon_loadPairs
+#define BQ_LANES(first) biquad_allpass_simd_neon_lanes(first, 2)
+#define BQ_SHIFT_IN(v, src) vextq_f32(vcombine_f32(vld1_f32(src), vld1_f32(src)), (v), 2)
+#define BQ_CARRY(v, below) vextq_f32((below), (v), 2)
+#define BQ_OUT(dst, v) vst1_f32((dst), vget_high_f32(v))
+
+#define BQ_GROUPS 1
+#define BQ_KERNEL biquad_allpass_simd_neon_stereo_single
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS 2
+#define BQ_KERNEL biquad_allpass_simd_neon_stereo_pair
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_GROUPS
+#undef BQ_KERNEL
+
+#define BQ_GROUPS BQ_UNIFORM_GROUPS
+#define BQ_UNIFORM 1
+#define BQ_KERNEL biquad_allpass_simd_neon_stereo_uniform
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_KERNEL biquad_allpass_simd_neon_stereo_wet
+#include "biquad_allpass_simd_kernel.h"
+#undef BQ_UNIFORM
+#undef BQ_KERNEL
+#undef BQ_GROUPS
+
+#undef BQ_CH
+#undef BQ_LOADC
+#undef BQ_LANES
+#undef BQ_SHIFT_IN
+#undef BQ_CARRY
+#undef BQ_OUT
+
+#define BQ_DEPTH 1
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_neon_channels_single
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_DEPTH
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_DEPTH 4
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_neon_channels_deep
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_DEPTH
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_DEPTH 4
+#define BQ_UNIFORM 1
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_neon_channels_uniform
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_UNIFORM
+#undef BQ_CHANNEL_KERNEL
+
+#define BQ_UNIFORM 2
+#define BQ_CHANNEL_KERNEL biquad_allpass_simd_neon_channels_wet
+#include "biquad_allpass_simd_channels.h"
+#undef BQ_UNIFORM
+#undef BQ_CHANNEL_KERNEL
+#undef BQ_DEPTH
+
+#undef BQ_TARGET
+#undef BQ_WIDTH
+#undef BQ_VEC
+#undef BQ_IVEC
+#undef BQ_MASK
+#undef BQ_LOAD
+#undef BQ_STORE
+#undef BQ_SET1
+#undef BQ_ADD
+#undef BQ_SUB
+#undef BQ_MUL
+#undef BQ_ACTIVE
+#undef BQ_SELECT
+
+#endif
+
+
+static int biquad_allpass_simd_cpuHasAvx2(void){
+
+#if defined(BQ_HAVE_AVX2) && defined(__GNUC__)
+
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+
+#elif defined(BQ_HAVE_AVX2) && defined(_MSC_VER)
+
+    int info[4];
+
+    __cpuid(info, 0);
+    if(info[0] < 7)
+        return 0;
+
+    // the os has to save the ymm registers
+    __cpuid(info, 1);
+    if(!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+        return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+
+#else
+
+    return 0;
+
+#endif
+}
+
+
+int biquad_allpass_simd_isSupported(biquad_allpass_backend backend){
+
+    static int hasAvx2 = -1;
+
+    switch(backend){
+        case BIQUAD_ALLPASS_BACKEND_SCALAR:
+            return 1;
+
+#ifdef BQ_HAVE_SSE2
+        case BIQUAD_ALLPASS_BACKEND_SSE2:
+            return 1;
+#endif
+
+#ifdef BQ_HAVE_AVX2
+        case BIQUAD_ALLPASS_BACKEND_AVX2:
+            if(hasAvx2 < 0)
+                hasAvx2 = biquad_allpass_simd_cpuHasAvx2();
+            return hasAvx2;
+#endif
+
+#ifdef BQ_HAVE_NEON
+        case BIQUAD_ALLPASS_BACKEND_NEON:
+            return 1;
+#endif
+
+        default:
+            return 0;
+    }
+}
+
+
+biquad_allpass_backend biquad_allpass_simd_detect(void){
+
+    if(biquad_allpass_simd_isSupported(BIQUAD_ALLPASS_BACKEND_AVX2))
+        return BIQUAD_ALLPASS_BACKEND_AVX2;
+
+    if(biquad_allpass_simd_isSupported(BIQUAD_ALLPASS_BACKEND_SSE2))
+        return BIQUAD_ALLPASS_BACKEND_SSE2;
+
+    if(biquad_allpass_simd_isSupported(BIQUAD_ALLPASS_BACKEND_NEON))
+        return BIQUAD_ALLPASS_BACKEND_NEON;
+
+    return BIQUAD_ALLPASS_BACKEND_SCALAR;
+}
+
+
+biquad_allpass_backend biquad_allpass_simd_resolve(biquad_allpass_backend backend){
+
+    if(backend == BIQUAD_ALLPASS_BACKEND_AUTO)
+        return biquad_allpass_simd_detect();
+
+    if(biquad_allpass_simd_isSupported(backend))
+        return backend;
+
+    return BIQUAD_ALLPASS_BACKEND_SCALAR;
+}
+
+
+const char *biquad_allpass_simd_name(biquad_allpass_backend backend){
+
+    switch(backend){
+        case BIQUAD_ALLPASS_BACKEND_AUTO: return "auto";
+        case BIQUAD_ALLPASS_BACKEND_SCALAR: return "scalar";
+        case BIQUAD_ALLPASS_BACKEND_SSE2: return "sse2";
+        case BIQUAD_ALLPASS_BACKEND_AVX2: return "avx2";
+        case BIQUAD_ALLPASS_BACKEND_NEON: return "neon";
+        default: return "unknown";
+    }
+}
+
+
+void biquad_allpass_simd_process(biquad_allpass_bank *x, biquad_allpass_backend backend, int first, int last, float *in, float *out, int vectorSize){
+
+    switch(backend){
+
+#ifdef BQ_HAVE_SSE2
+        case BIQUAD_ALLPASS_BACKEND_SSE2:
+            biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_sse2_uniform, biquad_allpass_simd_sse2_wet, NULL),
+                                           4 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_sse2_pair, biquad_allpass_simd_sse2_single, 4, NULL, 0, in, out, vectorSize);
+            break;
+#endif
+
+#ifdef BQ_HAVE_AVX2
+        case BIQUAD_ALLPASS_BACKEND_AVX2:
+#ifdef BQ_HAVE_SSE2
+            biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_avx2_uniform, biquad_allpass_simd_avx2_wet, NULL),
+                                           8 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_avx2_pair, biquad_allpass_simd_avx2_single, 8,
+                                           biquad_allpass_simd_sse2_single, 4, in, out, vectorSize);
+#else
+            biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_avx2_uniform, biquad_allpass_simd_avx2_wet, NULL),
+                                           8 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_avx2_pair, biquad_allpass_simd_avx2_single, 8, NULL, 0, in, out, vectorSize);
+#endif
+            break;
+#endif
+
+#ifdef BQ_HAVE_NEON
+        case BIQUAD_ALLPASS_BACKEND_NEON:
+            biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_neon_uniform, biquad_allpass_simd_neon_wet, NULL),
+                                           4 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_neon_pair, biquad_allpass_simd_neon_single, 4, NULL, 0, in, out, vectorSize);
+            break;
+#endif
+
+        default:
+            biquad_allpass_bank_processRange(x, first, last, in, out, vectorSize);
+            break;
+    }
+}
+
+
+void biquad_allpass_simd_processInterleaved(biquad_allpass_bank *x, biquad_allpass_backend backend, int first, int last, float *buffer, int vectorSize){
+
+    // stereo runs through the pipelined kernel with both channels of a stage side by side
+    if(x->channelStride == 2){
+        switch(backend){
+
+#ifdef BQ_HAVE_SSE2
+            case BIQUAD_ALLPASS_BACKEND_SSE2:
+                biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_sse2_stereo_uniform, biquad_allpass_simd_sse2_stereo_wet, NULL),
+                                               2 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_sse2_stereo_pair, biquad_allpass_simd_sse2_stereo_single, 2,
+                                               NULL, 0, buffer, buffer, vectorSize);
+                return;
+#endif
+
+#ifdef BQ_HAVE_AVX2
+            case BIQUAD_ALLPASS_BACKEND_AVX2:
+#ifdef BQ_HAVE_SSE2
+                biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_avx2_stereo_uniform, biquad_allpass_simd_avx2_stereo_wet, NULL),
+                                               4 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_avx2_stereo_pair, biquad_allpass_simd_avx2_stereo_single, 4,
+                                               biquad_allpass_simd_sse2_stereo_single, 2, buffer, buffer, vectorSize);
+#else
+                biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_avx2_stereo_uniform, biquad_allpass_simd_avx2_stereo_wet, NULL),
+                                               4 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_avx2_stereo_pair, biquad_allpass_simd_avx2_stereo_single, 4,
+                                               NULL, 0, buffer, buffer, vectorSize);
+#endif
+                return;
+#endif
+
+#ifdef BQ_HAVE_NEON
+            case BIQUAD_ALLPASS_BACKEND_NEON:
+                biquad_allpass_simd_runUniform(x, first, last, biquad_allpass_simd_pick(x, biquad_allpass_simd_neon_stereo_uniform, biquad_allpass_simd_neon_stereo_wet, NULL),
+                                               2 * BQ_UNIFORM_GROUPS, biquad_allpass_simd_neon_stereo_pair, biquad_allpass_simd_neon_stereo_single, 2,
+                                               NULL, 0, buffer, buffer, vectorSize);
+                return;
+#endif
+
+            default:
+                biquad_allpass_bank_processInterleavedRange(x, first, last, 0, 2, buffer, vectorSize);
+                return;
+        }
+    }
+
+#ifdef BQ_HAVE_SSE2
+    const biquad_allpass_simd_channelKernel sse2Deep = biquad_allpass_simd_pickChannels(x, biquad_allpass_simd_sse2_channels_uniform, biquad_allpass_simd_sse2_channels_wet,
+                                                                                        biquad_allpass_simd_sse2_channels_deep);
+#endif
+#ifdef BQ_HAVE_AVX2
+    const biquad_allpass_simd_channelKernel avx2Deep = biquad_allpass_simd_pickChannels(x, biquad_allpass_simd_avx2_channels_uniform, biquad_allpass_simd_avx2_channels_wet,
+                                                                                        biquad_allpass_simd_avx2_channels_deep);
+#endif
+#ifdef BQ_HAVE_NEON
+    const biquad_allpass_simd_channelKernel neonDeep = biquad_allpass_simd_pickChannels(x, biquad_allpass_simd_neon_channels_uniform, biquad_allpass_simd_neon_channels_wet,
+                                                                                        biquad_allpass_simd_neon_channels_deep);
+#endif
+
+    switch(backend){
+
+#ifdef BQ_HAVE_SSE2
+        case BIQUAD_ALLPASS_BACKEND_SSE2:
+            biquad_allpass_simd_runChannels(x, first, last, sse2Deep, biquad_allpass_simd_sse2_channels_single, 4,
+                                            NULL, NULL, 0, buffer, vectorSize);
+            break;
+#endif
+
+#ifdef BQ_HAVE_AVX2
+        case BIQUAD_ALLPASS_BACKEND_AVX2:
+#ifdef BQ_HAVE_SSE2
+            biquad_allpass_simd_runChannels(x, first, last, avx2Deep, biquad_allpass_simd_avx2_channels_single, 8,
+                                            sse2Deep, biquad_allpass_simd_sse2_channels_single, 4,
+                                            buffer, vectorSize);
+#else
+            biquad_allpass_simd_runChannels(x, first, last, avx2Deep, biquad_allpass_simd_avx2_channels_single, 8,
+                                            NULL, NULL, 0, buffer, vectorSize);
+#endif
+            break;
+#endif
+
+#ifdef BQ_HAVE_NEON
+        case BIQUAD_ALLPASS_BACKEND_NEON:
+            biquad_allpass_simd_runChannels(x, first, last, neonDeep, biquad_allpass_simd_neon_channels_single, 4,
+                                            NULL, NULL, 0, buffer, vectorSize);
+            break;
+#endif
+
+        default:
+            biquad_allpass_bank_processInterleavedRange(x, first, last, 0, x->nChannels, buffer, vectorSize);
+            break;
+    }
+}
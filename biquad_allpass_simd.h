@@ -0,0 +1,102 @@
+/**
+ * @file biquad_allpass_simd.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief Vectorised processing of a biquad_allpass_bank
+ *
+ * The cascade is pipelined across the lanes of a SIMD register: lane k holds stage k of a group of consecutive stages. <br>
+ * In every step each lane filters one sample and hands its output to the next lane, so lane k runs k samples behind lane 0. <br>
+ * The first and last steps of every vector are masked, so no latency is added and the bank state stays identical to the scalar path. <br>
+ * <br>
+ * Stereo banks use the same pipeline with both channels of a stage in neighbouring lanes, so a register holds half as many stages. <br>
+ * Banks with more channels use a second kernel where every lane filters one channel of an interleaved buffer and all lanes share the coefficients of a stage. <br>
+ * <br>
+ * Both kernels exist a second time for cascades of identical stages (see biquad_allpass_bank_uniformity). <br>
+ * They keep one broadcast set of coefficients for all stages, so the pipelined kernel runs three registers deep instead of two. <br>
+ * <br>
+ * Each lane evaluates exactly the same expression as biquad_allpass_bank_process. <br>
+ * Without floating point contraction the output is bit-identical to the scalar path. <br>
+ * Builds with -ffast-math may reorder the sums differently in both paths; the deviation then stays below 1e-5 (absolute, full scale input). <br>
+ */
+
+#ifndef bq_allpass_simd
+#define bq_allpass_simd
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct biquad_allpass_bank;
+
+/**
+ * @brief The processing backends of a biquad_allpass_bank <br>
+ */
+typedef enum biquad_allpass_backend{
+    BIQUAD_ALLPASS_BACKEND_AUTO = 0, /**< Select the fastest backend supported by the cpu */
+    BIQUAD_ALLPASS_BACKEND_SCALAR, /**< Portable scalar loop */
+    BIQUAD_ALLPASS_BACKEND_SSE2, /**< 4 stages per register, x86 */
+    BIQUAD_ALLPASS_BACKEND_AVX2, /**< 8 stages per register, x86 */
+    BIQUAD_ALLPASS_BACKEND_NEON, /**< 4 stages per register, arm */
+    BIQUAD_ALLPASS_BACKEND_COUNT /**< Amount of backends */
+} biquad_allpass_backend;
+
+/**
+ * @brief Returns the fastest backend the cpu supports <br>
+ *
+ * The cpu features are queried once and cached. <br>
+ */
+biquad_allpass_backend biquad_allpass_simd_detect(void);
+
+/**
+ * @brief Checks if a backend has been compiled in and is supported by the cpu <br>
+ * @param backend The backend to check <br>
+ * @returns 1 if the backend can be used, 0 otherwise <br>
+ */
+int biquad_allpass_simd_isSupported(biquad_allpass_backend backend);
+
+/**
+ * @brief Resolves a requested backend to one that can be used <br>
+ * @param backend The requested backend <br>
+ * @returns backend if it is supported, the detected backend for BIQUAD_ALLPASS_BACKEND_AUTO and the scalar backend otherwise <br>
+ */
+biquad_allpass_backend biquad_allpass_simd_resolve(biquad_allpass_backend backend);
+
+/**
+ * @brief Returns a printable name of a backend <br>
+ * @param backend The backend <br>
+ */
+const char *biquad_allpass_simd_name(biquad_allpass_backend backend);
+
+/**
+ * @brief Process the incoming audio with a range of stages using a vectorised backend <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param backend A supported backend other than BIQUAD_ALLPASS_BACKEND_AUTO <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param in A pointer to audio input buffer <br>
+ * @param out A pointer to audio output buffer <br>
+ * @param vectorSize Size of the audio buffer <br>
+ *
+ * Full groups of stages are processed by the pipelined kernel, remaining stages by the scalar loop. <br>
+ * in and out may point to the same buffer. <br>
+ */
+void biquad_allpass_simd_process(struct biquad_allpass_bank *x, biquad_allpass_backend backend, int first, int last, float *in, float *out, int vectorSize);
+
+/**
+ * @brief Process interleaved multichannel audio in place with a range of stages using a vectorised backend <br>
+ * @param x A pointer to the biquad_allpass_bank object <br>
+ * @param backend A supported backend other than BIQUAD_ALLPASS_BACKEND_AUTO <br>
+ * @param first The index of the first stage <br>
+ * @param last The index behind the last stage <br>
+ * @param buffer A pointer to vectorSize frames of channelStride samples each <br>
+ * @param vectorSize Amount of frames in the buffer <br>
+ *
+ * See biquad_allpass_bank_processInterleavedStages. <br>
+ */
+void biquad_allpass_simd_processInterleaved(struct biquad_allpass_bank *x, biquad_allpass_backend backend, int first, int last, float *buffer, int vectorSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file biquad_allpass_simd_channels.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief Template of the multichannel cascade kernel
+ *
+ * This file is included by biquad_allpass_simd.c once per instruction set and pipeline depth, it has no include guard on purpose. <br>
+ * It expects the same definitions as biquad_allpass_simd_kernel.h plus BQ_CHANNEL_KERNEL and BQ_DEPTH, loads and stores have to accept unaligned addresses. <br>
+ * <br>
+ * Every lane processes one channel of an interleaved buffer. All lanes share the broadcast coefficients of a stage. <br>
+ * BQ_DEPTH consecutive stages are kept in separate registers and run one sample apart, <br>
+ * so the recursions of the stages are independent within a step and their latencies overlap. <br>
+ * BQ_UNIFORM shares the coefficients of the first stage among all stages, like in biquad_allpass_simd_kernel.h. <br>
+ */
+
+#if defined(BQ_UNIFORM) && BQ_UNIFORM > 0
+#define BQ_SHARED 1
+#else
+#define BQ_SHARED 0
+#endif
+
+BQ_TARGET static void BQ_CHANNEL_KERNEL(biquad_allpass_bank *x, int first, int firstChannel, float *buffer, int vectorSize){
+
+    const int stride = x->channelStride;
+    const int steps = vectorSize + BQ_DEPTH - 1;
+
+#if BQ_SHARED
+    const BQ_VEC a1 = BQ_SET1(x->a1_over_a0[first]);
+    const BQ_VEC a2 = BQ_SET1(x->a2_over_a0[first]);
+#if BQ_UNIFORM != 2
+    const BQ_VEC wet = BQ_SET1(x->mix[first]);
+    const BQ_VEC dry = BQ_SET1(1 - x->mix[first]);
+#endif
+#else
+    BQ_VEC b0[BQ_DEPTH], b1[BQ_DEPTH], b2[BQ_DEPTH], a1[BQ_DEPTH], a2[BQ_DEPTH];
+    BQ_VEC wet[BQ_DEPTH], dry[BQ_DEPTH];
+#endif
+    BQ_VEC lastIn[BQ_DEPTH], lastLastIn[BQ_DEPTH], lastOut[BQ_DEPTH], lastLastOut[BQ_DEPTH];
+
+    for(int k=0; k<BQ_DEPTH; k++){
+        const int s = first + k;
+        const int o = s * stride + firstChannel;
+
+#if !BQ_SHARED
+        b0[k] = BQ_SET1(x->b0_over_a0[s]);
+        b1[k] = BQ_SET1(x->b1_over_a0[s]);
+        b2[k] = BQ_SET1(x->b2_over_a0[s]);
+        a1[k] = BQ_SET1(x->a1_over_a0[s]);
+        a2[k] = BQ_SET1(x->a2_over_a0[s]);
+        wet[k] = BQ_SET1(x->mix[s]);
+        dry[k] = BQ_SET1(1 - x->mix[s]);
+#endif
+
+        lastIn[k] = BQ_LOAD(x->lastIn + o);
+        lastLastIn[k] = BQ_LOAD(x->lastLastIn + o);
+        lastOut[k] = BQ_LOAD(x->lastOut + o);
+        lastLastOut[k] = BQ_LOAD(x->lastLastOut + o);
+    }
+
+    for(int t=0; t<steps; t++){
+
+        // the last stage first, so every stage still sees the output of its predecessor from the last step
+        for(int k=BQ_DEPTH-1; k>=0; k--){
+            const int n = t - k;
+            BQ_VEC currentIn;
+            BQ_VEC currentOut;
+
+            if(n < 0 || n >= vectorSize)
+                continue;
+
+            currentIn = k == 0 ? BQ_LOAD(buffer + n * stride + firstChannel) : lastOut[k-1];
+
+#if BQ_SHARED
+            currentOut = BQ_SUB(BQ_SUB(BQ_ADD(BQ_ADD(BQ_MUL(a2, currentIn),
+                                                     BQ_MUL(a1, lastIn[k])),
+                                              lastLastIn[k]),
+                                       BQ_MUL(a1, lastOut[k])),
+                                BQ_MUL(a2, lastLastOut[k]));
+#if BQ_UNIFORM != 2
+            currentOut = BQ_ADD(BQ_MUL(dry, currentIn),
+                                BQ_MUL(wet, currentOut));
+#endif
+#else
+            currentOut = BQ_SUB(BQ_SUB(BQ_ADD(BQ_ADD(BQ_MUL(b0[k], currentIn),
+                                                     BQ_MUL(b1[k], lastIn[k])),
+                                              BQ_MUL(b2[k], lastLastIn[k])),
+                                       BQ_MUL(a1[k], lastOut[k])),
+                                BQ_MUL(a2[k], lastLastOut[k]));
+
+            currentOut = BQ_ADD(BQ_MUL(dry[k], currentIn),
+                                BQ_MUL(wet[k], currentOut));
+#endif
+
+            if(k == BQ_DEPTH-1)
+                BQ_STORE(buffer + n * stride + firstChannel, currentOut);
+
+            lastLastOut[k] = lastOut[k];
+            lastOut[k] = currentOut;
+            lastLastIn[k] = lastIn[k];
+            lastIn[k] = currentIn;
+        }
+    }
+
+    for(int k=0; k<BQ_DEPTH; k++){
+        const int o = (first + k) * stride + firstChannel;
+
+        BQ_STORE(x->lastIn + o, lastIn[k]);
+        BQ_STORE(x->lastLastIn + o, lastLastIn[k]);
+        BQ_STORE(x->lastOut + o, lastOut[k]);
+        BQ_STORE(x->lastLastOut + o, lastLastOut[k]);
+    }
+}
+
+#undef BQ_SHARED
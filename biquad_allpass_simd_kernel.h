@@ -0,0 +1,143 @@
+/**
+ * @file biquad_allpass_simd_kernel.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief Template of the pipelined cascade kernel
+ *
+ * This file is included by biquad_allpass_simd.c once per instruction set, channel count and group count, it has no include guard on purpose. <br>
+ * The including file defines the vector type and operations: <br>
+ * BQ_KERNEL, BQ_TARGET, BQ_GROUPS, BQ_WIDTH, BQ_CH (channels per stage, 1 or 2), BQ_VEC, BQ_IVEC, BQ_MASK, <br>
+ * BQ_LOAD, BQ_STORE, BQ_LOADC (coefficients of BQ_WIDTH / BQ_CH stages, each repeated BQ_CH times), BQ_SET1, BQ_ADD, BQ_SUB, BQ_MUL, <br>
+ * BQ_LANES(first) (stage index of every lane), BQ_ACTIVE(lanes, t, n) (lanes which filter a sample in step t), BQ_SELECT(mask, a, b), <br>
+ * BQ_SHIFT_IN(v, src) (lanes moved up by BQ_CH, the BQ_CH samples at src in the lowest lanes), <br>
+ * BQ_CARRY(v, below) (lanes moved up by BQ_CH, the highest BQ_CH lanes of below in the lowest lanes) <br>
+ * and BQ_OUT(dst, v) (stores the highest BQ_CH lanes). <br>
+ * <br>
+ * BQ_GROUPS registers of BQ_WIDTH / BQ_CH stages each form one pipeline, the registers are independent within a step which hides the latency of the recursion. <br>
+ * With BQ_CH == 2 the buffers hold interleaved stereo frames. <br>
+ * <br>
+ * Optionally BQ_UNIFORM selects a kernel for uniform stages, 1 for BIQUAD_ALLPASS_UNIFORMITY_UNIFORM and 2 for BIQUAD_ALLPASS_UNIFORMITY_WET <br>
+ * (a number, the preprocessor cannot compare enum constants). <br>
+ * The coefficients of the first stage are then broadcast once and shared by all groups, b0, b1 and b2 are replaced by a2, a1 and 1. <br>
+ * With BIQUAD_ALLPASS_UNIFORMITY_WET the dry wet mix is left out as well. <br>
+ * Fewer live registers allow more groups without spilling. <br>
+ */
+
+#if defined(BQ_UNIFORM) && BQ_UNIFORM > 0
+#define BQ_SHARED 1
+#else
+#define BQ_SHARED 0
+#endif
+
+BQ_TARGET static void BQ_KERNEL(biquad_allpass_bank *x, int first, const float *in, float *out, int vectorSize){
+
+    static const float silence[BQ_CH];
+
+    const int stages = BQ_WIDTH / BQ_CH;
+    const int depth = BQ_GROUPS * stages;
+    const int steps = vectorSize + depth - 1;
+
+#if BQ_SHARED
+    const BQ_VEC a1 = BQ_SET1(x->a1_over_a0[first]);
+    const BQ_VEC a2 = BQ_SET1(x->a2_over_a0[first]);
+#if BQ_UNIFORM != 2
+    const BQ_VEC wet = BQ_SET1(x->mix[first]);
+    const BQ_VEC dry = BQ_SUB(BQ_SET1(1.0f), wet);
+#endif
+#else
+    BQ_VEC b0[BQ_GROUPS], b1[BQ_GROUPS], b2[BQ_GROUPS], a1[BQ_GROUPS], a2[BQ_GROUPS];
+    BQ_VEC wet[BQ_GROUPS], dry[BQ_GROUPS];
+#endif
+    BQ_VEC lastIn[BQ_GROUPS], lastLastIn[BQ_GROUPS], lastOut[BQ_GROUPS], lastLastOut[BQ_GROUPS];
+    BQ_IVEC lanes[BQ_GROUPS];
+
+    for(int g=0; g<BQ_GROUPS; g++){
+        const int s = first + g * stages;
+
+#if !BQ_SHARED
+        b0[g] = BQ_LOADC(x->b0_over_a0 + s);
+        b1[g] = BQ_LOADC(x->b1_over_a0 + s);
+        b2[g] = BQ_LOADC(x->b2_over_a0 + s);
+        a1[g] = BQ_LOADC(x->a1_over_a0 + s);
+        a2[g] = BQ_LOADC(x->a2_over_a0 + s);
+        wet[g] = BQ_LOADC(x->mix + s);
+        dry[g] = BQ_SUB(BQ_SET1(1.0f), wet[g]);
+#endif
+
+        lastIn[g] = BQ_LOAD(x->lastIn + s * BQ_CH);
+        lastLastIn[g] = BQ_LOAD(x->lastLastIn + s * BQ_CH);
+        lastOut[g] = BQ_LOAD(x->lastOut + s * BQ_CH);
+        lastLastOut[g] = BQ_LOAD(x->lastLastOut + s * BQ_CH);
+
+        lanes[g] = BQ_LANES(g * stages);
+    }
+
+    for(int t=0; t<steps; t++){
+        BQ_VEC currentIn[BQ_GROUPS];
+        BQ_VEC currentOut[BQ_GROUPS];
+
+        // every stage takes the sample its predecessor filtered in the last step
+        for(int g=BQ_GROUPS-1; g>0; g--)
+            currentIn[g] = BQ_CARRY(lastOut[g], lastOut[g-1]);
+        currentIn[0] = BQ_SHIFT_IN(lastOut[0], t < vectorSize ? in + t * BQ_CH : silence);
+
+        for(int g=0; g<BQ_GROUPS; g++){
+#if BQ_SHARED
+            // the same sums as below, b0 equals a2, b1 equals a1 and b2 is 1
+            currentOut[g] = BQ_SUB(BQ_SUB(BQ_ADD(BQ_ADD(BQ_MUL(a2, currentIn[g]),
+                                                         BQ_MUL(a1, lastIn[g])),
+                                                  lastLastIn[g]),
+                                           BQ_MUL(a1, lastOut[g])),
+                                    BQ_MUL(a2, lastLastOut[g]));
+#if BQ_UNIFORM != 2
+            currentOut[g] = BQ_ADD(BQ_MUL(dry, currentIn[g]),
+                                   BQ_MUL(wet, currentOut[g]));
+#endif
+#else
+            currentOut[g] = BQ_SUB(BQ_SUB(BQ_ADD(BQ_ADD(BQ_MUL(b0[g], currentIn[g]),
+                                                         BQ_MUL(b1[g], lastIn[g])),
+                                                  BQ_MUL(b2[g], lastLastIn[g])),
+                                           BQ_MUL(a1[g], lastOut[g])),
+                                    BQ_MUL(a2[g], lastLastOut[g]));
+
+            currentOut[g] = BQ_ADD(BQ_MUL(dry[g], currentIn[g]),
+                                   BQ_MUL(wet[g], currentOut[g]));
+#endif
+        }
+
+        if(t >= depth - 1 && t < vectorSize){
+            // all stages hold a valid sample
+            for(int g=0; g<BQ_GROUPS; g++){
+                lastLastOut[g] = lastOut[g];
+                lastOut[g] = currentOut[g];
+                lastLastIn[g] = lastIn[g];
+                lastIn[g] = currentIn[g];
+            }
+        }
+        else{
+            // filling or draining the pipeline, idle stages keep their state
+            for(int g=0; g<BQ_GROUPS; g++){
+                const BQ_MASK active = BQ_ACTIVE(lanes[g], t, vectorSize);
+
+                lastLastOut[g] = BQ_SELECT(active, lastOut[g], lastLastOut[g]);
+                lastOut[g] = BQ_SELECT(active, currentOut[g], lastOut[g]);
+                lastLastIn[g] = BQ_SELECT(active, lastIn[g], lastLastIn[g]);
+                lastIn[g] = BQ_SELECT(active, currentIn[g], lastIn[g]);
+            }
+        }
+
+        if(t >= depth - 1)
+            BQ_OUT(out + (t - depth + 1) * BQ_CH, currentOut[BQ_GROUPS-1]);
+    }
+
+    for(int g=0; g<BQ_GROUPS; g++){
+        const int s = first + g * stages;
+
+        BQ_STORE(x->lastIn + s * BQ_CH, lastIn[g]);
+        BQ_STORE(x->lastLastIn + s * BQ_CH, lastLastIn[g]);
+        BQ_STORE(x->lastOut + s * BQ_CH, lastOut[g]);
+        BQ_STORE(x->lastLastOut + s * BQ_CH, lastLastOut[g]);
+    }
+}
+
+#undef BQ_SHARED
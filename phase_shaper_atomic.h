@@ -0,0 +1,95 @@
+/**
+ * @file phase_shaper_atomic.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief Minimal atomic operations on int for the lock-free parts of phase_shaper
+ *
+ * Maps to the __atomic builtins of gcc and clang and to the Interlocked functions of msvc. <br>
+ * All operations are sequentially consistent, which is enough for the handful of flags and indices they guard. <br>
+ */
+
+#ifndef ps_atomic
+#define ps_atomic
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reads an int shared between threads <br>
+ * @param p A pointer to the shared int <br>
+ * @returns The current value <br>
+ */
+static inline int phase_shaper_atomic_load(volatile int *p){
+#ifdef _MSC_VER
+    return (int) _InterlockedOr((volatile long *) p, 0);
+#else
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Writes an int shared between threads <br>
+ * @param p A pointer to the shared int <br>
+ * @param value The new value <br>
+ */
+static inline void phase_shaper_atomic_store(volatile int *p, int value){
+#ifdef _MSC_VER
+    _InterlockedExchange((volatile long *) p, (long) value);
+#else
+    __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Replaces an int shared between threads <br>
+ * @param p A pointer to the shared int <br>
+ * @param value The new value <br>
+ * @returns The value before the exchange <br>
+ */
+static inline int phase_shaper_atomic_exchange(volatile int *p, int value){
+#ifdef _MSC_VER
+    return (int) _InterlockedExchange((volatile long *) p, (long) value);
+#else
+    return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Adds to an int shared between threads <br>
+ * @param p A pointer to the shared int <br>
+ * @param value The amount to add <br>
+ * @returns The value before the addition <br>
+ */
+static inline int phase_shaper_atomic_fetchAdd(volatile int *p, int value){
+#ifdef _MSC_VER
+    return (int) _InterlockedExchangeAdd((volatile long *) p, (long) value);
+#else
+    return __atomic_fetch_add(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Replaces an int shared between threads if it still holds the expected value <br>
+ * @param p A pointer to the shared int <br>
+ * @param expected The value the int has to hold <br>
+ * @param value The new value <br>
+ * @returns 1 if the int has been replaced, 0 otherwise <br>
+ */
+static inline int phase_shaper_atomic_compareExchange(volatile int *p, int expected, int value){
+#ifdef _MSC_VER
+    return _InterlockedCompareExchange((volatile long *) p, (long) value, (long) expected) == (long) expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,206 @@
+#include "phase_shaper_batch.h"
+#include "biquad_allpass_bank.h"
+#include "biquad_allpass_simd.h"
+#include "phase_shaper_denormal.h"
+#include "vas_mem.h"
+#include <math.h>
+#include <string.h>
+
+
+// 1 if no sample of a vector reaches the silence threshold of phase_shaper_meta
+static int phase_shaper_batch_silent(const float *in, int vectorSize){
+
+    for (int n = 0; n < vectorSize; n++) {
+        if (fabsf(in[n]) >= PHASE_SHAPER_META_SILENCE_THRESHOLD)
+            return 0;
+    }
+
+    return 1;
+}
+
+
+// the per lane counterpart of biquad_allpass_bank_decayed
+static int phase_shaper_batch_decayed(phase_shaper_batch *x, int lane){
+
+    const biquad_allpass_bank *b = x->bank;
+
+    for (int s = 0; s < b->nStages; s++) {
+        const int i = s * b->channelStride + lane;
+
+        if (fabsf(b->lastIn[i]) >= PHASE_SHAPER_META_SILENCE_THRESHOLD || fabsf(b->lastLastIn[i]) >= PHASE_SHAPER_META_SILENCE_THRESHOLD
+            || fabsf(b->lastOut[i]) >= PHASE_SHAPER_META_SILENCE_THRESHOLD || fabsf(b->lastLastOut[i]) >= PHASE_SHAPER_META_SILENCE_THRESHOLD)
+            return 0;
+    }
+
+    return 1;
+}
+
+
+int phase_shaper_batch_lanes(void){
+
+    switch (biquad_allpass_simd_detect()) {
+        case BIQUAD_ALLPASS_BACKEND_AVX2:
+            return 8;
+        case BIQUAD_ALLPASS_BACKEND_SSE2:
+        case BIQUAD_ALLPASS_BACKEND_NEON:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+
+phase_shaper_batch *phase_shaper_batch_new(int maxFilters, float sampleRate){
+
+    phase_shaper_batch *x = (phase_shaper_batch *) vas_mem_alloc(sizeof(phase_shaper_batch));
+
+    x->lanes = phase_shaper_batch_lanes();
+    x->nMembers = 0;
+
+    // lanes without a voice filter silence, so their states stay cleared
+    x->bank = biquad_allpass_bank_new(maxFilters, x->lanes > 0 ? x->lanes : 1, sampleRate);
+    x->frames = NULL;
+    x->framesSize = 0;
+
+    return x;
+}
+
+
+void phase_shaper_batch_free(phase_shaper_batch *x){
+    biquad_allpass_bank_free(x->bank);
+    vas_mem_free(x->frames);
+    vas_mem_free(x);
+}
+
+
+void phase_shaper_batch_reserve(phase_shaper_batch *x, int vectorSize){
+
+    if (vectorSize <= x->framesSize)
+        return;
+
+    vas_mem_free(x->frames);
+    x->frames = (float *) vas_mem_alignedAlloc((long) vectorSize * x->bank->channelStride * sizeof(float), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    x->framesSize = vectorSize;
+}
+
+
+int phase_shaper_batch_accepts(phase_shaper_batch *x, phase_shaper_meta *voice){
+
+    if (x->nMembers >= x->lanes || voice->bank->backend != x->bank->backend || voice->bank->nStages > x->bank->capacity)
+        return 0;
+
+    return x->nMembers == 0 || (voice->bank->specialised == x->bank->specialised && biquad_allpass_bank_sameCoefficients(x->bank, voice->bank));
+}
+
+
+void phase_shaper_batch_join(phase_shaper_batch *x, phase_shaper_meta *voice, int index){
+
+    const int lane = x->nMembers;
+    biquad_allpass_bank *b = x->bank;
+
+    if (lane == 0) {
+        biquad_allpass_bank_setStageCount(b, voice->bank->nStages);
+        biquad_allpass_bank_copyCoefficients(b, voice->bank, voice->bank->nStages);
+        biquad_allpass_bank_setSpecialised(b, voice->bank->specialised);
+    }
+
+    biquad_allpass_bank_copyStates(b, lane, voice->bank, 0, b->nStages);
+
+    x->members[lane] = voice;
+    x->index[lane] = index;
+    x->inLane[lane] = 1;
+    x->nMembers++;
+}
+
+
+void phase_shaper_batch_release(phase_shaper_batch *x, int lane){
+
+    const int last = x->nMembers - 1;
+    biquad_allpass_bank *b = x->bank;
+
+    if (x->inLane[lane])
+        biquad_allpass_bank_copyStates(x->members[lane]->bank, 0, b, lane, b->nStages);
+
+    if (lane != last) {
+        biquad_allpass_bank_copyStates(b, lane, b, last, b->nStages);
+        x->members[lane] = x->members[last];
+        x->index[lane] = x->index[last];
+        x->inLane[lane] = x->inLane[last];
+    }
+
+    // the emptied lane filters silence from now on
+    for (int s = 0; s < b->nStages; s++) {
+        const int i = s * b->channelStride + last;
+        b->lastIn[i] = b->lastLastIn[i] = b->lastOut[i] = b->lastLastOut[i] = 0;
+    }
+
+    x->nMembers--;
+}
+
+
+void phase_shaper_batch_process(phase_shaper_batch *x, float **in, float **out, int vectorSize){
+
+    const int stride = x->bank->channelStride;
+    const unsigned int denormals = phase_shaper_denormal_disable();
+    int active = 0;
+
+    // all inputs are read before any output is written
+    for (int l = 0; l < x->nMembers; l++) {
+        const float *input = in[x->index[l]];
+
+        // only once the lane has decayed, like the bypass of phase_shaper_meta, a ringing tail stays in the batch
+        if (phase_shaper_batch_silent(input, vectorSize) && (!x->inLane[l] || phase_shaper_batch_decayed(x, l))) {
+            if (x->inLane[l])
+                biquad_allpass_bank_copyStates(x->members[l]->bank, 0, x->bank, l, x->bank->nStages);
+            x->inLane[l] = 0;
+
+            for (int n = 0; n < vectorSize; n++)
+                x->frames[n * stride + l] = 0;
+            continue;
+        }
+
+        if (!x->inLane[l]) {
+            biquad_allpass_bank_copyStates(x->bank, l, x->members[l]->bank, 0, x->bank->nStages);
+            x->inLane[l] = 1;
+        }
+
+        for (int n = 0; n < vectorSize; n++)
+            x->frames[n * stride + l] = input[n];
+        active++;
+    }
+
+    for (int l = x->nMembers; l < stride; l++) {
+        for (int n = 0; n < vectorSize; n++)
+            x->frames[n * stride + l] = 0;
+    }
+
+    if (active > 0)
+        biquad_allpass_bank_processInterleavedStages(x->bank, 0, x->bank->nStages, x->frames, vectorSize);
+
+    for (int l = 0; l < x->nMembers; l++) {
+        const float *input = in[x->index[l]];
+        float *output = out[x->index[l]];
+        float mix;
+
+        if (!x->inLane[l]) {
+            phase_shaper_meta_process(x->members[l], in[x->index[l]], output, vectorSize);
+            continue;
+        }
+
+        // a voice leaving the batch later bypasses silence only after checking its states again
+        x->members[l]->silent = 0;
+
+        // the lanes share the fully wet stages of a global mix, each voice mixes in its own input
+        mix = phase_shaper_meta_outputMix(x->members[l]);
+        if (mix == 1) {
+            for (int n = 0; n < vectorSize; n++)
+                output[n] = x->frames[n * stride + l];
+        }
+        else {
+            for (int n = 0; n < vectorSize; n++)
+                output[n] = (1-mix) * input[n] + mix * x->frames[n * stride + l];
+        }
+    }
+
+    phase_shaper_denormal_restore(denormals);
+}
@@ -0,0 +1,125 @@
+/**
+ * @file phase_shaper_batch.h
+ * @author Arne Kuhle <br>
+ * @date 17 Oct 2026
+ * @brief Single channel phase_shaper_meta voices with identical coefficients filtered as the lanes of one cascade <br>
+ *
+ * A batch owns a biquad_allpass_bank with one channel per SIMD lane. Voices which share their coefficients join the batch,
+ * their states move into a lane and one pass of the multichannel kernel advances all of them. <br>
+ * Every voice keeps its own states, input and output, and each lane evaluates the same expression as the single channel kernels, <br>
+ * so the output of every voice is identical to processing it on its own. <br>
+ * Voices with a global mix share the fully wet stages whatever their mix, each one mixes in its own input at the output. <br>
+ * <br>
+ * Only steady voices may join (see phase_shaper_meta_steady), a voice has to be released before its parameters are applied. <br>
+ * A voice whose input and lane have fallen silent sits the vector out: its states return to the voice,
+ * which bypasses the vector itself, and move back into the lane with the next loud input. <br>
+ * Processing never allocates, the buffers are taken by phase_shaper_batch_new and phase_shaper_batch_reserve. <br>
+ */
+
+#ifndef ps_batch
+#define ps_batch
+
+#include "phase_shaper_meta.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The most voices a batch holds, one per lane of the widest SIMD register <br>
+ */
+#define PHASE_SHAPER_BATCH_MAX_LANES 8
+
+/**
+ * @struct phase_shaper_batch
+ * @brief The struct of a batch of voices sharing one multichannel cascade <br>
+ */
+typedef struct phase_shaper_batch{
+    int lanes; /**< The amount of voices the batch can hold */
+    int nMembers; /**< The amount of lanes in use, always the first ones */
+    phase_shaper_meta *members[PHASE_SHAPER_BATCH_MAX_LANES]; /**< The voice of each lane */
+    int index[PHASE_SHAPER_BATCH_MAX_LANES]; /**< The index of the input and output buffers of each lane */
+    int inLane[PHASE_SHAPER_BATCH_MAX_LANES]; /**< 1 if the states of the voice are in its lane, 0 while it sits out */
+    struct biquad_allpass_bank *bank; /**< The shared coefficients and the states of all lanes */
+    float *frames; /**< The interleaved samples of all lanes */
+    int framesSize; /**< The amount of frames the buffer holds */
+} phase_shaper_batch;
+
+/**
+ * @brief Returns the amount of lanes a batch uses on this cpu <br>
+ * @returns 8 with AVX2, 4 with SSE2 or NEON, 0 if only the scalar backend is available and batching would not pay <br>
+ */
+int phase_shaper_batch_lanes(void);
+
+/**
+ * @related phase_shaper_batch
+ * @brief Creates a new, empty phase_shaper_batch object <br>
+ * @param maxFilters The largest filter count of the voices joining the batch <br>
+ * @param sampleRate The systems sample rate <br>
+ * @returns an instance of the phase_shaper_batch object with phase_shaper_batch_lanes lanes <br>
+ */
+phase_shaper_batch *phase_shaper_batch_new(int maxFilters, float sampleRate);
+
+/**
+ * @related phase_shaper_batch
+ * @brief Frees the phase_shaper_batch object, the voices are not touched. <br>
+ * @param x A pointer the phase_shaper_batch object <br>
+ */
+void phase_shaper_batch_free(phase_shaper_batch *x);
+
+/**
+ * @related phase_shaper_batch
+ * @brief Allocates the interleaved buffer for a vector size <br>
+ * @param x A pointer to the phase_shaper_batch object <br>
+ * @param vectorSize The longest vector passed to phase_shaper_batch_process <br>
+ */
+void phase_shaper_batch_reserve(phase_shaper_batch *x, int vectorSize);
+
+/**
+ * @related phase_shaper_batch
+ * @brief Checks if a voice can join the batch <br>
+ * @param x A pointer to the phase_shaper_batch object <br>
+ * @param voice The voice, which has to be steady <br>
+ * @returns 1 if a lane is free and the batch is empty or filters with the same coefficients and backend as the voice, 0 otherwise <br>
+ */
+int phase_shaper_batch_accepts(phase_shaper_batch *x, phase_shaper_meta *voice);
+
+/**
+ * @related phase_shaper_batch
+ * @brief Moves the states of a voice into the next free lane <br>
+ * @param x A pointer to the phase_shaper_batch object <br>
+ * @param voice The voice, phase_shaper_batch_accepts has to be 1 <br>
+ * @param index The index of the input and output buffers of the voice in phase_shaper_batch_process <br>
+ *
+ * The first voice of an empty batch sets the coefficients of the batch. <br>
+ */
+void phase_shaper_batch_join(phase_shaper_batch *x, phase_shaper_meta *voice, int index);
+
+/**
+ * @related phase_shaper_batch
+ * @brief Moves the states of a lane back to its voice and removes the voice from the batch <br>
+ * @param x A pointer to the phase_shaper_batch object <br>
+ * @param lane The lane of the voice <br>
+ *
+ * The last lane moves into the freed one, the order of the lanes changes. <br>
+ */
+void phase_shaper_batch_release(phase_shaper_batch *x, int lane);
+
+/**
+ * @related phase_shaper_batch
+ * @brief Processes one vector of every voice of the batch <br>
+ * @param x A pointer to the phase_shaper_batch object <br>
+ * @param in The input buffers, lane k reads in[index[k]] <br>
+ * @param out The output buffers, lane k writes out[index[k]] <br>
+ * @param vectorSize Amount of samples per buffer <br>
+ *
+ * An output buffer may be the input buffer of the same voice, but not a buffer of another voice. <br>
+ * Every voice has to be steady. <br>
+ */
+void phase_shaper_batch_process(phase_shaper_batch *x, float **in, float **out, int vectorSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,532 @@
+/**
+ * @file phase_shaper_bench.c
+ * @author Arne Kuhle <br>
+ * @brief A benchmark of the allpass cascade outside of Pure Data.<br>
+ *
+ * phase_shaper_bench times phase_shaper_meta_process on every available backend and the biquad_allpass reference chain<br>
+ * across filter counts, block sizes, channel counts, sample rates and parameter workloads.<br>
+ * Every case is repeated and the fastest run is reported, one CSV line or JSON object per case.<br>
+ * The recursive cascade is timed with the convolution engine switched off. <br>
+ * For static parameters the convolution engine is timed separately, once it has taken over, as implementation "convolution". <br>
+ * With -u every backend is timed a second time without the kernels specialised for uniform stages, as implementation "generic". <br>
+ * With -p the transposed direct form II is timed in single and double precision, as implementations "tdf2" and "tdf2double". <br>
+ * Both run on the scalar loop, the scalar "meta" line is their direct form I counterpart. <br>
+ * <br>
+ * Workloads: <br>
+ * static - constant parameters <br>
+ * messages - a new frequency every block, each one ramped <br>
+ * audio - the frequency is modulated by a signal <br>
+ * <br>
+ * Cycles are read from the time stamp counter on x86, which counts at the nominal clock rate. <br>
+ * On other cpus they are derived from the -g option, or left empty. <br>
+ */
+
+#include "phase_shaper_meta.h"
+#include "biquad_allpass.h"
+#include "biquad_allpass_bank.h"
+#include "biquad_allpass_simd.h"
+#include "vas_mem.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PHASE_SHAPER_BENCH_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PHASE_SHAPER_BENCH_TSC 1
+#else
+#define PHASE_SHAPER_BENCH_TSC 0
+#endif
+
+#define PHASE_SHAPER_BENCH_MAX_LIST 32
+#define PHASE_SHAPER_BENCH_MAX_CHANNELS 2
+
+/**
+ * @brief The parameter workloads <br>
+ */
+enum phase_shaper_bench_workload{
+    PHASE_SHAPER_BENCH_STATIC = 0, /**< Constant parameters */
+    PHASE_SHAPER_BENCH_MESSAGES, /**< A frequency message every block */
+    PHASE_SHAPER_BENCH_AUDIO, /**< Frequency modulation at audio rate */
+    PHASE_SHAPER_BENCH_WORKLOADS /**< Amount of workloads */
+};
+
+static const char *phase_shaper_bench_workloadNames[PHASE_SHAPER_BENCH_WORKLOADS] = {"static", "messages", "audio"};
+
+/**
+ * @struct phase_shaper_bench_list
+ * @brief A list of values given on the command line <br>
+ */
+typedef struct phase_shaper_bench_list{
+    int values[PHASE_SHAPER_BENCH_MAX_LIST]; /**< The values */
+    int length; /**< The amount of values */
+} phase_shaper_bench_list;
+
+/**
+ * @struct phase_shaper_bench_case
+ * @brief One measured configuration and its result <br>
+ */
+typedef struct phase_shaper_bench_case{
+    const char *implementation; /**< "meta", "generic", "tdf2", "tdf2double", "convolution" or "reference" */
+    int backend; /**< The biquad_allpass_backend of meta */
+    int nChannels; /**< 1 or 2 */
+    int nFilters; /**< The length of the cascade */
+    int blockSize; /**< Frames per call */
+    int sampleRate; /**< The sample rate in Hz */
+    int workload; /**< A phase_shaper_bench_workload */
+    double seconds; /**< The fastest run */
+    double cycles; /**< Cycles of the fastest run, negative if unknown */
+    long frames; /**< Frames per run */
+} phase_shaper_bench_case;
+
+/**
+ * @struct phase_shaper_bench_options
+ * @brief The settings given on the command line <br>
+ */
+typedef struct phase_shaper_bench_options{
+    phase_shaper_bench_list filters; /**< Filter counts */
+    phase_shaper_bench_list blocks; /**< Block sizes */
+    phase_shaper_bench_list channels; /**< Channel counts */
+    phase_shaper_bench_list rates; /**< Sample rates */
+    int workloads; /**< Bit mask of the workloads */
+    double minTime; /**< Minimum duration of one run in seconds */
+    int repeats; /**< Runs per case */
+    double clockRate; /**< Clock rate in GHz for cycle estimates without a time stamp counter */
+    float frequency; /**< The center frequency of the static workload */
+    float mix; /**< The dry wet mix of every stage */
+    int globalMix; /**< Mix once at the output of meta instead of in every stage */
+    float spread; /**< The width of the frequency range of the stages in octaves */
+    int cacheBlock; /**< Frames per pass of the cascade, 0 for the calibrated size */
+    int json; /**< JSON lines instead of CSV */
+    int reference; /**< Include the biquad_allpass reference chain */
+    int convolution; /**< Include the convolution engine */
+    int generic; /**< Include the generic kernels */
+    int forms; /**< Include the transposed direct form II */
+} phase_shaper_bench_options;
+
+
+static double phase_shaper_bench_now(void){
+
+#ifdef _WIN32
+
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double) counter.QuadPart / frequency.QuadPart;
+
+#else
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+
+#endif
+}
+
+
+static double phase_shaper_bench_cycles(void){
+
+#if PHASE_SHAPER_BENCH_TSC
+    return (double) __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+static int phase_shaper_bench_parseList(phase_shaper_bench_list *list, const char *text){
+
+    list->length = 0;
+
+    while (*text && list->length < PHASE_SHAPER_BENCH_MAX_LIST) {
+        char *end;
+        const long value = strtol(text, &end, 10);
+
+        if (end == text || value < 1)
+            return -1;
+
+        list->values[list->length++] = (int) value;
+        text = *end == ',' ? end + 1 : end;
+    }
+
+    return list->length > 0 ? 0 : -1;
+}
+
+
+/*
+ * runs one case for at least minTime and returns the elapsed time,
+ * the parameter workloads are driven exactly like the Pd objects drive them
+ */
+static double phase_shaper_bench_runMeta(phase_shaper_bench_case *c, const phase_shaper_bench_options *options, double *cycles){
+
+    phase_shaper_meta *meta = phase_shaper_meta_newMultichannel(options->frequency, 2, (float) c->nFilters, options->mix, c->nChannels, c->nFilters, (float) c->sampleRate);
+    float *memory = (float *) vas_mem_alloc((long) (c->nChannels + 1) * c->blockSize * sizeof(float));
+    float *channels[PHASE_SHAPER_BENCH_MAX_CHANNELS];
+    float *modulation = memory + (size_t) c->nChannels * c->blockSize;
+    double start, startCycles, elapsed;
+    long blocks = 0;
+
+    for (int i = 0; i < c->nChannels; i++)
+        channels[i] = memory + (size_t) i * c->blockSize;
+
+    // noise at -6 dB, a slow sweep between 100 Hz and 2 kHz for the audio workload
+    for (int n = 0; n < c->blockSize; n++) {
+        for (int i = 0; i < c->nChannels; i++)
+            channels[i][n] = (float) rand() / RAND_MAX - 0.5f;
+        modulation[n] = 1050 + 950 * sinf(6.2831853f * n / c->blockSize);
+    }
+
+    phase_shaper_meta_setBackend(meta, c->backend);
+    phase_shaper_meta_setSpread(meta, options->spread);
+    phase_shaper_meta_setCacheBlock(meta, options->cacheBlock);
+    phase_shaper_meta_setMixMode(meta, options->globalMix ? PHASE_SHAPER_META_MIX_GLOBAL : PHASE_SHAPER_META_MIX_STAGES);
+    phase_shaper_meta_setConvolution(meta, strcmp(c->implementation, "convolution") == 0 ? PHASE_SHAPER_META_CONVOLUTION_ALWAYS : PHASE_SHAPER_META_CONVOLUTION_OFF);
+    phase_shaper_meta_reserve(meta, c->blockSize);
+    biquad_allpass_bank_setSpecialised(meta->bank, strcmp(c->implementation, "generic") != 0);
+    if (strcmp(c->implementation, "tdf2") == 0)
+        phase_shaper_meta_setForm(meta, BIQUAD_ALLPASS_FORM_TDF2);
+    if (strcmp(c->implementation, "tdf2double") == 0)
+        phase_shaper_meta_setForm(meta, BIQUAD_ALLPASS_FORM_TDF2_DOUBLE);
+    if (c->workload == PHASE_SHAPER_BENCH_AUDIO)
+        phase_shaper_meta_setModulation(meta, modulation, NULL, NULL);
+
+    // the first call applies the backend, the loop measures steady state
+    phase_shaper_meta_processMultichannel(meta, channels, channels, c->blockSize);
+
+    // up to one second of audio to render the impulse response and switch over
+    for (long n = 0; meta->engine != PHASE_SHAPER_META_CONVOLVING && strcmp(c->implementation, "convolution") == 0; n += c->blockSize) {
+        if (n > c->sampleRate) {
+            vas_mem_free(memory);
+            phase_shaper_meta_free(meta);
+            c->frames = 0;
+            return 0;
+        }
+        phase_shaper_meta_processMultichannel(meta, channels, channels, c->blockSize);
+    }
+
+    start = phase_shaper_bench_now();
+    startCycles = phase_shaper_bench_cycles();
+
+    do {
+        for (int i = 0; i < 16; i++, blocks++) {
+            if (c->workload == PHASE_SHAPER_BENCH_MESSAGES)
+                phase_shaper_meta_setFrequency(meta, blocks & 1 ? 300 : 1200);
+            phase_shaper_meta_processMultichannel(meta, channels, channels, c->blockSize);
+        }
+        elapsed = phase_shaper_bench_now() - start;
+    } while (elapsed < options->minTime);
+
+    *cycles = phase_shaper_bench_cycles() - startCycles;
+    c->frames = blocks * c->blockSize;
+
+    vas_mem_free(memory);
+    phase_shaper_meta_free(meta);
+
+    return elapsed;
+}
+
+
+static double phase_shaper_bench_runReference(phase_shaper_bench_case *c, const phase_shaper_bench_options *options, double *cycles){
+
+    biquad_allpass **stages = (biquad_allpass **) vas_mem_alloc(c->nFilters * sizeof(biquad_allpass *));
+    float *memory = (float *) vas_mem_alloc((long) (c->nChannels + 1) * c->blockSize * sizeof(float));
+    float *scratch = memory + (size_t) c->nChannels * c->blockSize;
+    double start, startCycles, elapsed;
+    long blocks = 0;
+
+    // one chain per channel would double the state, the reference filters the channels one after another
+    for (int s = 0; s < c->nFilters; s++)
+        stages[s] = biquad_allpass_new(options->frequency, 2, options->mix, (float) c->sampleRate);
+
+    for (int n = 0; n < c->nChannels * c->blockSize; n++)
+        memory[n] = (float) rand() / RAND_MAX - 0.5f;
+
+    start = phase_shaper_bench_now();
+    startCycles = phase_shaper_bench_cycles();
+
+    do {
+        for (int i = 0; i < 16; i++, blocks++) {
+            if (c->workload == PHASE_SHAPER_BENCH_MESSAGES) {
+                for (int s = 0; s < c->nFilters; s++) {
+                    biquad_allpass_setFrequency(stages[s], blocks & 1 ? 300 : 1200);
+                    biquad_allpass_updateParameters(stages[s]);
+                }
+            }
+            for (int ch = 0; ch < c->nChannels; ch++) {
+                float *in = memory + (size_t) ch * c->blockSize;
+
+                for (int s = 0; s < c->nFilters; s++) {
+                    biquad_allpass_filter_audio(stages[s], in, scratch, c->blockSize);
+                    memcpy(in, scratch, c->blockSize * sizeof(float));
+                }
+            }
+        }
+        elapsed = phase_shaper_bench_now() - start;
+    } while (elapsed < options->minTime);
+
+    *cycles = phase_shaper_bench_cycles() - startCycles;
+    c->frames = blocks * c->blockSize;
+
+    for (int s = 0; s < c->nFilters; s++)
+        biquad_allpass_free(stages[s]);
+    vas_mem_free(stages);
+    vas_mem_free(memory);
+
+    return elapsed;
+}
+
+
+static int phase_shaper_bench_measure(phase_shaper_bench_case *c, const phase_shaper_bench_options *options){
+
+    double best = -1, bestSeconds = 0, bestCycles = 0;
+    long bestFrames = 0;
+
+    for (int r = 0; r < options->repeats; r++) {
+        double cycles;
+        const double seconds = strcmp(c->implementation, "reference") != 0
+                               ? phase_shaper_bench_runMeta(c, options, &cycles)
+                               : phase_shaper_bench_runReference(c, options, &cycles);
+
+        // the impulse response is too long for the convolution
+        if (c->frames == 0)
+            return -1;
+
+        // runs differ in length, the fastest one per frame wins
+        if (best < 0 || seconds / c->frames < best) {
+            best = seconds / c->frames;
+            bestSeconds = seconds;
+            bestCycles = cycles;
+            bestFrames = c->frames;
+        }
+    }
+
+    c->seconds = bestSeconds;
+    c->cycles = bestCycles;
+    c->frames = bestFrames;
+
+    if (!PHASE_SHAPER_BENCH_TSC)
+        c->cycles = options->clockRate > 0 ? c->seconds * options->clockRate * 1e9 : -1;
+
+    return 0;
+}
+
+
+static void phase_shaper_bench_report(const phase_shaper_bench_case *c, const phase_shaper_bench_options *options){
+
+    const double samples = (double) c->frames * c->nChannels;
+    const double nsPerSample = c->seconds * 1e9 / samples;
+    const double samplesPerSecond = samples / c->seconds;
+    const char *backend = strcmp(c->implementation, "reference") != 0 ? biquad_allpass_simd_name((biquad_allpass_backend) c->backend) : "scalar";
+    char cyclesPerStage[32] = "";
+
+    if (c->cycles >= 0)
+        snprintf(cyclesPerStage, sizeof(cyclesPerStage), "%.3f", c->cycles / (samples * c->nFilters));
+
+    if (options->json)
+        printf("{\"implementation\":\"%s\",\"backend\":\"%s\",\"channels\":%d,\"filters\":%d,\"block\":%d,\"samplerate\":%d,"
+               "\"workload\":\"%s\",\"ns_per_sample\":%.4f,\"samples_per_sec\":%.0f,\"cycles_per_stage\":%s}\n",
+               c->implementation, backend, c->nChannels, c->nFilters, c->blockSize, c->sampleRate,
+               phase_shaper_bench_workloadNames[c->workload], nsPerSample, samplesPerSecond, c->cycles >= 0 ? cyclesPerStage : "null");
+    else
+        printf("%s,%s,%d,%d,%d,%d,%s,%.4f,%.0f,%s\n",
+               c->implementation, backend, c->nChannels, c->nFilters, c->blockSize, c->sampleRate,
+               phase_shaper_bench_workloadNames[c->workload], nsPerSample, samplesPerSecond, cyclesPerStage);
+
+    fflush(stdout);
+}
+
+
+static void phase_shaper_bench_usage(void){
+    fprintf(stderr,
+            "usage: phase_shaper_bench [options]\n"
+            "options (lists are comma separated):\n"
+            "  -n list     filter counts (default 1,2,4,8,16,32,64,128,256)\n"
+            "  -b list     block sizes (default 1,16,64,256,1024,4096)\n"
+            "  -c list     channel counts, 1 and/or 2 (default 1,2)\n"
+            "  -r list     sample rates (default 48000)\n"
+            "  -w list     workloads static, messages, audio (default all)\n"
+            "  -f hz       center frequency of the static and messages workloads (default 200)\n"
+            "  -m mix      dry wet mix of every stage (default 1)\n"
+            "  -o          apply the mix of meta once at the output instead of in every stage\n"
+            "  -s octaves  spread of the stage frequencies, the reference chain is skipped (default 0)\n"
+            "  -z frames   frames per pass of the cascade (default calibrated)\n"
+            "  -t seconds  minimum duration of a run (default 0.02)\n"
+            "  -k count    runs per case, the fastest is reported (default 3)\n"
+            "  -g ghz      clock rate for cycle estimates without a time stamp counter\n"
+            "  -x          skip the biquad_allpass reference chain\n"
+            "  -v          skip the convolution engine\n"
+            "  -u          also time the generic kernels instead of the ones for uniform stages\n"
+            "  -p          also time the transposed direct form II in single and double precision\n"
+            "  -j          JSON lines instead of CSV\n");
+}
+
+
+int main(int argc, char **argv){
+
+    phase_shaper_bench_options options;
+    phase_shaper_bench_case c;
+
+    memset(&options, 0, sizeof(options));
+    phase_shaper_bench_parseList(&options.filters, "1,2,4,8,16,32,64,128,256");
+    phase_shaper_bench_parseList(&options.blocks, "1,16,64,256,1024,4096");
+    phase_shaper_bench_parseList(&options.channels, "1,2");
+    phase_shaper_bench_parseList(&options.rates, "48000");
+    options.workloads = (1 << PHASE_SHAPER_BENCH_WORKLOADS) - 1;
+    options.minTime = 0.02;
+    options.repeats = 3;
+    options.reference = 1;
+    options.convolution = 1;
+    options.frequency = 200;
+    options.mix = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *flag = argv[i];
+        int result = 0;
+
+        if (strcmp(flag, "-j") == 0) {
+            options.json = 1;
+            continue;
+        }
+        if (strcmp(flag, "-x") == 0) {
+            options.reference = 0;
+            continue;
+        }
+        if (strcmp(flag, "-v") == 0) {
+            options.convolution = 0;
+            continue;
+        }
+        if (strcmp(flag, "-u") == 0) {
+            options.generic = 1;
+            continue;
+        }
+        if (strcmp(flag, "-p") == 0) {
+            options.forms = 1;
+            continue;
+        }
+        if (strcmp(flag, "-o") == 0) {
+            options.globalMix = 1;
+            continue;
+        }
+        if (flag[0] != '-' || flag[1] == 0 || flag[2] != 0 || i + 1 >= argc) {
+            phase_shaper_bench_usage();
+            return 2;
+        }
+
+        switch (flag[1]) {
+            case 'n': result = phase_shaper_bench_parseList(&options.filters, argv[++i]); break;
+            case 'b': result = phase_shaper_bench_parseList(&options.blocks, argv[++i]); break;
+            case 'c': result = phase_shaper_bench_parseList(&options.channels, argv[++i]); break;
+            case 'r': result = phase_shaper_bench_parseList(&options.rates, argv[++i]); break;
+            case 't': options.minTime = atof(argv[++i]); break;
+            case 'k': options.repeats = atoi(argv[++i]); break;
+            case 'g': options.clockRate = atof(argv[++i]); break;
+            case 'f': options.frequency = (float) atof(argv[++i]); result = options.frequency > 0 ? 0 : -1; break;
+            case 's': options.spread = (float) atof(argv[++i]); break;
+            case 'z': options.cacheBlock = atoi(argv[++i]); result = options.cacheBlock >= 0 ? 0 : -1; break;
+            case 'm': options.mix = (float) atof(argv[++i]); result = options.mix >= 0 && options.mix <= 1 ? 0 : -1; break;
+            case 'w':
+                options.workloads = 0;
+                for (int w = 0; w < PHASE_SHAPER_BENCH_WORKLOADS; w++)
+                    if (strstr(argv[i + 1], phase_shaper_bench_workloadNames[w]))
+                        options.workloads |= 1 << w;
+                result = options.workloads ? 0 : -1;
+                i++;
+                break;
+            default: result = -1; break;
+        }
+
+        if (result != 0) {
+            phase_shaper_bench_usage();
+            return 2;
+        }
+    }
+
+    if (options.repeats < 1)
+        options.repeats = 1;
+
+    for (int i = 0; i < options.channels.length; i++) {
+        if (options.channels.values[i] > PHASE_SHAPER_BENCH_MAX_CHANNELS) {
+            phase_shaper_bench_usage();
+            return 2;
+        }
+    }
+
+    if (!options.json)
+        printf("implementation,backend,channels,filters,block,samplerate,workload,ns_per_sample,samples_per_sec,cycles_per_stage\n");
+
+    srand(1);
+
+    for (int r = 0; r < options.rates.length; r++)
+    for (int w = 0; w < PHASE_SHAPER_BENCH_WORKLOADS; w++)
+    for (int ch = 0; ch < options.channels.length; ch++)
+    for (int f = 0; f < options.filters.length; f++)
+    for (int b = 0; b < options.blocks.length; b++) {
+
+        if (!(options.workloads & (1 << w)))
+            continue;
+
+        c.nChannels = options.channels.values[ch];
+        c.nFilters = options.filters.values[f];
+        c.blockSize = options.blocks.values[b];
+        c.sampleRate = options.rates.values[r];
+        c.workload = w;
+
+        c.implementation = "meta";
+        for (int backend = BIQUAD_ALLPASS_BACKEND_SCALAR; backend < BIQUAD_ALLPASS_BACKEND_COUNT; backend++) {
+            if (!biquad_allpass_simd_isSupported((biquad_allpass_backend) backend))
+                continue;
+            c.backend = backend;
+            phase_shaper_bench_measure(&c, &options);
+            phase_shaper_bench_report(&c, &options);
+        }
+
+        if (options.generic) {
+            c.implementation = "generic";
+            for (int backend = BIQUAD_ALLPASS_BACKEND_SCALAR; backend < BIQUAD_ALLPASS_BACKEND_COUNT; backend++) {
+                if (!biquad_allpass_simd_isSupported((biquad_allpass_backend) backend))
+                    continue;
+                c.backend = backend;
+                phase_shaper_bench_measure(&c, &options);
+                phase_shaper_bench_report(&c, &options);
+            }
+        }
+
+        // the forms have no vector kernels
+        if (options.forms) {
+            c.backend = BIQUAD_ALLPASS_BACKEND_SCALAR;
+            c.implementation = "tdf2";
+            phase_shaper_bench_measure(&c, &options);
+            phase_shaper_bench_report(&c, &options);
+            c.implementation = "tdf2double";
+            phase_shaper_bench_measure(&c, &options);
+            phase_shaper_bench_report(&c, &options);
+        }
+
+        // the convolution engine only takes over static parameters of a large stage pool
+        if (options.convolution && w == PHASE_SHAPER_BENCH_STATIC && c.nFilters >= PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS) {
+            c.implementation = "convolution";
+            c.backend = BIQUAD_ALLPASS_BACKEND_AUTO;
+            if (phase_shaper_bench_measure(&c, &options) == 0)
+                phase_shaper_bench_report(&c, &options);
+        }
+
+        // the reference chain has no signal inlets and no spread
+        if (options.reference && w != PHASE_SHAPER_BENCH_AUDIO && options.spread == 0) {
+            c.implementation = "reference";
+            c.backend = BIQUAD_ALLPASS_BACKEND_SCALAR;
+            phase_shaper_bench_measure(&c, &options);
+            phase_shaper_bench_report(&c, &options);
+        }
+    }
+
+    return 0;
+}
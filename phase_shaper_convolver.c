@@ -0,0 +1,339 @@
+#include "phase_shaper_convolver.h"
+#include "biquad_allpass_bank.h"
+#include "vas_mem.h"
+#include "math.h"
+#include <float.h>
+
+// points of the complex fft, a real fft of 2 * PARTITION points is split into one of PARTITION points
+#define PHASE_SHAPER_CONVOLVER_POINTS PHASE_SHAPER_CONVOLVER_PARTITION
+
+// arrays are reserved in multiples of one cache line worth of floats
+#define PHASE_SHAPER_CONVOLVER_GRANULE (BIQUAD_ALLPASS_BANK_ALIGNMENT / sizeof(float))
+
+
+static size_t phase_shaper_convolver_granules(size_t size){
+    return (size + PHASE_SHAPER_CONVOLVER_GRANULE - 1) / PHASE_SHAPER_CONVOLVER_GRANULE * PHASE_SHAPER_CONVOLVER_GRANULE;
+}
+
+
+// denormal taps would slow down every multiplication with them, they are replaced by zero
+static float phase_shaper_convolver_flush(float value){
+    return fabsf(value) < FLT_MIN ? 0 : value;
+}
+
+
+// iterative radix-2 fft of split complex numbers, the inverse is not scaled
+static void phase_shaper_convolver_fft(phase_shaper_convolver *x, float *re, float *im, int inverse){
+
+    const int M = PHASE_SHAPER_CONVOLVER_POINTS;
+    const float sign = inverse ? -1 : 1;
+
+    for(int i=0; i<M; i++){
+        const int j = x->bitReverse[i];
+
+        if(j > i){
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    // the twiddles of each stage are stored contiguously, so the inner loop vectorizes
+    for(int half=1; half<M; half*=2){
+        const float *wr = x->twiddles + (half - 1);
+        const float *wi = x->twiddles + (M - 1) + (half - 1);
+
+        for(int start=0; start<M; start+=2*half){
+            float *ar = re + start, *ai = im + start;
+            float *br = ar + half, *bi = ai + half;
+
+            for(int k=0; k<half; k++){
+                const float tr = wr[k] * br[k] - sign * wi[k] * bi[k];
+                const float ti = wr[k] * bi[k] + sign * wi[k] * br[k];
+
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+}
+
+
+// real fft of 2 * POINTS samples in place, the result is packed
+static void phase_shaper_convolver_forward(phase_shaper_convolver *x, float *data){
+
+    const int M = PHASE_SHAPER_CONVOLVER_POINTS;
+    const float *split = x->twiddles + 2 * (M - 1);
+    float *re = x->scratch, *im = x->scratch + M;
+
+    // even samples are the real, odd samples the imaginary parts
+    for(int k=0; k<M; k++){
+        re[k] = data[2*k];
+        im[k] = data[2*k+1];
+    }
+
+    phase_shaper_convolver_fft(x, re, im, 0);
+
+    data[0] = re[0] + im[0];
+    data[M] = re[0] - im[0];
+
+    for(int k=1; k<=M/2; k++){
+        const float er = (re[k] + re[M-k]) / 2, ei = (im[k] - im[M-k]) / 2;
+        const float qr = (im[k] + im[M-k]) / 2, qi = (re[M-k] - re[k]) / 2;
+        const float tr = split[2*k] * qr - split[2*k+1] * qi;
+        const float ti = split[2*k] * qi + split[2*k+1] * qr;
+
+        data[k] = er + tr;
+        data[M+k] = ei + ti;
+        data[M-k] = er - tr;
+        data[2*M-k] = ti - ei;
+    }
+}
+
+
+// inverse of phase_shaper_convolver_forward, the result is scaled by 2 * POINTS
+static void phase_shaper_convolver_inverse(phase_shaper_convolver *x, float *data){
+
+    const int M = PHASE_SHAPER_CONVOLVER_POINTS;
+    const float *split = x->twiddles + 2 * (M - 1);
+    float *re = x->scratch, *im = x->scratch + M;
+
+    re[0] = data[0] + data[M];
+    im[0] = data[0] - data[M];
+
+    for(int k=1; k<=M/2; k++){
+        const float er = data[k] + data[M-k], ei = data[M+k] - data[2*M-k];
+        const float dr = data[k] - data[M-k], di = data[M+k] + data[2*M-k];
+        const float qr = dr * split[2*k] + di * split[2*k+1];
+        const float qi = di * split[2*k] - dr * split[2*k+1];
+
+        re[k] = er - qi;
+        im[k] = ei + qr;
+        re[M-k] = er + qi;
+        im[M-k] = qr - ei;
+    }
+
+    phase_shaper_convolver_fft(x, re, im, 1);
+
+    for(int k=0; k<M; k++){
+        data[2*k] = re[k];
+        data[2*k+1] = im[k];
+    }
+}
+
+
+// accumulates the product of two packed spectra
+static void phase_shaper_convolver_multiply(float *sum, const float *a, const float *b){
+
+    const int M = PHASE_SHAPER_CONVOLVER_POINTS;
+
+    sum[0] += a[0] * b[0];
+    sum[M] += a[M] * b[M];
+
+    for(int k=1; k<M; k++){
+        sum[k] += a[k] * b[k] - a[M+k] * b[M+k];
+        sum[M+k] += a[k] * b[M+k] + a[M+k] * b[k];
+    }
+}
+
+
+// one partition of input is complete, transform it and prepare the output of the next partition
+static void phase_shaper_convolver_partition(phase_shaper_convolver *x){
+
+    const int P = PHASE_SHAPER_CONVOLVER_PARTITION;
+    const int M = x->maxPartitions;
+
+    if(M > 0)
+        x->delayPosition = (x->delayPosition + 1) % M;
+
+    for(int c=0; c<x->nChannels; c++){
+        float *input = x->input + c * 2 * P;
+
+        if(M > 0){
+            float *delayLine = x->delayLine + (size_t) c * M * 2 * P;
+            float *spectrum = delayLine + x->delayPosition * 2 * P;
+
+            // overlap-save, the spectrum covers the last two partitions
+            memcpy(spectrum, input, 2 * P * sizeof(float));
+            phase_shaper_convolver_forward(x, spectrum);
+
+            if(x->nPartitions > 0){
+                memset(x->work, 0, 2 * P * sizeof(float));
+                for(int p=0; p<x->nPartitions; p++)
+                    phase_shaper_convolver_multiply(x->work, x->spectra + p * 2 * P, delayLine + ((x->delayPosition - p + M) % M) * 2 * P);
+
+                phase_shaper_convolver_inverse(x, x->work);
+                memcpy(x->tail + c * P, x->work + P, P * sizeof(float));
+            }
+        }
+
+        memmove(input, input + P, P * sizeof(float));
+    }
+}
+
+
+phase_shaper_convolver *phase_shaper_convolver_new(int maxLength, int nChannels){
+
+    const int P = PHASE_SHAPER_CONVOLVER_PARTITION;
+    const int M = PHASE_SHAPER_CONVOLVER_POINTS;
+    phase_shaper_convolver *x = (phase_shaper_convolver *) vas_mem_alloc(sizeof(phase_shaper_convolver));
+    size_t head, spectra, input, delayLine, tail, work, scratch, twiddles, bitReverse;
+    float *memory;
+    int bits = 0;
+
+    if(nChannels < 1)
+        nChannels = 1;
+
+    x->maxPartitions = maxLength > P ? (maxLength + P - 1) / P - 1 : 0;
+    x->nPartitions = 0;
+    x->nChannels = nChannels;
+
+    head = phase_shaper_convolver_granules(P);
+    spectra = phase_shaper_convolver_granules((size_t) x->maxPartitions * 2 * P);
+    input = phase_shaper_convolver_granules((size_t) nChannels * 2 * P);
+    delayLine = phase_shaper_convolver_granules((size_t) nChannels * x->maxPartitions * 2 * P);
+    tail = phase_shaper_convolver_granules((size_t) nChannels * P);
+    work = phase_shaper_convolver_granules(2 * P);
+    scratch = phase_shaper_convolver_granules(2 * M);
+    twiddles = phase_shaper_convolver_granules(2 * (M - 1) + M + 2);
+    bitReverse = phase_shaper_convolver_granules(M);
+
+    x->memory = vas_mem_alignedAlloc((long) ((head + spectra + input + delayLine + tail + work + scratch + twiddles) * sizeof(float) + bitReverse * sizeof(int)), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    memory = (float *) x->memory;
+
+    x->head = memory;
+    x->spectra = x->head + head;
+    x->input = x->spectra + spectra;
+    x->delayLine = x->input + input;
+    x->tail = x->delayLine + delayLine;
+    x->work = x->tail + tail;
+    x->scratch = x->work + work;
+    x->twiddles = x->scratch + scratch;
+    x->bitReverse = (int *) (x->twiddles + twiddles);
+
+    // cos and -sin of every stage of the complex fft, followed by the pairs of the split into a real fft
+    for(int half=1; half<M; half*=2){
+        for(int k=0; k<half; k++){
+            x->twiddles[half - 1 + k] = (float) cos(M_PI * k / half);
+            x->twiddles[M - 1 + half - 1 + k] = (float) -sin(M_PI * k / half);
+        }
+    }
+    for(int k=0; k<=M/2; k++){
+        x->twiddles[2 * (M - 1) + 2*k] = (float) cos(M_PI * k / M);
+        x->twiddles[2 * (M - 1) + 2*k+1] = (float) -sin(M_PI * k / M);
+    }
+
+    while((1 << bits) < M)
+        bits++;
+    for(int i=0; i<M; i++){
+        int j = 0;
+        for(int b=0; b<bits; b++)
+            j |= ((i >> b) & 1) << (bits - 1 - b);
+        x->bitReverse[i] = j;
+    }
+
+    // a unit sample passes the input through
+    x->head[P - 1] = 1;
+    phase_shaper_convolver_reset(x);
+
+    return x;
+}
+
+
+void phase_shaper_convolver_free(phase_shaper_convolver *x){
+    vas_mem_free(x->memory);
+    vas_mem_free(x);
+}
+
+
+void phase_shaper_convolver_setImpulse(phase_shaper_convolver *x, const float *impulse, int length){
+
+    const int P = PHASE_SHAPER_CONVOLVER_PARTITION;
+    const float scale = 1.f / (2 * P);
+
+    if(length > (x->maxPartitions + 1) * P)
+        length = (x->maxPartitions + 1) * P;
+    if(length < 0)
+        length = 0;
+
+    // reversed, so the time domain part is a dot product with the input in memory order
+    for(int j=0; j<P; j++)
+        x->head[P - 1 - j] = j < length ? phase_shaper_convolver_flush(impulse[j]) : 0;
+
+    x->nPartitions = length > P ? (length - 1) / P : 0;
+
+    for(int p=0; p<x->nPartitions; p++){
+        float *spectrum = x->spectra + p * 2 * P;
+
+        for(int j=0; j<P; j++){
+            const int i = (p + 1) * P + j;
+            spectrum[j] = i < length ? impulse[i] * scale : 0;
+        }
+        memset(spectrum + P, 0, P * sizeof(float));
+
+        phase_shaper_convolver_forward(x, spectrum);
+
+        for(int j=0; j<2*P; j++)
+            spectrum[j] = phase_shaper_convolver_flush(spectrum[j]);
+    }
+}
+
+
+void phase_shaper_convolver_reset(phase_shaper_convolver *x){
+
+    const int P = PHASE_SHAPER_CONVOLVER_PARTITION;
+
+    memset(x->input, 0, (size_t) x->nChannels * 2 * P * sizeof(float));
+    memset(x->delayLine, 0, (size_t) x->nChannels * x->maxPartitions * 2 * P * sizeof(float));
+    memset(x->tail, 0, (size_t) x->nChannels * P * sizeof(float));
+    x->position = 0;
+    x->delayPosition = 0;
+}
+
+
+void phase_shaper_convolver_process(phase_shaper_convolver *x, const float *in, float *out, int stride, int vectorSize){
+
+    const int P = PHASE_SHAPER_CONVOLVER_PARTITION;
+    int i = 0;
+
+    while(i < vectorSize){
+        const int run = vectorSize - i < P - x->position ? vectorSize - i : P - x->position;
+
+        for(int c=0; c<x->nChannels; c++){
+            float *input = x->input + c * 2 * P;
+            const float *tail = x->tail + c * P;
+
+            // all input of the run is read before its output is written
+            for(int j=0; j<run; j++)
+                input[P + x->position + j] = in[(i + j) * stride + c];
+
+            for(int j=0; j<run; j++){
+                const float *history = input + x->position + j + 1;
+                float sum[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+                float y;
+
+                // eight partial sums, so the dot product vectorizes without reassociating
+                for(int k=0; k<P; k+=8){
+                    for(int l=0; l<8; l++)
+                        sum[l] += x->head[k + l] * history[k + l];
+                }
+
+                y = ((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+                out[(i + j) * stride + c] = y + tail[x->position + j];
+            }
+        }
+
+        x->position += run;
+        i += run;
+
+        if(x->position == P){
+            phase_shaper_convolver_partition(x);
+            x->position = 0;
+        }
+    }
+}
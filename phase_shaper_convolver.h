@@ -0,0 +1,106 @@
+/**
+ * @file phase_shaper_convolver.h
+ * @author Arne Kuhle <br>
+ * @date 17 Oct 2026
+ * @brief Uniformly partitioned convolution with a fixed impulse response <br>
+ *
+ * phase_shaper_convolver applies an impulse response of up to maxLength samples to one or more channels. <br>
+ * The first partition is applied directly in the time domain, the remaining partitions in the frequency domain. <br>
+ * Each of them is transformed once into a real fft of 2 * PHASE_SHAPER_CONVOLVER_PARTITION points, the input
+ * spectra of the past partitions are kept in a frequency domain delay line (overlap-save). <br>
+ * Splitting off the first partition keeps the output free of latency at any vector size. <br>
+ * <br>
+ * All memory is allocated by phase_shaper_convolver_new, setting an impulse response or processing never allocates. <br>
+ */
+
+#ifndef ps_convolver
+#define ps_convolver
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The length of one partition in samples, the fft has twice as many points <br>
+ */
+#define PHASE_SHAPER_CONVOLVER_PARTITION 64
+
+/**
+ * @struct phase_shaper_convolver
+ * @brief The struct of a partitioned convolution <br>
+ *
+ * Spectra are stored packed: the real parts of all bins below the last one, followed by the real part of the last bin and the imaginary parts of the others. <br>
+ */
+typedef struct phase_shaper_convolver{
+    int maxPartitions; /**< The amount of frequency domain partitions the memory holds */
+    int nPartitions; /**< The amount of frequency domain partitions of the impulse response */
+    int nChannels; /**< The amount of channels convolved with the same impulse response */
+    int position; /**< The position inside the current partition */
+    int delayPosition; /**< The index of the newest input spectrum in the delay line */
+    float *head; /**< The first partition of the impulse response in reversed order */
+    float *spectra; /**< The spectra of the remaining partitions, scaled for the inverse fft */
+    float *input; /**< The last two partitions of input of each channel */
+    float *delayLine; /**< The input spectra of the past maxPartitions partitions of each channel */
+    float *tail; /**< The output of the frequency domain partitions for the current partition of each channel */
+    float *work; /**< The sum of the partition products */
+    float *scratch; /**< The real and imaginary parts of the complex fft */
+    float *twiddles; /**< cos and -sin of the complex fft and of the real fft split */
+    int *bitReverse; /**< The permutation of the complex fft */
+    void *memory; /**< The aligned memory block holding all arrays */
+} phase_shaper_convolver;
+
+/**
+ * @related phase_shaper_convolver
+ * @brief Creates a new phase_shaper_convolver object <br>
+ * @param maxLength The longest impulse response in samples, rounded up to whole partitions <br>
+ * @param nChannels The amount of channels to convolve <br>
+ * @returns an instance of the phase_shaper_convolver object <br>
+ *
+ * The convolver starts with an impulse response of a single unit sample. <br>
+ */
+phase_shaper_convolver *phase_shaper_convolver_new(int maxLength, int nChannels);
+
+/**
+ * @related phase_shaper_convolver
+ * @brief Frees the phase_shaper_convolver object. <br>
+ * @param x A pointer the phase_shaper_convolver object <br>
+ */
+void phase_shaper_convolver_free(phase_shaper_convolver *x);
+
+/**
+ * @related phase_shaper_convolver
+ * @brief Sets the impulse response <br>
+ * @param x A pointer to the phase_shaper_convolver object <br>
+ * @param impulse A pointer to the impulse response <br>
+ * @param length The length of the impulse response, at most maxLength samples <br>
+ *
+ * Transforms every partition once. The input history is kept, call phase_shaper_convolver_reset to clear it. <br>
+ */
+void phase_shaper_convolver_setImpulse(phase_shaper_convolver *x, const float *impulse, int length);
+
+/**
+ * @related phase_shaper_convolver
+ * @brief Clears the input history of all channels <br>
+ * @param x A pointer to the phase_shaper_convolver object <br>
+ */
+void phase_shaper_convolver_reset(phase_shaper_convolver *x);
+
+/**
+ * @related phase_shaper_convolver
+ * @brief Convolves interleaved audio with the impulse response <br>
+ * @param x A pointer to the phase_shaper_convolver object <br>
+ * @param in A pointer to vectorSize frames of stride samples each <br>
+ * @param out A pointer to vectorSize frames of stride samples each <br>
+ * @param stride The distance between two frames, at least nChannels <br>
+ * @param vectorSize Amount of frames in the buffers <br>
+ *
+ * Sample n of channel c is stored at buffer[n * stride + c], padding channels are not touched. <br>
+ * in and out may point to the same buffer. <br>
+ */
+void phase_shaper_convolver_process(phase_shaper_convolver *x, const float *in, float *out, int stride, int vectorSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * @file phase_shaper_denormal.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief Scoped flush to zero of denormal floats for the processing functions of phase_shaper
+ *
+ * A decaying recursive filter drives its states into the denormal range, where many cpus slow down by a factor of 10 to 100. <br>
+ * phase_shaper_denormal_disable switches the floating point unit of the calling thread to flush denormal results (FTZ)
+ * and to read denormal operands as zero (DAZ), phase_shaper_denormal_restore switches it back. <br>
+ * The process functions wrap themselves in both, so the host's settings are untouched outside of them. <br>
+ * <br>
+ * Supported are SSE on x86, the FPCR on arm64 and the FPSCR on arm with VFP, which know no DAZ but flush both ways with FZ. <br>
+ * Elsewhere both functions do nothing and the silence bypass of phase_shaper_meta is the only protection. <br>
+ */
+
+#ifndef ps_denormal
+#define ps_denormal
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PHASE_SHAPER_DENORMAL_SSE
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define PHASE_SHAPER_DENORMAL_FPCR
+#elif defined(__arm__) && defined(__ARM_FP) && (defined(__GNUC__) || defined(__clang__))
+#define PHASE_SHAPER_DENORMAL_FPSCR
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Flushes denormals to zero on the calling thread <br>
+ * @returns The previous state, to be passed to phase_shaper_denormal_restore <br>
+ */
+static inline unsigned int phase_shaper_denormal_disable(void){
+#if defined(PHASE_SHAPER_DENORMAL_SSE)
+    const unsigned int state = _mm_getcsr();
+    _mm_setcsr(state | 0x8040); // FTZ and DAZ
+    return state;
+#elif defined(PHASE_SHAPER_DENORMAL_FPCR)
+    unsigned long long state;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(state));
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(state | (1ULL << 24))); // FZ
+    return (unsigned int) state;
+#elif defined(PHASE_SHAPER_DENORMAL_FPSCR)
+    unsigned int state;
+    __asm__ __volatile__("vmrs %0, fpscr" : "=r"(state));
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"(state | (1U << 24))); // FZ
+    return state;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Restores the denormal handling of the calling thread <br>
+ * @param state The value returned by phase_shaper_denormal_disable <br>
+ */
+static inline void phase_shaper_denormal_restore(unsigned int state){
+#if defined(PHASE_SHAPER_DENORMAL_SSE)
+    _mm_setcsr(state);
+#elif defined(PHASE_SHAPER_DENORMAL_FPCR)
+    __asm__ __volatile__("msr fpcr, %0" : : "r"((unsigned long long) state));
+#elif defined(PHASE_SHAPER_DENORMAL_FPSCR)
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"(state));
+#else
+    (void) state;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
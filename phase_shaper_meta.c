@@ -1,23 +1,798 @@
 #include "phase_shaper_meta.h"
-#include "biquad_allpass.h"
+#include "biquad_allpass_bank.h"
+#include "biquad_allpass_simd.h"
+#include "phase_shaper_convolver.h"
 #include "vas_mem.h"
-#include "m_pd.h"
+#include "phase_shaper_atomic.h"
+#include "phase_shaper_denormal.h"
+#include "math.h"
+#include <stdint.h>
 
-phase_shaper_meta *phase_shaper_meta_new(float f0, float Q, float nFilters, float mix){
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
-    phase_shaper_meta *x = (phase_shaper_meta *) vas_mem_alloc(sizeof(phase_shaper_meta));
+// the impulse response ends once every state of the rendering cascade stays below this magnitude
+#define PHASE_SHAPER_META_CONVOLUTION_THRESHOLD 1e-6f
+
+// cost model in nanoseconds per frame, measured with phase_shaper_bench at 64 samples per block on an x86-64 machine
+// a stage of the cascade by backend, for one and for two channels, neon is assumed to match sse2
+static const float phase_shaper_meta_stageCost[BIQUAD_ALLPASS_BACKEND_COUNT][2] = {
+    {6.7f, 13.5f}, // auto, always resolved
+    {6.7f, 13.5f},
+    {1.7f, 3.5f},
+    {1.2f, 2.2f},
+    {1.7f, 3.5f}
+};
+
+// the convolution of one channel: the time domain partition with both ffts, and each frequency domain partition
+#define PHASE_SHAPER_META_HEAD_COST 34.f
+#define PHASE_SHAPER_META_PARTITION_COST 1.2f
+
+// the calibration times a short cascade, layouts above the largest stride scale its pass size down to the same working set
+#define PHASE_SHAPER_META_CALIBRATION_STAGES 8
+#define PHASE_SHAPER_META_CALIBRATION_RUNS 3
+#define PHASE_SHAPER_META_CALIBRATION_STRIDE 16
+
+// a larger pass wins unless a smaller one is this much faster
+#define PHASE_SHAPER_META_CALIBRATION_MARGIN 1.03
+
+// calibrated pass sizes by channel count, 0 until measured, written once per process
+static volatile int phase_shaper_meta_cacheBlocks[PHASE_SHAPER_META_CALIBRATION_STRIDE + 1];
+
+// the pass size of phase_shaper_meta_pinCacheBlock, 0 while the calibration decides
+static volatile int phase_shaper_meta_pinnedCacheBlock;
+
+
+static int phase_shaper_meta_clampFilterCount(phase_shaper_meta *x, float nFilters){
+
+    // cast filter count to int, at least one filter stays active, larger counts need phase_shaper_meta_setMaxFilters first
+    if (nFilters < 1)
+        return 1;
+
+    if (nFilters > x->maxFilters)
+        return x->maxFilters;
+
+    return (int) nFilters;
+}
+
+
+static int phase_shaper_meta_rampSamples(phase_shaper_meta *x, float milliseconds){
+
+    if (milliseconds < 0)
+        milliseconds = 0;
+
+    return (int) (milliseconds * x->sampleRate / 1000);
+}
+
+
+// the mix of every stage, the global mix runs them fully wet
+static float phase_shaper_meta_stageMix(int mixMode, float mix){
+    return mixMode == PHASE_SHAPER_META_MIX_GLOBAL ? 1 : mix;
+}
+
+
+// the mix of the cascade output with its input, 1 if the stages mix
+static float phase_shaper_meta_globalMix(int mixMode, float mix){
+
+    if (mixMode != PHASE_SHAPER_META_MIX_GLOBAL)
+        return 1;
+
+    return mix < 0 ? 0 : mix > 1 ? 1 : mix;
+}
+
+
+static void phase_shaper_meta_resize(phase_shaper_meta *x, int nFilters){
+
+    int oldCount;
+
+    // a running fade is cut short
+    if (x->fadePosition < x->fadeLength) {
+        x->fadePosition = x->fadeLength;
+        biquad_allpass_bank_setStageCount(x->bank, x->nFilters);
+    }
+
+    oldCount = x->nFilters;
 
-    x->sampleRate = sys_getsr();
+    // the pool holds maxFilters stages, activating them only clears their states
+    if (nFilters > oldCount) {
+        biquad_allpass_bank_setStageCount(x->bank, nFilters);
+        biquad_allpass_bank_setStages(x->bank, oldCount, nFilters, x->f0, x->Q, phase_shaper_meta_stageMix(x->mixMode, x->mix));
+    }
 
-    x->f0 = f0;
-    x->Q = Q;
-    x->mix = mix;
+    // removed stages keep running until they are faded out
     x->nFilters = nFilters;
+    x->fadeFrom = oldCount;
+    x->fadePosition = 0;
+}
 
-    x->allpass_head = biquad_allpass_new(x->f0, x->Q, x->mix, x->sampleRate);
 
-    phase_shaper_meta_setFilterCount(x, x->nFilters);
-    phase_shaper_meta_updateAllpassInstances(x);
+static double phase_shaper_meta_now(void){
+
+#ifdef _WIN32
+
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double) counter.QuadPart / frequency.QuadPart;
+
+#else
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+
+#endif
+}
+
+
+// times the cascade over PHASE_SHAPER_META_MAX_CACHE_BLOCK frames of noise for every power of two pass size
+static int phase_shaper_meta_calibrate(int nChannels){
+
+    biquad_allpass_bank *bank = biquad_allpass_bank_new(PHASE_SHAPER_META_CALIBRATION_STAGES, nChannels, 48000);
+    const int interleaved = nChannels > 1;
+    const int stride = bank->channelStride;
+    const size_t size = (size_t) PHASE_SHAPER_META_MAX_CACHE_BLOCK * (interleaved ? stride : 1);
+    float *in = (float *) vas_mem_alignedAlloc(size * sizeof(float), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    float *out = (float *) vas_mem_alignedAlloc(size * sizeof(float), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    unsigned int seed = 1;
+    double bestTime = 0;
+    int best = PHASE_SHAPER_META_MAX_CACHE_BLOCK;
+
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        in[i] = (float) (seed >> 8) / 8388608.f - 1;
+    }
+
+    biquad_allpass_bank_setStageCount(bank, PHASE_SHAPER_META_CALIBRATION_STAGES);
+    biquad_allpass_bank_setStages(bank, 0, PHASE_SHAPER_META_CALIBRATION_STAGES, 1000, 0.7f, 1);
+
+    // from the largest pass down, so a tie keeps the larger one
+    for (int block = PHASE_SHAPER_META_MAX_CACHE_BLOCK; block >= PHASE_SHAPER_META_MIN_CACHE_BLOCK; block /= 2) {
+        double duration = -1;
+
+        for (int run = 0; run < PHASE_SHAPER_META_CALIBRATION_RUNS; run++) {
+            double start, elapsed;
+
+            if (interleaved)
+                memcpy(out, in, size * sizeof(float));
+
+            start = phase_shaper_meta_now();
+
+            for (int offset = 0; offset < PHASE_SHAPER_META_MAX_CACHE_BLOCK; offset += block) {
+                if (interleaved)
+                    biquad_allpass_bank_processInterleavedStages(bank, 0, PHASE_SHAPER_META_CALIBRATION_STAGES, out + (size_t) offset * stride, block);
+                else
+                    biquad_allpass_bank_processStages(bank, 0, PHASE_SHAPER_META_CALIBRATION_STAGES, in + offset, out + offset, block);
+            }
+
+            elapsed = phase_shaper_meta_now() - start;
+
+            if (duration < 0 || elapsed < duration)
+                duration = elapsed;
+        }
+
+        if (block == PHASE_SHAPER_META_MAX_CACHE_BLOCK || duration * PHASE_SHAPER_META_CALIBRATION_MARGIN < bestTime) {
+            best = block;
+            bestTime = duration;
+        }
+    }
+
+    vas_mem_free(in);
+    vas_mem_free(out);
+    biquad_allpass_bank_free(bank);
+
+    return best;
+}
+
+
+int phase_shaper_meta_calibratedCacheBlock(int nChannels){
+
+    int block = phase_shaper_atomic_load(&phase_shaper_meta_pinnedCacheBlock);
+
+    if (block > 0)
+        return block;
+
+    if (nChannels > PHASE_SHAPER_META_CALIBRATION_STRIDE) {
+        block = phase_shaper_meta_calibratedCacheBlock(PHASE_SHAPER_META_CALIBRATION_STRIDE) * PHASE_SHAPER_META_CALIBRATION_STRIDE / nChannels;
+        return block > PHASE_SHAPER_META_MIN_CACHE_BLOCK ? block : PHASE_SHAPER_META_MIN_CACHE_BLOCK;
+    }
+
+    block = phase_shaper_atomic_load(&phase_shaper_meta_cacheBlocks[nChannels]);
+
+    // instances created at the same time may both measure, the first result stays for the whole process
+    if (!block) {
+        const int measured = phase_shaper_meta_calibrate(nChannels);
+
+        if (phase_shaper_atomic_compareExchange(&phase_shaper_meta_cacheBlocks[nChannels], 0, measured))
+            block = measured;
+        else
+            block = phase_shaper_atomic_load(&phase_shaper_meta_cacheBlocks[nChannels]);
+    }
+
+    return block;
+}
+
+
+void phase_shaper_meta_pinCacheBlock(int frames){
+
+    if (frames > PHASE_SHAPER_META_MAX_CACHE_BLOCK)
+        frames = PHASE_SHAPER_META_MAX_CACHE_BLOCK;
+    else if (frames > 0 && frames < PHASE_SHAPER_META_MIN_CACHE_BLOCK)
+        frames = PHASE_SHAPER_META_MIN_CACHE_BLOCK;
+
+    phase_shaper_atomic_store(&phase_shaper_meta_pinnedCacheBlock, frames > 0 ? frames : 0);
+}
+
+
+// one pass of the cascade, the stages run one after another over the whole pass
+static void phase_shaper_meta_cascadePass(phase_shaper_meta *x, float *in, float *out, int vectorSize){
+
+    const int interleaved = x->nChannels > 1;
+    const int stride = x->bank->channelStride;
+    const int lower = x->fadeFrom < x->nFilters ? x->fadeFrom : x->nFilters;
+    const int upper = x->fadeFrom < x->nFilters ? x->nFilters : x->fadeFrom;
+    const float *oldOut, *newOut;
+
+    if (x->fadePosition >= x->fadeLength) {
+        if (interleaved)
+            biquad_allpass_bank_processInterleavedStages(x->bank, 0, x->nFilters, out, vectorSize);
+        else
+            biquad_allpass_bank_processStages(x->bank, 0, x->nFilters, in, out, vectorSize);
+
+        PHASE_SHAPER_STATS_ADD(x->stats.stageFrames, (long long) vectorSize * x->nFilters);
+        return;
+    }
+
+    // tap the output of the shorter cascade, then continue with the stages only the longer one has
+    if (interleaved) {
+        biquad_allpass_bank_processInterleavedStages(x->bank, 0, lower, out, vectorSize);
+        memcpy(x->tap, out, (size_t) vectorSize * stride * sizeof(float));
+        biquad_allpass_bank_processInterleavedStages(x->bank, lower, upper, out, vectorSize);
+    }
+    else {
+        biquad_allpass_bank_processStages(x->bank, 0, lower, in, out, vectorSize);
+        memcpy(x->tap, out, (size_t) vectorSize * sizeof(float));
+        biquad_allpass_bank_processStages(x->bank, lower, upper, out, out, vectorSize);
+    }
+
+    oldOut = x->fadeFrom < x->nFilters ? x->tap : out;
+    newOut = x->fadeFrom < x->nFilters ? out : x->tap;
+
+    // frames after the end of the fade are the new output exactly, wherever the vector or pass ends
+    for (int n = 0; n < vectorSize; n++) {
+        const float gain = x->fadePosition < x->fadeLength ? (float) x->fadePosition / x->fadeLength : 1;
+
+        for (int c = 0; c < (interleaved ? stride : 1); c++) {
+            const int i = n * (interleaved ? stride : 1) + c;
+            out[i] = x->fadePosition < x->fadeLength ? oldOut[i] + gain * (newOut[i] - oldOut[i]) : newOut[i];
+        }
+
+        if (x->fadePosition < x->fadeLength)
+            x->fadePosition++;
+    }
+
+    // faded out stages return to the pool
+    if (x->fadePosition >= x->fadeLength)
+        biquad_allpass_bank_setStageCount(x->bank, x->nFilters);
+
+    PHASE_SHAPER_STATS_ADD(x->stats.stageFrames, (long long) vectorSize * upper);
+}
+
+
+// every stage is causal, so cutting the vector into passes leaves the output untouched
+static void phase_shaper_meta_cascade(phase_shaper_meta *x, float *in, float *out, int vectorSize){
+
+    const size_t frameSize = x->nChannels > 1 ? x->bank->channelStride : 1;
+    PHASE_SHAPER_STATS_START(start);
+
+    for (int offset = 0; offset < vectorSize; offset += x->cacheBlock) {
+        const int n = vectorSize - offset < x->cacheBlock ? vectorSize - offset : x->cacheBlock;
+        phase_shaper_meta_cascadePass(x, in + offset * frameSize, out + offset * frameSize, n);
+    }
+
+    PHASE_SHAPER_STATS_ADD_TIME(x->stats.cascadeTime, start);
+}
+
+
+static int phase_shaper_meta_sameImpulse(phase_shaper_meta *x){
+
+    const phase_shaper_meta_parameters *p = &x->impulseParameters;
+
+    // the impulse response of a global mix is the wet one, the mix is applied to the output of either engine
+    return p->f0 == x->f0 && p->Q == x->Q && phase_shaper_meta_stageMix(p->mixMode, p->mix) == phase_shaper_meta_stageMix(x->mixMode, x->mix)
+        && p->spread == x->spread && p->curve == x->bank->curve
+        && p->nFilters == x->nFilters && p->sampleRate == x->sampleRate
+        && p->trigMode == x->bank->trigMode && p->backend == x->bank->backend && p->convolution == x->applied.convolution;
+}
+
+
+static int phase_shaper_meta_pays(phase_shaper_meta *x, int length){
+
+    const int stride = x->bank->channelStride;
+    float recursive, convolution;
+
+    if (length > PHASE_SHAPER_META_CONVOLUTION_LENGTH)
+        return 0;
+
+    if (x->applied.convolution == PHASE_SHAPER_META_CONVOLUTION_ALWAYS)
+        return 1;
+
+    // above two channels the lanes of the cascade hold pairs of channels, the transposed forms run the scalar loop
+    recursive = x->nFilters * (stride > 2 ? stride / 2 : 1)
+                * phase_shaper_meta_stageCost[x->bank->form == BIQUAD_ALLPASS_FORM_DF1 ? x->bank->backend : BIQUAD_ALLPASS_BACKEND_SCALAR][stride > 1];
+    convolution = x->nChannels * (PHASE_SHAPER_META_HEAD_COST + (length - 1) / PHASE_SHAPER_CONVOLVER_PARTITION * PHASE_SHAPER_META_PARTITION_COST);
+
+    return convolution < recursive;
+}
+
+
+static int phase_shaper_meta_estimateLength(phase_shaper_meta *x){
+
+    const double limit = log(1 / PHASE_SHAPER_META_CONVOLUTION_THRESHOLD);
+    const int order = x->nFilters - 1;
+    const int nStages = x->bank->spread != 0 ? x->nFilters : 1;
+    double radius = 0, decay, peak, envelope;
+
+    // the largest radius dominates the decay, spread stages count as if they all shared it
+    for (int s = 0; s < nStages; s++) {
+        const double a1 = x->bank->a1_over_a0[s], a2 = x->bank->a2_over_a0[s];
+        const double discriminant = a1 * a1 - 4 * a2;
+
+        if (discriminant < 0)
+            radius = fmax(radius, sqrt(a2));
+        else
+            radius = fmax(radius, fmax(fabs(-a1 + sqrt(discriminant)), fabs(-a1 - sqrt(discriminant))) / 2);
+    }
+
+    if (radius >= 1)
+        return PHASE_SHAPER_META_CONVOLUTION_LENGTH + 1;
+    if (radius <= 0)
+        return PHASE_SHAPER_CONVOLVER_PARTITION;
+
+    // envelope of n^order * radius^n, it peaks at order / decay
+    decay = -log(radius);
+    peak = order / decay;
+    envelope = order > 0 ? order * log(peak) - peak * decay : 0;
+
+    for (int n = PHASE_SHAPER_CONVOLVER_PARTITION; n <= PHASE_SHAPER_META_CONVOLUTION_LENGTH; n += PHASE_SHAPER_CONVOLVER_PARTITION) {
+        if (n > peak && envelope - (order * log(n) - n * decay) > limit)
+            return n;
+    }
+
+    return PHASE_SHAPER_META_CONVOLUTION_LENGTH + 1;
+}
+
+
+static void phase_shaper_meta_startPriming(phase_shaper_meta *x){
+    phase_shaper_convolver_reset(x->convolver);
+    x->engine = PHASE_SHAPER_META_PRIMING;
+    x->enginePosition = 0;
+}
+
+
+static void phase_shaper_meta_startRendering(phase_shaper_meta *x){
+
+    biquad_allpass_bank *r = x->renderBank;
+
+    x->impulseParameters = x->applied;
+    x->impulseParameters.f0 = x->f0;
+    x->impulseParameters.Q = x->Q;
+    x->impulseParameters.mix = x->mix;
+    x->impulseParameters.mixMode = x->mixMode;
+    x->impulseParameters.spread = x->spread;
+    x->impulseParameters.curve = x->bank->curve;
+    x->impulseParameters.nFilters = x->nFilters;
+    x->impulseParameters.sampleRate = x->sampleRate;
+    x->impulseParameters.trigMode = x->bank->trigMode;
+    x->impulseParameters.backend = x->bank->backend;
+    x->impulseLength = -1;
+
+    // skip rendering if not even the estimated length pays off
+    if (!phase_shaper_meta_pays(x, phase_shaper_meta_estimateLength(x))) {
+        x->impulseLength = 0;
+        return;
+    }
+
+    // the copy shares coefficients and backend with the cascade, so it renders the same response
+    biquad_allpass_bank_setStageCount(r, x->nFilters);
+    biquad_allpass_bank_clearStates(r, 0, x->nFilters);
+    biquad_allpass_bank_copyCoefficients(r, x->bank, x->nFilters);
+    r->backend = x->bank->backend;
+
+    x->renderPosition = 0;
+    x->engine = PHASE_SHAPER_META_RENDERING;
+}
+
+
+static void phase_shaper_meta_render(phase_shaper_meta *x, int vectorSize){
+
+    const int P = PHASE_SHAPER_CONVOLVER_PARTITION;
+    int length = (vectorSize + P - 1) / P * P;
+    float *impulse = x->impulse + x->renderPosition;
+
+    // about one vector of the cascade per vector, in whole partitions
+    if (length > PHASE_SHAPER_META_CONVOLUTION_LENGTH - x->renderPosition)
+        length = PHASE_SHAPER_META_CONVOLUTION_LENGTH - x->renderPosition;
+
+    memset(impulse, 0, length * sizeof(float));
+    if (x->renderPosition == 0)
+        impulse[0] = 1;
+
+    biquad_allpass_bank_processStages(x->renderBank, 0, x->nFilters, impulse, impulse, length);
+    x->renderPosition += length;
+
+    if (biquad_allpass_bank_decayed(x->renderBank, 0, x->nFilters, PHASE_SHAPER_META_CONVOLUTION_THRESHOLD)) {
+        length = x->renderPosition;
+
+        // trailing partitions below the threshold cost without contributing
+        while (length > P) {
+            float peak = 0;
+
+            for (int i = length - P; i < length; i++)
+                peak = fmaxf(peak, fabsf(x->impulse[i]));
+
+            if (peak >= PHASE_SHAPER_META_CONVOLUTION_THRESHOLD)
+                break;
+            length -= P;
+        }
+
+        if (phase_shaper_meta_pays(x, length)) {
+            phase_shaper_convolver_setImpulse(x->convolver, x->impulse, length);
+            x->impulseLength = length;
+            phase_shaper_meta_startPriming(x);
+            return;
+        }
+    }
+    else if (x->renderPosition < PHASE_SHAPER_META_CONVOLUTION_LENGTH)
+        return;
+
+    // too long, or too expensive after all
+    x->impulseLength = 0;
+    x->engine = PHASE_SHAPER_META_RECURSIVE;
+}
+
+
+// 1 if the audio thread may use the engine, a retiring one is handed back once the cascade runs alone
+static int phase_shaper_meta_engineAvailable(phase_shaper_meta *x){
+
+    const int state = phase_shaper_atomic_load(&x->engineState);
+
+    if (state == PHASE_SHAPER_META_ENGINE_RETIRING && x->engine == PHASE_SHAPER_META_RECURSIVE)
+        phase_shaper_atomic_compareExchange(&x->engineState, PHASE_SHAPER_META_ENGINE_RETIRING, PHASE_SHAPER_META_ENGINE_RETIRED);
+
+    return state == PHASE_SHAPER_META_ENGINE_AVAILABLE;
+}
+
+
+// called at the end of phase_shaper_meta_schedule while the cascade runs
+static void phase_shaper_meta_select(phase_shaper_meta *x, int vectorSize, int moving){
+
+    const int still = !moving && !x->rampF0 && !x->rampQ && !x->rampMix && !x->rampSpread && x->fadePosition >= x->fadeLength;
+    const int available = phase_shaper_meta_engineAvailable(x);
+
+    if (!still || !available || x->applied.convolution == PHASE_SHAPER_META_CONVOLUTION_OFF) {
+        x->staticSamples = 0;
+        x->engine = PHASE_SHAPER_META_RECURSIVE;
+        return;
+    }
+
+    // rendering, priming and fading in are abandoned if anything changes
+    if (x->engine != PHASE_SHAPER_META_RECURSIVE) {
+        if (!phase_shaper_meta_sameImpulse(x))
+            x->engine = PHASE_SHAPER_META_RECURSIVE;
+        return;
+    }
+
+    x->staticSamples += vectorSize;
+    if (x->staticSamples < PHASE_SHAPER_META_SETTLE_TIME * x->sampleRate / 1000)
+        return;
+
+    // an impulse response is rendered once per parameter set
+    if (x->impulseLength >= 0 && phase_shaper_meta_sameImpulse(x)) {
+        if (x->impulseLength > 0)
+            phase_shaper_meta_startPriming(x);
+        return;
+    }
+
+    phase_shaper_meta_startRendering(x);
+}
+
+
+// 1 if the parameters are about to change or the engine retires while the convolution runs
+static int phase_shaper_meta_moved(phase_shaper_meta *x, int vectorSize){
+
+    if ((phase_shaper_atomic_load(&x->sharedSlot) & PHASE_SHAPER_META_FRESH)
+        || phase_shaper_atomic_load(&x->engineState) != PHASE_SHAPER_META_ENGINE_AVAILABLE)
+        return 1;
+
+    for (int n = 0; n < vectorSize; n++) {
+        if ((x->f0Signal && x->f0Signal[n] != x->lastF0Signal) || (x->QSignal && x->QSignal[n] != x->lastQSignal)
+            || (x->mixSignal && x->mixSignal[n] != x->lastMixSignal))
+            return 1;
+    }
+
+    return 0;
+}
+
+
+static void phase_shaper_meta_startCatchUp(phase_shaper_meta *x){
+
+    // older input has decayed below the threshold, the cascade restarts from silence
+    if (x->replayPending > x->impulseLength) {
+        biquad_allpass_bank_clearStates(x->bank, 0, x->nFilters);
+        x->replayPending = x->impulseLength;
+    }
+
+    x->engine = PHASE_SHAPER_META_CATCHUP;
+}
+
+
+static void phase_shaper_meta_keep(phase_shaper_meta *x, const float *in, int vectorSize){
+
+    const int stride = x->bank->channelStride;
+    int n = 0;
+
+    while (n < vectorSize) {
+        const int length = vectorSize - n < x->historySize - x->historyPosition ? vectorSize - n : x->historySize - x->historyPosition;
+
+        memcpy(x->history + (size_t) x->historyPosition * stride, in + (size_t) n * stride, (size_t) length * stride * sizeof(float));
+        x->historyPosition = (x->historyPosition + length) % x->historySize;
+        n += length;
+    }
+
+    x->replayPending += vectorSize;
+    if (x->replayPending > x->historySize)
+        x->replayPending = x->historySize;
+}
+
+
+static void phase_shaper_meta_replay(phase_shaper_meta *x, int budget){
+
+    const int stride = x->bank->channelStride;
+
+    // the output of the replay is discarded, only the states matter
+    while (x->replayPending > 0 && budget > 0) {
+        const int start = (x->historyPosition - x->replayPending + x->historySize) % x->historySize;
+        int length = x->replayPending < budget ? x->replayPending : budget;
+
+        if (length > x->framesSize)
+            length = x->framesSize;
+        if (length > x->historySize - start)
+            length = x->historySize - start;
+
+        memcpy(x->tap, x->history + (size_t) start * stride, (size_t) length * stride * sizeof(float));
+
+        if (x->nChannels > 1)
+            biquad_allpass_bank_processInterleavedStages(x->bank, 0, x->nFilters, x->tap, length);
+        else
+            biquad_allpass_bank_processStages(x->bank, 0, x->nFilters, x->tap, x->tap, length);
+
+        x->replayPending -= length;
+        budget -= length;
+    }
+}
+
+
+// fades out towards other, or back from it
+static void phase_shaper_meta_crossfade(phase_shaper_meta *x, float *out, const float *other, int vectorSize, int towards){
+
+    const int stride = x->bank->channelStride;
+
+    for (int n = 0; n < vectorSize; n++) {
+        const float gain = x->enginePosition < x->fadeLength ? (float) x->enginePosition / x->fadeLength : 1;
+        const float weight = towards ? gain : 1 - gain;
+
+        for (int c = 0; c < x->nChannels; c++)
+            out[n * stride + c] += weight * (other[n * stride + c] - out[n * stride + c]);
+
+        if (x->enginePosition < x->fadeLength)
+            x->enginePosition++;
+    }
+}
+
+
+// processes a vector with static parameters while the convolution engine is involved
+static void phase_shaper_meta_switch(phase_shaper_meta *x, float *in, float *out, int vectorSize){
+
+    const int stride = x->bank->channelStride;
+
+    switch (x->engine) {
+
+        case PHASE_SHAPER_META_PRIMING:
+            phase_shaper_convolver_process(x->convolver, in, x->tap, stride, vectorSize);
+            phase_shaper_meta_cascade(x, in, out, vectorSize);
+
+            // the convolution is complete once the whole impulse response has seen input
+            x->enginePosition += vectorSize;
+            if (x->enginePosition >= x->impulseLength) {
+                x->engine = PHASE_SHAPER_META_FADE_IN;
+                x->enginePosition = 0;
+            }
+            break;
+
+        case PHASE_SHAPER_META_FADE_IN:
+            phase_shaper_convolver_process(x->convolver, in, x->tap, stride, vectorSize);
+            phase_shaper_meta_cascade(x, in, out, vectorSize);
+            phase_shaper_meta_crossfade(x, out, x->tap, vectorSize, 1);
+
+            if (x->enginePosition >= x->fadeLength) {
+                x->engine = PHASE_SHAPER_META_CONVOLVING;
+                x->replayPending = 0;
+            }
+            break;
+
+        case PHASE_SHAPER_META_CONVOLVING:
+        case PHASE_SHAPER_META_CATCHUP:
+            phase_shaper_meta_keep(x, in, vectorSize);
+            phase_shaper_convolver_process(x->convolver, in, out, stride, vectorSize);
+
+            if (x->engine == PHASE_SHAPER_META_CATCHUP) {
+                phase_shaper_meta_replay(x, PHASE_SHAPER_META_CATCHUP_RATE * vectorSize);
+
+                if (x->replayPending == 0) {
+                    x->engine = PHASE_SHAPER_META_FADE_OUT;
+                    x->enginePosition = 0;
+                }
+            }
+            break;
+
+        case PHASE_SHAPER_META_FADE_OUT:
+            phase_shaper_convolver_process(x->convolver, in, x->tap, stride, vectorSize);
+            phase_shaper_meta_cascade(x, in, out, vectorSize);
+            phase_shaper_meta_crossfade(x, out, x->tap, vectorSize, 0);
+
+            if (x->enginePosition >= x->fadeLength) {
+                x->engine = PHASE_SHAPER_META_RECURSIVE;
+                x->staticSamples = 0;
+            }
+            break;
+    }
+}
+
+
+static void phase_shaper_meta_allocateHistory(phase_shaper_meta *x){
+
+    // the kept input covers the longest impulse response plus the vector arriving during the replay
+    vas_mem_free(x->history);
+    x->historySize = PHASE_SHAPER_META_CONVOLUTION_LENGTH + x->framesSize;
+    x->history = (float *) vas_mem_alignedAlloc((long) ((size_t) x->historySize * x->bank->channelStride * sizeof(float)), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    x->historyPosition = 0;
+}
+
+
+static void phase_shaper_meta_createEngine(phase_shaper_meta *x){
+
+    x->convolver = phase_shaper_convolver_new(PHASE_SHAPER_META_CONVOLUTION_LENGTH, x->nChannels);
+    x->renderBank = biquad_allpass_bank_new(x->maxFilters, 1, x->sampleRate);
+    biquad_allpass_bank_setForm(x->renderBank, x->bank->form);
+    x->impulse = (float *) vas_mem_alignedAlloc(PHASE_SHAPER_META_CONVOLUTION_LENGTH * sizeof(float), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    x->impulseLength = -1;
+    PHASE_SHAPER_STATS_ADD(x->stats.allocations, 1);
+
+    // without a vector size yet, reserve allocates the kept input
+    if (x->framesSize > 0)
+        phase_shaper_meta_allocateHistory(x);
+
+    // the audio thread sees the engine once everything is in place
+    phase_shaper_atomic_store(&x->engineState, PHASE_SHAPER_META_ENGINE_AVAILABLE);
+}
+
+
+// only once the audio thread has retired the engine, or when the object is freed
+static void phase_shaper_meta_freeEngine(phase_shaper_meta *x){
+
+    if (!x->convolver)
+        return;
+
+    phase_shaper_convolver_free(x->convolver);
+    biquad_allpass_bank_free(x->renderBank);
+    vas_mem_free(x->impulse);
+    vas_mem_free(x->history);
+    x->convolver = NULL;
+    x->renderBank = NULL;
+    x->impulse = NULL;
+    x->engineState = PHASE_SHAPER_META_ENGINE_NONE;
+    x->history = NULL;
+    x->historySize = 0;
+    phase_shaper_atomic_store(&x->engineState, PHASE_SHAPER_META_ENGINE_NONE);
+}
+
+
+phase_shaper_meta *phase_shaper_meta_new(float f0, float Q, float nFilters, float mix, float sampleRate){
+    return phase_shaper_meta_newMultichannel(f0, Q, nFilters, mix, 1, PHASE_SHAPER_META_MAX_FILTERS, sampleRate);
+}
+
+
+phase_shaper_meta *phase_shaper_meta_newMultichannel(float f0, float Q, float nFilters, float mix, int nChannels, int maxFilters, float sampleRate){
+
+    phase_shaper_meta *x = (phase_shaper_meta *) vas_mem_alloc(sizeof(phase_shaper_meta));
+
+    if (nChannels < 1)
+        nChannels = 1;
+
+    if (maxFilters < 1)
+        maxFilters = PHASE_SHAPER_META_MAX_FILTERS;
+    if (maxFilters < nFilters)
+        maxFilters = (int) nFilters;
+    if (maxFilters > PHASE_SHAPER_META_FILTER_LIMIT)
+        maxFilters = PHASE_SHAPER_META_FILTER_LIMIT;
+
+    x->sampleRate = sampleRate;
+
+    x->f0 = x->targetF0 = x->lastF0Signal = f0;
+    x->Q = x->targetQ = x->lastQSignal = Q;
+    x->mix = x->targetMix = x->lastMixSignal = mix;
+    x->spread = x->targetSpread = 0;
+    x->rampF0 = x->rampQ = x->rampMix = x->rampSpread = 0;
+    x->f0Signal = x->QSignal = x->mixSignal = NULL;
+
+    x->nFilters = 0;
+    x->maxFilters = maxFilters;
+    x->nChannels = nChannels;
+
+    x->fadeFrom = 0;
+    x->fadeLength = (int) (PHASE_SHAPER_META_FADE_TIME * x->sampleRate / 1000);
+    x->fadePosition = x->fadeLength;
+
+    x->frames = NULL;
+    x->tap = NULL;
+    x->dry = NULL;
+    x->framesSize = 0;
+    x->framesMemory = NULL;
+
+    // the pool reserves maxFilters stages up front, counts within it never allocate, setMaxFilters grows it on the main thread
+    x->bank = biquad_allpass_bank_new(x->maxFilters, x->nChannels, x->sampleRate);
+
+    x->engine = PHASE_SHAPER_META_RECURSIVE;
+    x->enginePosition = 0;
+    x->staticSamples = 0;
+    x->silent = 0;
+    x->calibratedCacheBlock = phase_shaper_meta_calibratedCacheBlock(x->nChannels);
+    x->cacheBlock = x->calibratedCacheBlock;
+    x->mixMode = PHASE_SHAPER_META_MIX_STAGES;
+    x->renderPosition = 0;
+    x->impulseLength = -1;
+    x->history = NULL;
+    x->historySize = 0;
+    x->historyPosition = 0;
+    x->replayPending = 0;
+
+    x->convolver = NULL;
+    x->renderBank = NULL;
+    x->impulse = NULL;
+
+    x->control.f0 = f0;
+    x->control.Q = Q;
+    x->control.mix = mix;
+    x->control.nFilters = phase_shaper_meta_clampFilterCount(x, nFilters);
+    x->control.rampTime = PHASE_SHAPER_META_RAMP_TIME;
+
+    // the convolution engine only exists while the filter count can use it
+    if (x->control.nFilters >= PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS)
+        phase_shaper_meta_createEngine(x);
+    x->control.sampleRate = sampleRate;
+    x->control.trigMode = x->bank->trigMode;
+    x->control.backend = x->bank->backend;
+    x->control.convolution = PHASE_SHAPER_META_CONVOLUTION_AUTO;
+    x->control.cacheBlock = 0;
+    x->control.mixMode = x->mixMode;
+    x->control.spread = 0;
+    x->control.curve = 1;
+    x->control.f0Changes = x->control.QChanges = x->control.mixChanges = x->control.spreadChanges = 0;
+
+    // the audio side starts in sync, nothing is pending
+    x->applied = x->control;
+    x->slots[0] = x->slots[1] = x->slots[2] = x->control;
+    x->writeSlot = 0;
+    x->sharedSlot = 1;
+    x->readSlot = 2;
+
+    x->rampTime = phase_shaper_meta_rampSamples(x, x->applied.rampTime);
+    phase_shaper_meta_resize(x, x->applied.nFilters);
+    x->fadePosition = x->fadeLength;
 
     return x;
 }
@@ -26,99 +801,639 @@ phase_shaper_meta *phase_shaper_meta_new(float f0, float Q, float nFilters, floa
 void phase_shaper_meta_free(phase_shaper_meta *x){
 
     // free allpasses
-    phase_shaper_meta_setFilterCount(x, 1);
-    biquad_allpass_free(x->allpass_head);
+    biquad_allpass_bank_free(x->bank);
+    vas_mem_free(x->framesMemory);
+
+    phase_shaper_meta_freeEngine(x);
 
     // free phase_shaper_meta
     vas_mem_free(x);
 }
 
 
-void phase_shaper_meta_setFilterCount(phase_shaper_meta *x, float nFilters){
+static void phase_shaper_meta_publish(phase_shaper_meta *x){
+
+    // fill the private slot, then swap it with the shared one and mark it fresh
+    x->slots[x->writeSlot] = x->control;
+    x->writeSlot = phase_shaper_atomic_exchange(&x->sharedSlot, x->writeSlot | PHASE_SHAPER_META_FRESH) & ~PHASE_SHAPER_META_FRESH;
+}
 
-    // cast filter count to int
-    nFilters = (int) nFilters;
 
-    while (x->nFilters < nFilters) {
+static void phase_shaper_meta_acquire(phase_shaper_meta *x){
 
-        biquad_allpass *current_allpass = x->allpass_head;
+    phase_shaper_meta_parameters *p;
 
-        // move to last element
-        while (current_allpass->next != NULL) {
-          current_allpass = current_allpass->next;
-        }
+    if (!(phase_shaper_atomic_load(&x->sharedSlot) & PHASE_SHAPER_META_FRESH))
+        return;
 
-        // push new allpass
-        current_allpass->next = biquad_allpass_new(x->f0, x->Q, x->mix, x->sampleRate);
+    // swap the read slot with the shared one, the control thread never touches the read slot
+    x->readSlot = phase_shaper_atomic_exchange(&x->sharedSlot, x->readSlot) & ~PHASE_SHAPER_META_FRESH;
+    p = &x->slots[x->readSlot];
 
-        x->nFilters = x->nFilters + 1;
+    if (p->backend != x->applied.backend)
+        biquad_allpass_bank_setBackend(x->bank, p->backend);
+
+    if (p->trigMode != x->applied.trigMode) {
+        biquad_allpass_bank_setTrigMode(x->bank, p->trigMode);
+        phase_shaper_meta_updateAllpassInstances(x);
     }
 
+    if (p->curve != x->applied.curve) {
+        biquad_allpass_bank_setSpread(x->bank, x->spread, p->curve);
+        phase_shaper_meta_updateAllpassInstances(x);
+    }
 
-    while (x->nFilters > nFilters) {
+    if (p->mixMode != x->applied.mixMode) {
+        x->mixMode = p->mixMode;
+        phase_shaper_meta_updateAllpassInstances(x);
+    }
 
-        biquad_allpass *current_allpass = x->allpass_head;
+    if (p->sampleRate != x->applied.sampleRate) {
+        // a running fade is cut short, like a filter count change does
+        if (x->fadePosition < x->fadeLength)
+            biquad_allpass_bank_setStageCount(x->bank, x->nFilters);
 
-        // move to second last element
-        while (current_allpass->next->next != NULL) {
-            current_allpass = current_allpass->next;
-        }
+        x->sampleRate = p->sampleRate;
+        x->fadeLength = (int) (PHASE_SHAPER_META_FADE_TIME * x->sampleRate / 1000);
+        x->fadePosition = x->fadeLength;
+        biquad_allpass_bank_setSampleRate(x->bank, x->sampleRate);
+        phase_shaper_meta_updateAllpassInstances(x);
+    }
 
-        // pop last allpass
-        biquad_allpass_free(current_allpass->next);
-        current_allpass->next = NULL;
+#ifdef PHASE_SHAPER_STATS
+    {
+        // every change read at once starts the same ramp, the coefficients follow once per sub-block however many arrived
+        const unsigned int messages = (p->f0Changes - x->applied.f0Changes) + (p->QChanges - x->applied.QChanges)
+                                      + (p->mixChanges - x->applied.mixChanges) + (p->spreadChanges - x->applied.spreadChanges);
 
-        x->nFilters = x->nFilters - 1;
+        PHASE_SHAPER_STATS_ADD(x->stats.parameterMessages, messages);
+        if (messages > 1)
+            PHASE_SHAPER_STATS_ADD(x->stats.coalescedMessages, messages - 1);
     }
+#endif
 
-}
+    // the audio thread never calibrates, the size of the channel layout was stored when the object was created
+    if (p->cacheBlock != x->applied.cacheBlock)
+        x->cacheBlock = p->cacheBlock > 0 ? p->cacheBlock : x->calibratedCacheBlock;
 
+    x->rampTime = phase_shaper_meta_rampSamples(x, p->rampTime);
 
-void phase_shaper_meta_updateAllpassInstances(phase_shaper_meta *x){
+    if (p->f0Changes != x->applied.f0Changes) {
+        x->targetF0 = p->f0;
+        x->rampF0 = x->rampTime;
+    }
+
+    if (p->QChanges != x->applied.QChanges) {
+        x->targetQ = p->Q;
+        x->rampQ = x->rampTime;
+    }
+
+    if (p->mixChanges != x->applied.mixChanges) {
+        x->targetMix = p->mix;
+        x->rampMix = x->rampTime;
+    }
+
+    if (p->spreadChanges != x->applied.spreadChanges) {
+        x->targetSpread = p->spread;
+        x->rampSpread = x->rampTime;
+    }
+
+    if (p->nFilters != x->nFilters)
+        phase_shaper_meta_resize(x, p->nFilters);
+
+    x->applied = *p;
+}
 
-    biquad_allpass * current_allpass = x->allpass_head;
 
-    while (current_allpass != NULL) {
+void phase_shaper_meta_setFilterCount(phase_shaper_meta *x, float nFilters){
+    x->control.nFilters = phase_shaper_meta_clampFilterCount(x, nFilters);
+    phase_shaper_meta_publish(x);
+}
 
-        biquad_allpass_setFrequency(current_allpass, x->f0);
-        biquad_allpass_setQ(current_allpass, x->Q);
-        biquad_allpass_setMix(current_allpass, x->mix);
 
-        biquad_allpass_updateParameters(current_allpass);
+void phase_shaper_meta_updateAllpassInstances(phase_shaper_meta *x){
 
-        current_allpass = current_allpass->next;
-  }
+    // includes stages which are still fading out
+    biquad_allpass_bank_setStages(x->bank, 0, x->bank->nStages, x->f0, x->Q, phase_shaper_meta_stageMix(x->mixMode, x->mix));
 }
 
 
 void phase_shaper_meta_setQ(phase_shaper_meta *x, float Q){
-    x->Q = Q;
-    phase_shaper_meta_updateAllpassInstances(x);
+    x->control.Q = Q;
+    x->control.QChanges++;
+    phase_shaper_meta_publish(x);
 }
 
 
 void phase_shaper_meta_setFrequency(phase_shaper_meta *x, float f0){
-    x->f0 = f0;
-    phase_shaper_meta_updateAllpassInstances(x);
+    x->control.f0 = f0;
+    x->control.f0Changes++;
+    phase_shaper_meta_publish(x);
 }
 
 
 void phase_shaper_meta_setMix(phase_shaper_meta *x, float mix){
-    x->mix = mix;
+    x->control.mix = mix;
+    x->control.mixChanges++;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setMixMode(phase_shaper_meta *x, int mixMode){
+    x->control.mixMode = mixMode == PHASE_SHAPER_META_MIX_GLOBAL ? PHASE_SHAPER_META_MIX_GLOBAL : PHASE_SHAPER_META_MIX_STAGES;
+    phase_shaper_meta_publish(x);
+}
+
+
+float phase_shaper_meta_outputMix(phase_shaper_meta *x){
+    return phase_shaper_meta_globalMix(x->mixMode, x->mix);
+}
+
+
+void phase_shaper_meta_setSpread(phase_shaper_meta *x, float octaves){
+    x->control.spread = octaves;
+    x->control.spreadChanges++;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setCurve(phase_shaper_meta *x, float curve){
+    x->control.curve = curve > 0 ? curve : 1;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setRampTime(phase_shaper_meta *x, float milliseconds){
+    x->control.rampTime = milliseconds;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setSampleRate(phase_shaper_meta *x, float sampleRate){
+
+    if (sampleRate <= 0 || sampleRate == x->control.sampleRate)
+        return;
+
+    x->control.sampleRate = sampleRate;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setModulation(phase_shaper_meta *x, const float *f0, const float *Q, const float *mix){
+    x->f0Signal = f0;
+    x->QSignal = Q;
+    x->mixSignal = mix;
+}
+
+
+static float phase_shaper_meta_advance(float *current, float target, int *remaining, const float *signal, float *lastSignal, int length){
+
+    // a moving signal overrides the ramp of the last message
+    if (signal != NULL && *signal != *lastSignal) {
+        *lastSignal = *signal;
+        *remaining = 0;
+        *current = *signal;
+    }
+    else if (*remaining > length) {
+        *current += (target - *current) * length / *remaining;
+        *remaining -= length;
+    }
+    else {
+        *remaining = 0;
+        *current = target;
+    }
+
+    return *current;
+}
+
+
+static int phase_shaper_meta_schedule(phase_shaper_meta *x, int vectorSize, int *length, float *f0, float *Q, float *mix, float *spread){
+
+    const float lastF0 = x->f0, lastQ = x->Q, lastMix = x->mix, lastSpread = x->spread;
+    int size = PHASE_SHAPER_META_SUBBLOCK;
+    int nBlocks;
+    int moving = 0;
+
+    // while the convolution runs, the parameters wait until the cascade has caught up with the input
+    if (x->engine >= PHASE_SHAPER_META_CONVOLVING) {
+        if (x->engine == PHASE_SHAPER_META_CONVOLVING && phase_shaper_meta_moved(x, vectorSize))
+            phase_shaper_meta_startCatchUp(x);
+
+        f0[0] = x->f0;
+        Q[0] = x->Q;
+        mix[0] = x->mix;
+        spread[0] = x->spread;
+        *length = vectorSize;
+        return 1;
+    }
+
+    phase_shaper_meta_acquire(x);
+
+    while (size * PHASE_SHAPER_META_MAX_SUBBLOCKS < vectorSize)
+        size *= 2;
+
+    nBlocks = (vectorSize + size - 1) / size;
+
+    // read all modulation vectors before the outputs are written
+    for (int b = 0; b < nBlocks; b++) {
+        const int offset = b * size;
+        const int n = vectorSize - offset < size ? vectorSize - offset : size;
+
+        f0[b] = phase_shaper_meta_advance(&x->f0, x->targetF0, &x->rampF0, x->f0Signal ? x->f0Signal + offset : NULL, &x->lastF0Signal, n);
+        Q[b] = phase_shaper_meta_advance(&x->Q, x->targetQ, &x->rampQ, x->QSignal ? x->QSignal + offset : NULL, &x->lastQSignal, n);
+        mix[b] = phase_shaper_meta_advance(&x->mix, x->targetMix, &x->rampMix, x->mixSignal ? x->mixSignal + offset : NULL, &x->lastMixSignal, n);
+        spread[b] = phase_shaper_meta_advance(&x->spread, x->targetSpread, &x->rampSpread, NULL, NULL, n);
+
+        if (b > 0 && (f0[b] != f0[b-1] || Q[b] != Q[b-1] || mix[b] != mix[b-1] || spread[b] != spread[b-1]))
+            moving = 1;
+    }
+
+    phase_shaper_meta_select(x, vectorSize, moving || f0[0] != lastF0 || Q[0] != lastQ || mix[0] != lastMix || spread[0] != lastSpread);
+
+    // constant parameters are processed in one piece
+    if (!moving) {
+        *length = vectorSize;
+        return 1;
+    }
+
+    *length = size;
+    return nBlocks;
+}
+
+
+static void phase_shaper_meta_apply(phase_shaper_meta *x, float *f0, float *Q, float *mix, float *spread,
+                                    float f0New, float QNew, float mixNew, float spreadNew){
+
+    const float stageMix = phase_shaper_meta_stageMix(x->mixMode, mixNew);
+
+    // a global mix leaves the stages untouched
+    if (f0New == *f0 && QNew == *Q && stageMix == phase_shaper_meta_stageMix(x->mixMode, *mix) && spreadNew == *spread) {
+        *mix = mixNew;
+        return;
+    }
+
+    *f0 = f0New;
+    *Q = QNew;
+    *mix = mixNew;
+    *spread = spreadNew;
+
+    {
+        PHASE_SHAPER_STATS_START(start);
+        biquad_allpass_bank_setSpread(x->bank, spreadNew, x->bank->curve);
+        biquad_allpass_bank_setStages(x->bank, 0, x->bank->nStages, f0New, QNew, stageMix);
+        PHASE_SHAPER_STATS_ADD(x->stats.coefficientUpdates, 1);
+        PHASE_SHAPER_STATS_ADD_TIME(x->stats.coefficientTime, start);
+    }
+}
+
+
+void phase_shaper_meta_setBackend(phase_shaper_meta *x, int backend){
+    x->control.backend = backend;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setTrigMode(phase_shaper_meta *x, int trigMode){
+    x->control.trigMode = trigMode;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setForm(phase_shaper_meta *x, int form){
+
+    biquad_allpass_bank_setForm(x->bank, form);
     phase_shaper_meta_updateAllpassInstances(x);
+
+    // an impulse response of the old form is rendered again
+    if (x->renderBank)
+        biquad_allpass_bank_setForm(x->renderBank, form);
+    x->impulseLength = -1;
+    x->engine = PHASE_SHAPER_META_RECURSIVE;
+    x->staticSamples = 0;
+    x->silent = 0;
+}
+
+
+void phase_shaper_meta_setMaxFilters(phase_shaper_meta *x, int maxFilters){
+
+    if (maxFilters > PHASE_SHAPER_META_FILTER_LIMIT)
+        maxFilters = PHASE_SHAPER_META_FILTER_LIMIT;
+
+    if (maxFilters <= x->maxFilters)
+        return;
+
+    // the arrays move, coefficients and states are copied along
+    biquad_allpass_bank_reserve(x->bank, maxFilters);
+    PHASE_SHAPER_STATS_ADD(x->stats.allocations, 1);
+    if (x->renderBank)
+        biquad_allpass_bank_reserve(x->renderBank, maxFilters);
+
+    x->maxFilters = maxFilters;
+}
+
+
+void phase_shaper_meta_prepare(phase_shaper_meta *x, float nFilters){
+
+    const int state = phase_shaper_atomic_load(&x->engineState);
+
+    phase_shaper_meta_setMaxFilters(x, (int) nFilters);
+
+    if (nFilters < PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS) {
+        // the audio thread fades back to the cascade and retires the engine, a later call frees it
+        if (state == PHASE_SHAPER_META_ENGINE_RETIRED)
+            phase_shaper_meta_freeEngine(x);
+        else
+            phase_shaper_atomic_compareExchange(&x->engineState, PHASE_SHAPER_META_ENGINE_AVAILABLE, PHASE_SHAPER_META_ENGINE_RETIRING);
+        return;
+    }
+
+    if (state == PHASE_SHAPER_META_ENGINE_NONE) {
+        phase_shaper_meta_createEngine(x);
+        return;
+    }
+
+    // an engine which has not been freed yet is taken back, a retired one missed vector size changes
+    if (state == PHASE_SHAPER_META_ENGINE_RETIRED && x->historySize < PHASE_SHAPER_META_CONVOLUTION_LENGTH + x->framesSize)
+        phase_shaper_meta_allocateHistory(x);
+    phase_shaper_atomic_store(&x->engineState, PHASE_SHAPER_META_ENGINE_AVAILABLE);
+}
+
+
+void phase_shaper_meta_setConvolution(phase_shaper_meta *x, int convolution){
+    x->control.convolution = convolution;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_setCacheBlock(phase_shaper_meta *x, int frames){
+    x->control.cacheBlock = frames > 0 ? frames : 0;
+    phase_shaper_meta_publish(x);
+}
+
+
+void phase_shaper_meta_reserve(phase_shaper_meta *x, int vectorSize){
+
+    const int stride = x->bank->channelStride;
+    size_t size;
+    int state;
+
+    if (vectorSize <= x->framesSize)
+        return;
+
+    // interleaved frames, the fade tap and the dry input share one block, padding channels stay silent
+    size = (size_t) vectorSize * stride * sizeof(float);
+
+    vas_mem_free(x->framesMemory);
+    x->framesMemory = vas_mem_alignedAlloc((long) (3 * size), BIQUAD_ALLPASS_BANK_ALIGNMENT);
+    x->frames = (float *) x->framesMemory;
+    x->tap = x->frames + (size_t) vectorSize * stride;
+    x->dry = x->tap + (size_t) vectorSize * stride;
+    x->framesSize = vectorSize;
+
+    // the control side never frees an engine the audio thread has not retired
+    state = phase_shaper_atomic_load(&x->engineState);
+    if (state != PHASE_SHAPER_META_ENGINE_AVAILABLE && state != PHASE_SHAPER_META_ENGINE_RETIRING)
+        return;
+
+    phase_shaper_meta_allocateHistory(x);
+
+    // input kept so far is lost, the cascade continues from silence
+    if (x->engine >= PHASE_SHAPER_META_CONVOLVING)
+        biquad_allpass_bank_clearStates(x->bank, 0, x->nFilters);
+    x->engine = PHASE_SHAPER_META_RECURSIVE;
+    x->staticSamples = 0;
+}
+
+
+// 1 if the input and all states of the cascade are silent, the states are cleared once when the silence starts
+static int phase_shaper_meta_bypass(phase_shaper_meta *x, const float *in, int nSamples){
+
+    if (x->fadePosition < x->fadeLength) {
+        x->silent = 0;
+        return 0;
+    }
+
+    for (int n = 0; n < nSamples; n++) {
+        if (fabsf(in[n]) >= PHASE_SHAPER_META_SILENCE_THRESHOLD) {
+            x->silent = 0;
+            return 0;
+        }
+    }
+
+    // a bypassed cascade keeps its cleared states, the next loud vector starts from zero
+    if (!x->silent) {
+        if (!biquad_allpass_bank_decayed(x->bank, 0, x->nFilters, PHASE_SHAPER_META_SILENCE_THRESHOLD))
+            return 0;
+
+        biquad_allpass_bank_clearStates(x->bank, 0, x->nFilters);
+        x->silent = 1;
+    }
+
+    return 1;
+}
+
+
+#ifdef PHASE_SHAPER_STATS
+static void phase_shaper_meta_count(phase_shaper_meta *x, unsigned long long start, int vectorSize){
+
+    const unsigned long long time = phase_shaper_stats_now() - start;
+
+    x->stats.vectors++;
+    x->stats.frames += vectorSize;
+    x->stats.time += time;
+    if (time > x->stats.worstTime)
+        x->stats.worstTime = time;
+}
+#endif
+
+
+// the input of a global mix below 1, kept in the dry buffer if the cascade overwrites it, NULL if the output is all wet
+static const float *phase_shaper_meta_keepDry(phase_shaper_meta *x, const float *in, const float *out, int vectorSize, int nBlocks, const float *mix){
+
+    const int frameSize = x->nChannels > 1 ? x->bank->channelStride : 1;
+    int wet = 1;
+
+    for (int b = 0; b < nBlocks; b++) {
+        if (phase_shaper_meta_globalMix(x->mixMode, mix[b]) != 1)
+            wet = 0;
+    }
+
+    if (wet)
+        return NULL;
+
+    if (in != out)
+        return in;
+
+    memcpy(x->dry, in, (size_t) vectorSize * frameSize * sizeof(float));
+    return x->dry;
+}
+
+
+// mixes the output of the cascade with its input once, in the sub-blocks of the parameters
+static void phase_shaper_meta_mixGlobal(phase_shaper_meta *x, const float *dry, float *out, int vectorSize, int nBlocks, int length, const float *mix){
+
+    const int frameSize = x->nChannels > 1 ? x->bank->channelStride : 1;
+
+    for (int b = 0; b < nBlocks; b++) {
+        const size_t first = (size_t) b * length * frameSize;
+        const size_t last = (size_t) (vectorSize - b * length < length ? vectorSize : (b + 1) * length) * frameSize;
+        const float m = phase_shaper_meta_globalMix(x->mixMode, mix[b]);
+
+        if (m == 1)
+            continue;
+
+        for (size_t i = first; i < last; i++)
+            out[i] = (1-m) * dry[i] + m * out[i];
+    }
+}
+
+
+// processes a scheduled vector, in and out hold one channel or interleaved frames
+static void phase_shaper_meta_vector(phase_shaper_meta *x, float *in, float *out, int vectorSize, int nBlocks, int length,
+                                     const float *f0, const float *Q, const float *mix, const float *spread,
+                                     float appliedF0, float appliedQ, float appliedMix, float appliedSpread){
+
+    const int frameSize = x->nChannels > 1 ? x->bank->channelStride : 1;
+    const float *dry;
+
+    if (x->engine >= PHASE_SHAPER_META_PRIMING) {
+        x->silent = 0;
+        dry = phase_shaper_meta_keepDry(x, in, out, vectorSize, 1, mix);
+        phase_shaper_meta_apply(x, &appliedF0, &appliedQ, &appliedMix, &appliedSpread, f0[0], Q[0], mix[0], spread[0]);
+        phase_shaper_meta_switch(x, in, out, vectorSize);
+        if (dry)
+            phase_shaper_meta_mixGlobal(x, dry, out, vectorSize, 1, vectorSize, mix);
+        return;
+    }
+
+    // the output of a silent cascade stays below the threshold, the coefficients still follow the parameters
+    if (phase_shaper_meta_bypass(x, in, vectorSize * frameSize)) {
+        phase_shaper_meta_apply(x, &appliedF0, &appliedQ, &appliedMix, &appliedSpread,
+                                f0[nBlocks - 1], Q[nBlocks - 1], mix[nBlocks - 1], spread[nBlocks - 1]);
+        memset(out, 0, (size_t) vectorSize * frameSize * sizeof(float));
+        PHASE_SHAPER_STATS_ADD(x->stats.bypassedVectors, 1);
+    }
+    else {
+        dry = phase_shaper_meta_keepDry(x, in, out, vectorSize, nBlocks, mix);
+
+        for (int b = 0; b < nBlocks; b++) {
+            const int offset = b * length;
+            const int n = vectorSize - offset < length ? vectorSize - offset : length;
+
+            phase_shaper_meta_apply(x, &appliedF0, &appliedQ, &appliedMix, &appliedSpread, f0[b], Q[b], mix[b], spread[b]);
+            phase_shaper_meta_cascade(x, in + (size_t) offset * frameSize, out + (size_t) offset * frameSize, n);
+        }
+
+        if (dry)
+            phase_shaper_meta_mixGlobal(x, dry, out, vectorSize, nBlocks, length, mix);
+    }
+
+    if (x->engine == PHASE_SHAPER_META_RENDERING)
+        phase_shaper_meta_render(x, vectorSize);
+}
+
+
+// 1 if two vectors share memory without starting at the same sample, filtering in place would read outputs back as input
+static int phase_shaper_meta_overlaps(const float *a, const float *b, int vectorSize){
+
+    const uintptr_t first = (uintptr_t) a, second = (uintptr_t) b;
+    const uintptr_t size = (uintptr_t) vectorSize * sizeof(float);
+
+    return first != second && first < second + size && second < first + size;
 }
 
 
 void phase_shaper_meta_process(phase_shaper_meta *x, float *in, float *out, int vectorSize){
 
-    biquad_allpass *current_allpass = x->allpass_head;
+    float f0[PHASE_SHAPER_META_MAX_SUBBLOCKS], Q[PHASE_SHAPER_META_MAX_SUBBLOCKS], mix[PHASE_SHAPER_META_MAX_SUBBLOCKS];
+    float spread[PHASE_SHAPER_META_MAX_SUBBLOCKS];
+    const float appliedF0 = x->f0, appliedQ = x->Q, appliedMix = x->mix, appliedSpread = x->spread;
+    const unsigned int denormals = phase_shaper_denormal_disable();
+    PHASE_SHAPER_STATS_START(start);
+    int length;
+    const int nBlocks = phase_shaper_meta_schedule(x, vectorSize, &length, f0, Q, mix, spread);
+
+    phase_shaper_meta_reserve(x, vectorSize);
+
+    // a single channel instance leaves the interleaved frames unused, they hold the input instead
+    if (phase_shaper_meta_overlaps(in, out, vectorSize)) {
+        memcpy(x->frames, in, (size_t) vectorSize * sizeof(float));
+        in = x->frames;
+    }
+
+    phase_shaper_meta_vector(x, in, out, vectorSize, nBlocks, length, f0, Q, mix, spread, appliedF0, appliedQ, appliedMix, appliedSpread);
+
+#ifdef PHASE_SHAPER_STATS
+    phase_shaper_meta_count(x, start, vectorSize);
+#endif
+    phase_shaper_denormal_restore(denormals);
+}
 
-    while (current_allpass != NULL) {
 
-        biquad_allpass_filter_audio(current_allpass, in, out, vectorSize);
+void phase_shaper_meta_processMultichannel(phase_shaper_meta *x, float **in, float **out, int vectorSize){
 
-        in = out;
+    float f0[PHASE_SHAPER_META_MAX_SUBBLOCKS], Q[PHASE_SHAPER_META_MAX_SUBBLOCKS], mix[PHASE_SHAPER_META_MAX_SUBBLOCKS];
+    float spread[PHASE_SHAPER_META_MAX_SUBBLOCKS];
+    const float appliedF0 = x->f0, appliedQ = x->Q, appliedMix = x->mix, appliedSpread = x->spread;
+    const int stride = x->bank->channelStride;
+    unsigned int denormals;
+    int nBlocks, length;
 
-        current_allpass = current_allpass->next;
+    if (x->nChannels == 1) {
+        phase_shaper_meta_process(x, in[0], out[0], vectorSize);
+        return;
     }
+
+    PHASE_SHAPER_STATS_START(start);
+
+    denormals = phase_shaper_denormal_disable();
+
+    phase_shaper_meta_reserve(x, vectorSize);
+
+    nBlocks = phase_shaper_meta_schedule(x, vectorSize, &length, f0, Q, mix, spread);
+
+    for (int c = 0; c < x->nChannels; c++) {
+        for (int n = 0; n < vectorSize; n++)
+            x->frames[n * stride + c] = in[c][n];
+    }
+
+    phase_shaper_meta_vector(x, x->frames, x->frames, vectorSize, nBlocks, length, f0, Q, mix, spread, appliedF0, appliedQ, appliedMix, appliedSpread);
+
+    for (int c = 0; c < x->nChannels; c++) {
+        for (int n = 0; n < vectorSize; n++)
+            out[c][n] = x->frames[n * stride + c];
+    }
+
+#ifdef PHASE_SHAPER_STATS
+    phase_shaper_meta_count(x, start, vectorSize);
+#endif
+    phase_shaper_denormal_restore(denormals);
+}
+
+
+int phase_shaper_meta_steady(phase_shaper_meta *x){
+
+    // anything that changes the coefficients within the next vector
+    if ((phase_shaper_atomic_load(&x->sharedSlot) & PHASE_SHAPER_META_FRESH) || x->fadePosition < x->fadeLength
+        || x->rampF0 || x->rampQ || x->rampMix || x->rampSpread || x->f0Signal || x->QSignal || x->mixSignal)
+        return 0;
+
+    if (x->nChannels > 1 || x->bank->form != BIQUAD_ALLPASS_FORM_DF1 || x->engine != PHASE_SHAPER_META_RECURSIVE)
+        return 0;
+
+    // the convolution engine would take over once the parameters have settled, unless a rendering ruled it out
+    return phase_shaper_atomic_load(&x->engineState) != PHASE_SHAPER_META_ENGINE_AVAILABLE || x->applied.convolution == PHASE_SHAPER_META_CONVOLUTION_OFF
+        || (x->impulseLength == 0 && phase_shaper_meta_sameImpulse(x));
+}
+
+
+#ifdef PHASE_SHAPER_STATS
+void phase_shaper_meta_getStats(phase_shaper_meta *x, phase_shaper_stats *stats){
+    *stats = x->stats;
+}
+
+
+void phase_shaper_meta_resetStats(phase_shaper_meta *x){
+    memset(&x->stats, 0, sizeof(phase_shaper_stats));
 }
+#endif
@@ -4,34 +4,246 @@
  * @date 30 Sep 2021
  * @brief Wrapper for hosting allpass filters.<br>
  *
- * phase_shaper_meta wraps around the biquad_allpass class.<br>
- * It contains a variable amount of allpass instances and propagates parameter changes to each instances. <br>
- * It also performs the audio processing for each filter instance in a series.<br>
- * The filter instances are being stored in a linked list.<br>
+ * phase_shaper_meta wraps around the biquad_allpass_bank class.<br>
+ * It contains a variable amount of allpass stages and propagates parameter changes to each stage. <br>
+ * It also performs the audio processing for each filter stage in a series.<br>
+ * The coefficients and states of all stages are stored in contiguous arrays of the filter bank.<br>
+ * A single meta instance can process several channels which share all parameters and coefficients.<br>
+ * Parameter changes are ramped, the coefficients follow in sub-blocks of PHASE_SHAPER_META_SUBBLOCK samples.<br>
+ * The cascade runs in passes of a fixed amount of frames, every stage filters a pass before the next pass starts, <br>
+ * so the working buffer stays in the L1 cache however long the host vectors are. The pass size is measured once per process
+ * and channel layout when the first instance is created, see phase_shaper_meta_setCacheBlock and phase_shaper_meta_pinCacheBlock. <br>
+ * <br>
+ * The setters may run on a control thread while another thread processes audio. <br>
+ * They publish a copy of all parameters through a lock-free triple buffer, the audio thread picks up the newest copy at the start of a vector. <br>
+ * Neither side waits, locks or allocates for the handoff, the filter bank is only touched by the audio thread. <br>
+ * The setters themselves must not be called from several threads at once. <br>
+ * <br>
+ * Deep cascades with static parameters can switch to a second engine. The impulse response of the cascade is rendered
+ * alongside the running audio and applied by a phase_shaper_convolver, if a cost model of the filter count against the length
+ * of the impulse response predicts fewer operations. <br>
+ * The engines crossfade within PHASE_SHAPER_META_FADE_TIME. While the convolution runs, the input is kept, <br>
+ * when the parameters move again the cascade replays it before it takes over, so its states are current. <br>
+ * <br>
+ * A spread places the center frequencies of the stages across a range of octaves around f0, see biquad_allpass_bank_setSpread. <br>
+ * It is ramped like f0, Q and mix, a spread of 0 keeps all stages at f0 and on the kernels for uniform stages. <br>
+ * <br>
+ * The dry wet mix is applied inside every stage by default, which shapes the response of the cascade itself. <br>
+ * In PHASE_SHAPER_META_MIX_GLOBAL the stages run fully wet and the dry signal is mixed in once at the output, see phase_shaper_meta_setMixMode. <br>
+ * <br>
+ * Once the input and every state of the recursive cascade fall below -160 dB, the cascade is bypassed and outputs silence. <br>
+ * Its states are cleared, so it starts cleanly with the next vector that is not silent. <br>
+ * The process functions also flush denormals to zero while they run, see phase_shaper_denormal.h. <br>
  */
 
 #ifndef ps_meta
 #define ps_meta
 
 #include <stddef.h>
+#include "phase_shaper_stats.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief The amount of samples between two coefficient updates while parameters are moving <br>
+ */
+#define PHASE_SHAPER_META_SUBBLOCK 32
+
+/**
+ * @brief The maximum amount of sub-blocks per audio vector, longer vectors use longer sub-blocks <br>
+ */
+#define PHASE_SHAPER_META_MAX_SUBBLOCKS 64
+
+/**
+ * @brief The pass sizes the cascade is calibrated with, in frames, and the length of the calibration buffer <br>
+ */
+#define PHASE_SHAPER_META_MIN_CACHE_BLOCK 64
+#define PHASE_SHAPER_META_MAX_CACHE_BLOCK 8192
+
+/**
+ * @brief The default ramp time of parameter changes in milliseconds <br>
+ */
+#define PHASE_SHAPER_META_RAMP_TIME 20
+
+/**
+ * @brief The default size of the stage pool, phase_shaper_meta_setMaxFilters grows it <br>
+ */
+#define PHASE_SHAPER_META_MAX_FILTERS 128
+
+/**
+ * @brief The largest stage pool phase_shaper_meta_setMaxFilters grows to <br>
+ */
+#define PHASE_SHAPER_META_FILTER_LIMIT 4096
+
+/**
+ * @brief The crossfade time of filter count changes in milliseconds <br>
+ */
+#define PHASE_SHAPER_META_FADE_TIME 10
+
+/**
+ * @brief The longest impulse response the convolution engine handles in samples <br>
+ */
+#define PHASE_SHAPER_META_CONVOLUTION_LENGTH 8192
+
+/**
+ * @brief Shorter cascades never use the convolution engine, it is only allocated while the filter count reaches this <br>
+ */
+#define PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS 16
+
+/**
+ * @brief The time in milliseconds parameters have to stay static before an impulse response is rendered <br>
+ */
+#define PHASE_SHAPER_META_SETTLE_TIME 50
+
+/**
+ * @brief Input and states below this magnitude (-160 dB) count as silence, the cascade is bypassed <br>
+ */
+#define PHASE_SHAPER_META_SILENCE_THRESHOLD 1e-8f
+
+/**
+ * @brief The speed of the replay of the kept input, in vectors per vector <br>
+ */
+#define PHASE_SHAPER_META_CATCHUP_RATE 8
+
+/**
+ * @brief The ways of choosing between the recursive cascade and the convolution <br>
+ */
+typedef enum phase_shaper_meta_convolution{
+    PHASE_SHAPER_META_CONVOLUTION_OFF = 0, /**< Always run the recursive cascade */
+    PHASE_SHAPER_META_CONVOLUTION_AUTO, /**< Convolve static parameters if the cost model predicts a gain */
+    PHASE_SHAPER_META_CONVOLUTION_ALWAYS /**< Convolve static parameters whenever the impulse response fits */
+} phase_shaper_meta_convolution;
+
+/**
+ * @brief The places the dry wet mix is applied <br>
+ */
+typedef enum phase_shaper_meta_mixMode{
+    PHASE_SHAPER_META_MIX_STAGES = 0, /**< Every stage mixes its input with its output, the response of the original phase_shaper */
+    PHASE_SHAPER_META_MIX_GLOBAL /**< The stages run fully wet, the input of the cascade is mixed with its output once */
+} phase_shaper_meta_mixMode;
+
+/**
+ * @brief The states of the engine switch <br>
+ */
+typedef enum phase_shaper_meta_engine{
+    PHASE_SHAPER_META_RECURSIVE = 0, /**< The cascade runs */
+    PHASE_SHAPER_META_RENDERING, /**< The cascade runs, the impulse response is rendered alongside */
+    PHASE_SHAPER_META_PRIMING, /**< The cascade runs, the convolution fills its delay line */
+    PHASE_SHAPER_META_FADE_IN, /**< Both run, the output fades to the convolution */
+    PHASE_SHAPER_META_CONVOLVING, /**< The convolution runs, the input is kept for the cascade */
+    PHASE_SHAPER_META_CATCHUP, /**< The convolution runs, the cascade replays the kept input */
+    PHASE_SHAPER_META_FADE_OUT /**< Both run, the output fades back to the cascade */
+} phase_shaper_meta_engine;
+
+/**
+ * @brief The life cycle of the convolution engine, handed between the control and the audio thread <br>
+ */
+typedef enum phase_shaper_meta_engineState{
+    PHASE_SHAPER_META_ENGINE_NONE = 0, /**< Nothing is allocated */
+    PHASE_SHAPER_META_ENGINE_AVAILABLE, /**< Allocated, the audio thread may switch to the convolution */
+    PHASE_SHAPER_META_ENGINE_RETIRING, /**< To be freed, the audio thread catches up and fades back to the cascade */
+    PHASE_SHAPER_META_ENGINE_RETIRED /**< The audio thread has let go, phase_shaper_meta_prepare frees it */
+} phase_shaper_meta_engineState;
+
+/**
+ * @struct phase_shaper_meta_parameters
+ * @brief A snapshot of all parameters handed from the control thread to the audio thread <br>
+ *
+ * The change counters tell repeated messages with the same value apart, every message restarts its ramp. <br>
+ */
+typedef struct phase_shaper_meta_parameters{
+    float f0; /**< The center frequency of the filters */
+    float Q; /**< The q factor of the filters */
+    float mix; /**< the dry wet mix of the phase shaper */
+    int nFilters; /**< The amount of serial processing filters */
+    float rampTime; /**< The length of a parameter ramp in milliseconds */
+    float sampleRate; /**< The sample rate of the incoming audio stream */
+    int trigMode; /**< The biquad_allpass_trig mode of the coefficients */
+    int backend; /**< The requested biquad_allpass_backend */
+    int convolution; /**< The phase_shaper_meta_convolution mode */
+    int cacheBlock; /**< The requested amount of frames per pass of the cascade, 0 for the calibrated one */
+    int mixMode; /**< The phase_shaper_meta_mixMode */
+    float spread; /**< The width of the frequency range of the stages in octaves */
+    float curve; /**< The exponent of the frequency distribution of the stages */
+    unsigned int f0Changes; /**< Counts the frequency messages */
+    unsigned int QChanges; /**< Counts the q factor messages */
+    unsigned int mixChanges; /**< Counts the mix messages */
+    unsigned int spreadChanges; /**< Counts the spread messages */
+} phase_shaper_meta_parameters;
+
 /**
  * @struct phase_shaper_meta
  * @brief The wrapper struct for the audio processing job <br>
  */
 typedef struct phase_shaper_meta{
     int nFilters; /**< The amount of serial processing filters */
+    int maxFilters; /**< The amount of filters preallocated in the stage pool */
+    int fadeFrom; /**< The filter count before the last change, the output fades from this cascade to the new one */
+    int fadeLength; /**< The length of a filter count crossfade in samples */
+    int fadePosition; /**< The progress of the running crossfade, fadeLength if there is none */
+    int nChannels; /**< The amount of channels processed with the same parameters */
     float sampleRate; /**< The sample rate of the incoming audio stream */
     float f0; /**< The center frequency of the filters */
     float Q; /**< The q factor of the filters */
     float mix; /**< the dry wet mix of the phase shaper */
-    struct biquad_allpass *allpass_head; /**< Pointer to the first allpass filter instance */
+    float spread; /**< The width of the frequency range of the stages in octaves */
+    float targetF0; /**< The center frequency f0 is ramped to */
+    float targetQ; /**< The q factor Q is ramped to */
+    float targetMix; /**< The dry wet mix mix is ramped to */
+    float targetSpread; /**< The spread spread is ramped to */
+    int rampF0; /**< The remaining samples of the frequency ramp */
+    int rampQ; /**< The remaining samples of the q factor ramp */
+    int rampMix; /**< The remaining samples of the mix ramp */
+    int rampSpread; /**< The remaining samples of the spread ramp */
+    int rampTime; /**< The length of a parameter ramp in samples */
+    const float *f0Signal; /**< The modulation vector of the center frequency, NULL if not connected */
+    const float *QSignal; /**< The modulation vector of the q factor, NULL if not connected */
+    const float *mixSignal; /**< The modulation vector of the mix, NULL if not connected */
+    float lastF0Signal; /**< The last value read from f0Signal */
+    float lastQSignal; /**< The last value read from QSignal */
+    float lastMixSignal; /**< The last value read from mixSignal */
+    struct biquad_allpass_bank *bank; /**< The filter bank holding all allpass stages */
+    float *frames; /**< Interleaved buffer for multichannel processing */
+    float *tap; /**< Output of the shorter cascade during a crossfade, same size as frames */
+    float *dry; /**< The input kept for the global mix when the cascade filters in place, same size as frames */
+    int framesSize; /**< The amount of frames the interleaved buffer can hold */
+    void *framesMemory; /**< The aligned memory block of the interleaved buffer, the tap and the dry input */
+    int engine; /**< The phase_shaper_meta_engine state */
+    volatile int engineState; /**< The phase_shaper_meta_engineState of the convolver and its buffers */
+    int enginePosition; /**< The progress of priming or of a crossfade between the engines in samples */
+    int staticSamples; /**< The amount of samples the parameters have been static */
+    int silent; /**< 1 while silent input bypasses the cleared cascade */
+    int cacheBlock; /**< The amount of frames every stage filters per pass of the cascade */
+    int calibratedCacheBlock; /**< The pass size of the channel layout when the object was created */
+    int mixMode; /**< The phase_shaper_meta_mixMode the stages are set up for */
+    struct phase_shaper_convolver *convolver; /**< The convolution engine, NULL while the filter count is below PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS */
+    struct biquad_allpass_bank *renderBank; /**< A single channel copy of the cascade rendering the impulse response */
+    float *impulse; /**< The rendered impulse response */
+    int renderPosition; /**< The amount of samples of the impulse response rendered so far */
+    int impulseLength; /**< The length of the impulse response of impulseParameters, 0 if convolving does not pay off, -1 while unknown */
+    phase_shaper_meta_parameters impulseParameters; /**< The parameters of the rendered impulse response */
+    float *history; /**< The input kept while the convolution runs, interleaved like frames */
+    int historySize; /**< The amount of frames history can hold */
+    int historyPosition; /**< The frame history is written to next */
+    int replayPending; /**< The amount of kept frames the cascade has not processed yet */
+    phase_shaper_meta_parameters control; /**< The parameters as set by the control thread */
+    phase_shaper_meta_parameters applied; /**< The parameters the audio thread works with */
+    phase_shaper_meta_parameters slots[3]; /**< The triple buffer between control and audio thread */
+    int writeSlot; /**< The slot the control thread fills next */
+    int readSlot; /**< The slot the audio thread read last */
+    volatile int sharedSlot; /**< The slot in between, PHASE_SHAPER_META_FRESH is set if it holds unread parameters */
+#ifdef PHASE_SHAPER_STATS
+    phase_shaper_stats stats; /**< The performance counters, only with PHASE_SHAPER_STATS */
+#endif
 } phase_shaper_meta;
 
+/**
+ * @brief Flag of sharedSlot, set while the shared slot holds parameters the audio thread has not seen <br>
+ */
+#define PHASE_SHAPER_META_FRESH 4
+
 /**
  * @related phase_shaper_meta
  * @brief Creates a new phase_shaper_meta object <br>
@@ -40,8 +252,29 @@ typedef struct phase_shaper_meta{
  * @param Q The filters q factor parameter <br>
  * @param nFilters the amount of allpass filters <br>
  * @param mix The filters dry-wet mix parameter <br>
+ * @param sampleRate The sample rate in Hz <br>
+ *
+ * The stage pool reserves PHASE_SHAPER_META_MAX_FILTERS stages, or nFilters if that is larger, phase_shaper_meta_setMaxFilters grows it. <br>
  */
-phase_shaper_meta *phase_shaper_meta_new(float f0, float Q, float nFilters, float mix);
+phase_shaper_meta *phase_shaper_meta_new(float f0, float Q, float nFilters, float mix, float sampleRate);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Creates a new phase_shaper_meta object for several channels <br>
+ * @returns an instance of the phase_shaper_meta object <br>
+ * @param f0 The filters center frequency parameter <br>
+ * @param Q The filters q factor parameter <br>
+ * @param nFilters the amount of allpass filters <br>
+ * @param mix The filters dry-wet mix parameter <br>
+ * @param nChannels the amount of channels <br>
+ * @param maxFilters the size of the stage pool, values below 1 select PHASE_SHAPER_META_MAX_FILTERS <br>
+ * @param sampleRate The sample rate in Hz <br>
+ *
+ * All channels share the parameters, coefficients are calculated once for all of them. <br>
+ * All stages up to maxFilters are allocated here, so changing the filter count within the pool never allocates. <br>
+ * A larger filter count, or the first one to reach PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS, needs phase_shaper_meta_prepare first. <br>
+ */
+phase_shaper_meta *phase_shaper_meta_newMultichannel(float f0, float Q, float nFilters, float mix, int nChannels, int maxFilters, float sampleRate);
 
 /**
  * @related phase_shaper_meta
@@ -55,6 +288,9 @@ void phase_shaper_meta_free(phase_shaper_meta *x);
  * @brief Sets the frequency adjustment parameter. <br>
  * @param x A pointer to the phase_shaper_meta object <br>
  * @param f0 Sets the frequency parameter <br>
+ *
+ * The frequency is ramped to the new value within the ramp time, the same applies to setQ and setMix. <br>
+ * Like all setters it only publishes the change, the audio thread applies it at the start of its next vector. <br>
  */
 void phase_shaper_meta_setFrequency(phase_shaper_meta *x, float f0);
 
@@ -74,24 +310,214 @@ void phase_shaper_meta_setQ(phase_shaper_meta *x, float Q);
  */
 void phase_shaper_meta_setMix(phase_shaper_meta *x, float mix);
 
+/**
+ * @related phase_shaper_meta
+ * @brief Selects where the dry wet mix is applied. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param mixMode A phase_shaper_meta_mixMode, PHASE_SHAPER_META_MIX_STAGES by default <br>
+ *
+ * In PHASE_SHAPER_META_MIX_GLOBAL a mix below 1 costs one multiply-add per sample instead of two multiplies and an add per stage,
+ * and a mix of 1 nothing at all. The mix is clamped to 0 - 1, while the stages ignore values outside. <br>
+ * Both modes give the same output for a mix of 1. The switch is not crossfaded, the stages keep their states. <br>
+ */
+void phase_shaper_meta_setMixMode(phase_shaper_meta *x, int mixMode);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Returns the mix applied at the output of the cascade. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @returns The current mix clamped to 0 - 1 in PHASE_SHAPER_META_MIX_GLOBAL, 1 if the stages mix <br>
+ *
+ * Must be called from the audio thread. <br>
+ */
+float phase_shaper_meta_outputMix(phase_shaper_meta *x);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Spreads the center frequencies of the stages across a range around f0. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param octaves The width of the range in octaves, 0 places every stage at f0 <br>
+ *
+ * Stages are clamped below the Nyquist frequency. A few spread stages give the dispersion of many more stages at f0. <br>
+ */
+void phase_shaper_meta_setSpread(phase_shaper_meta *x, float octaves);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Sets the distribution of the spread stages. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param curve 1 spaces the stages evenly in octaves, values above 1 gather them around f0, values below 1 push them to the edges <br>
+ *
+ * Unlike the spread the curve is applied without a ramp. <br>
+ */
+void phase_shaper_meta_setCurve(phase_shaper_meta *x, float curve);
+
 /**
  * @related phase_shaper_meta
  * @brief Sets the filter count parameter. <br>
  * @param x A pointer to the phase_shaper_meta object <br>
- * @param nFilters Sets amount of Filters <br>
+ * @param nFilters Sets amount of Filters, clamped to 1 - maxFilters <br>
+ *
+ * Takes constant time. Stages are taken from and returned to the reserved pool, which phase_shaper_meta_prepare grows beforehand, <br>
+ * the output crossfades from the old to the new cascade within PHASE_SHAPER_META_FADE_TIME. <br>
  */
 void phase_shaper_meta_setFilterCount(phase_shaper_meta *x, float nFilters);
 
+/**
+ * @related phase_shaper_meta
+ * @brief Grows the stage pool. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param maxFilters The new size of the pool, clamped to PHASE_SHAPER_META_FILTER_LIMIT, a smaller pool is kept <br>
+ *
+ * The active stages keep their coefficients and states. <br>
+ * Like reserve it allocates and must not be called while the audio thread is processing (Pd calls it from a message method). <br>
+ */
+void phase_shaper_meta_setMaxFilters(phase_shaper_meta *x, int maxFilters);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Allocates what a filter count needs before phase_shaper_meta_setFilterCount. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param nFilters The coming filter count <br>
+ *
+ * Grows the stage pool and creates the convolution engine from PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS on. <br>
+ * Below it the engine is retired: the audio thread catches up and fades back to the cascade as for any parameter change,
+ * and a later call frees the engine once the audio thread has let go of it. A count reaching the minimum again takes it back. <br>
+ * The same thread rules as for phase_shaper_meta_setMaxFilters apply to growing the pool. <br>
+ */
+void phase_shaper_meta_prepare(phase_shaper_meta *x, float nFilters);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Sets the ramp time of parameter changes. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param milliseconds The ramp time, 0 applies changes at the next sub-block <br>
+ */
+void phase_shaper_meta_setRampTime(phase_shaper_meta *x, float milliseconds);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Sets the sample rate, e.g. from the dsp method after a restart of the audio. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param sampleRate The sample rate in Hz <br>
+ *
+ * Coefficients, ramps and crossfades are recalculated before the next block is processed, <br>
+ * the filter states are kept. Repeating the current rate costs nothing. <br>
+ */
+void phase_shaper_meta_setSampleRate(phase_shaper_meta *x, float sampleRate);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Connects audio rate modulation vectors. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param f0 A vector of center frequencies or NULL <br>
+ * @param Q A vector of q factors or NULL <br>
+ * @param mix A vector of dry-wet mix values or NULL <br>
+ *
+ * The vectors have to hold the vectorSize samples of every following process call, e.g. the signal inlets of a Pd object. <br>
+ * Each vector is read once per sub-block. A value which differs from the last one read is applied right away and cancels a running ramp, <br>
+ * a message changes the parameter again, so the latest change wins. <br>
+ * The vectors are read before any output is written, they may share memory with the outputs. <br>
+ * Unlike the setters this is not published, it must not be called while the audio thread is processing (Pd calls it from the dsp method). <br>
+ */
+void phase_shaper_meta_setModulation(phase_shaper_meta *x, const float *f0, const float *Q, const float *mix);
+
 /**
  * @related phase_shaper_meta
  * @brief Updates filter parameters for each filter instance <br>
  * @param x A pointer to the phase_shaper_meta object <br>
  *
- * Propagates filter parameters of the meta instance to each filter instance. <br>
- * This is done by traversing through a linked list of filter instances and using the biquad_allpass setter methods for each instance.
+ * Propagates filter parameters of the meta instance to each filter stage. <br>
+ * The coefficients are calculated once for the current parameters and copied to every active stage of the filter bank. <br>
+ * Called by the audio thread only. <br>
  */
 void phase_shaper_meta_updateAllpassInstances(phase_shaper_meta *x);
 
+/**
+ * @related phase_shaper_meta
+ * @brief Selects the processing backend of the filter bank. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param backend A biquad_allpass_backend, BIQUAD_ALLPASS_BACKEND_AUTO picks the fastest one the cpu supports <br>
+ *
+ * The backend is detected automatically on creation, forcing one is meant for testing and benchmarking. <br>
+ */
+void phase_shaper_meta_setBackend(phase_shaper_meta *x, int backend);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Selects how cos and sin of the coefficients are evaluated. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param trigMode A biquad_allpass_trig mode, BIQUAD_ALLPASS_TRIG_POLYNOMIAL avoids the C library calls <br>
+ */
+void phase_shaper_meta_setTrigMode(phase_shaper_meta *x, int trigMode);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Selects the filter structure of the cascade. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param form A biquad_allpass_form, BIQUAD_ALLPASS_FORM_DF1 by default <br>
+ *
+ * The transposed direct form II keeps two states per stage, in double precision it stays stable and quiet
+ * for low frequencies with high q factors at high sample rates. Both run on the scalar loop. <br>
+ * Meant to be called right after creation: the states are cleared and the double precision form allocates. <br>
+ * Like reserve it must not be called while the audio thread is processing. <br>
+ */
+void phase_shaper_meta_setForm(phase_shaper_meta *x, int form);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Selects when the convolution engine replaces the recursive cascade. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param convolution A phase_shaper_meta_convolution mode, PHASE_SHAPER_META_CONVOLUTION_AUTO by default <br>
+ *
+ * Has no effect while the engine does not exist: it is created by the constructor or phase_shaper_meta_prepare for filter counts
+ * of at least PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS, whatever the size of the stage pool. <br>
+ */
+void phase_shaper_meta_setConvolution(phase_shaper_meta *x, int convolution);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Sets the amount of frames every stage filters per pass of the cascade. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param frames The pass size, 0 selects the size calibrated for the channel layout (default) <br>
+ *
+ * The output does not depend on the pass size. Small passes keep the buffer in the L1 cache,
+ * large ones spend less time filling and draining the SIMD pipeline. <br>
+ */
+void phase_shaper_meta_setCacheBlock(phase_shaper_meta *x, int frames);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Returns the pass size calibrated for a channel layout. <br>
+ * @param nChannels The amount of channels <br>
+ * @returns The pass size in frames <br>
+ *
+ * The first call for a channel layout times the cascade with pass sizes from PHASE_SHAPER_META_MIN_CACHE_BLOCK
+ * to PHASE_SHAPER_META_MAX_CACHE_BLOCK, which takes a few milliseconds. Later calls return the stored result. <br>
+ */
+int phase_shaper_meta_calibratedCacheBlock(int nChannels);
+
+/**
+ * @brief Replaces the calibration by a fixed pass size. <br>
+ * @param frames The pass size for every channel layout, clamped to PHASE_SHAPER_META_MIN_CACHE_BLOCK - PHASE_SHAPER_META_MAX_CACHE_BLOCK,
+ * 0 returns to the calibration <br>
+ *
+ * Only affects objects created afterwards. Tools whose runs have to be reproducible call it before creating any object,
+ * the calibration depends on the load of the machine. <br>
+ */
+void phase_shaper_meta_pinCacheBlock(int frames);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Allocates the scratch buffers for a vector size. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param vectorSize The largest vector size the following process calls use <br>
+ *
+ * The process functions grow the buffers on demand, calling this beforehand keeps allocations off the audio thread. <br>
+ * Must not be called while the audio thread is processing (Pd calls it from the dsp method). <br>
+ */
+void phase_shaper_meta_reserve(phase_shaper_meta *x, int vectorSize);
+
 /**
  * @related phase_shaper_meta
  * @brief Process the incoming audio <br>
@@ -100,11 +526,59 @@ void phase_shaper_meta_updateAllpassInstances(phase_shaper_meta *x);
  * @param out A pointer to audio output vector <br>
  * @param vectorSize Size of the audio buffer <br>
  *
- * for each filter the biquad_allpass filter method gets called. <br>
- * This is done in a serial manner, meaning the filtered output of the last filter is used as input for the next filter. <br>
+ * The filter bank processes every stage in a serial manner, meaning the filtered output of the last filter is used as input for the next filter. <br>
+ * Only valid for single channel instances, use phase_shaper_meta_processMultichannel for multichannel instances. <br>
+ * in and out may be the same vector, every stage reads a frame before writing it, so the vector is filtered in place. <br>
+ * If they overlap at an offset, the input is copied to the scratch buffer of phase_shaper_meta_reserve first. <br>
  */
 void phase_shaper_meta_process(phase_shaper_meta *x, float *in, float *out, int vectorSize);
 
+/**
+ * @related phase_shaper_meta
+ * @brief Process the incoming audio of all channels <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param in An array of nChannels audio input vectors <br>
+ * @param out An array of nChannels audio output vectors <br>
+ * @param vectorSize Size of the audio buffers <br>
+ *
+ * The channels are interleaved, so the filter bank processes one channel per SIMD lane. <br>
+ * All inputs are read before any output is written, input and output vectors may share memory in any combination. <br>
+ */
+void phase_shaper_meta_processMultichannel(phase_shaper_meta *x, float **in, float **out, int vectorSize);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Checks if the next vector runs nothing but the cascade with the current coefficients <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @returns 1 for a single channel instance in direct form I without pending parameters, ramps, modulation vectors or a filter count fade,
+ * for which the convolution engine is off or has been ruled out for the current parameters, 0 otherwise <br>
+ *
+ * The states of a steady instance may be filtered elsewhere, e.g. as a lane of a phase_shaper_batch, the output stays the same. <br>
+ * Must be called from the audio thread. <br>
+ */
+int phase_shaper_meta_steady(phase_shaper_meta *x);
+
+#ifdef PHASE_SHAPER_STATS
+
+/**
+ * @related phase_shaper_meta
+ * @brief Copies the performance counters, only with PHASE_SHAPER_STATS. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ * @param stats Receives the counters since creation or the last reset <br>
+ */
+void phase_shaper_meta_getStats(phase_shaper_meta *x, phase_shaper_stats *stats);
+
+/**
+ * @related phase_shaper_meta
+ * @brief Sets all performance counters to zero, only with PHASE_SHAPER_STATS. <br>
+ * @param x A pointer to the phase_shaper_meta object <br>
+ *
+ * Like setModulation, this must not be called while the audio thread is processing. In Pd both run on the same thread. <br>
+ */
+void phase_shaper_meta_resetStats(phase_shaper_meta *x);
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
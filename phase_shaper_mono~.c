@@ -8,11 +8,17 @@
  * The induced phase shift creates an audible delay at the filters center frequency.<br>
  * This can be used to transform audio material in various ways e.g. enhancing a kickdrum's fundamental frequency.<br>
  * The dry-wet mix parameter can additionally be used to create phase cancellations which can drastically filter incoming audio.<br>
+ * Frequency, Q and mix can be modulated at audio rate through the right signal inlets, messages are ramped.<br>
+ * The spread message places the stages across a range of octaves around the frequency, the curve message shapes their distribution.<br>
+ * globalmix 1 runs the stages fully wet and mixes the dry signal in once at the output, globalmix 0 returns to the mix inside every stage.<br>
+ * An optional second creation argument selects the filter structure, df1, tdf2 or tdf2double, e.g. [phase_shaper_mono~ 128 tdf2double].<br>
+ * The stats message sends the performance counters to the rightmost outlet, if the object was built with make stats=yes.<br>
  */
 
 #include "m_pd.h"
 #include "biquad_allpass.h"
 #include "phase_shaper_meta.h"
+#include "biquad_allpass_bank.h"
 #include "vas_mem.h"
 
 static t_class *phase_shaper_mono_tilde_class;
@@ -25,7 +31,11 @@ typedef struct phase_shaper_mono_tilde{
     t_object  x_obj; /**< Necessary for every signal object in Pure Data */
     t_sample f; /**< Necessary for signal objects, float dummy dataspace for converting a float to signal if no signal is connected (CLASS_MAINSIGNALIN) */
     phase_shaper_meta *p_meta; /**< The the phase shaper meta object for actual signal processing */
+    t_inlet *f0_inlet; /**< A signal inlet modulating the frequency */
+    t_inlet *Q_inlet; /**< A signal inlet modulating the q factor */
+    t_inlet *mix_inlet; /**< A signal inlet modulating the dry-wet mix */
     t_outlet *x_out; /**< A signal outlet for the filtered signal */
+    t_outlet *info_outlet; /**< A message outlet for the performance counters */
 } phase_shaper_mono_tilde;
 
 /**
@@ -33,6 +43,9 @@ typedef struct phase_shaper_mono_tilde{
  * @brief Calculates ta allpass filtered output vector<br>
  * @param w A pointer to the object, input and output vectors. <br>
  * The function calls the phase_shaper_meta_process method. <br>
+ * Pd may hand the same memory to the inlet and the outlet, the vector is then filtered in place. <br>
+ * phase_shaper_meta_process detects the aliasing, only input which overlaps the output at an offset goes through its scratch buffer. <br>
+ * The modulation inlets are read before the output is written, so they may share memory with it too. <br>
  * @return A pointer to the signal chain right behind the phase_shaper_mono_tilde_perform object. <br>
  */
 t_int *phase_shaper_mono_tilde_perform(t_int *w)
@@ -50,12 +63,16 @@ t_int *phase_shaper_mono_tilde_perform(t_int *w)
 /**
  * @related phase_shaper_mono_tilde
  * @brief Adds phase_shaper_mono_tilde_perform to the signal chain. <br>
+ * Forwards the sample rate of the signal chain, so a restart at another rate recalculates the coefficients. <br>
  * @param x A pointer to the rtap_biquad_tilde object <br>
  * @param sp A pointer to the input and output vectors <br>
  */
 void phase_shaper_mono_tilde_dsp(phase_shaper_mono_tilde *x, t_signal **sp)
 {
-    dsp_add(phase_shaper_mono_tilde_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
+    phase_shaper_meta_setSampleRate(x->p_meta, sp[0]->s_sr);
+    phase_shaper_meta_reserve(x->p_meta, sp[0]->s_n);
+    phase_shaper_meta_setModulation(x->p_meta, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec);
+    dsp_add(phase_shaper_mono_tilde_perform, 4, x, sp[0]->s_vec, sp[4]->s_vec, sp[0]->s_n);
 }
 
 /**
@@ -64,20 +81,38 @@ void phase_shaper_mono_tilde_dsp(phase_shaper_mono_tilde *x, t_signal **sp)
  * @param x A pointer the phase_shaper_mono_tilde object <br>
  */
 void phase_shaper_mono_tilde_free(phase_shaper_mono_tilde *x){
+    inlet_free(x->f0_inlet);
+    inlet_free(x->Q_inlet);
+    inlet_free(x->mix_inlet);
     outlet_free(x->x_out);
+    outlet_free(x->info_outlet);
     phase_shaper_meta_free(x->p_meta);
 }
 
 /**
  * @related phase_shaper_mono_tilde
  * @brief Creates a new phase_shaper_mono_tilde object <br>
+ * @param form The filter structure df1, tdf2 or tdf2double, defaults to df1 <br>
+ * @param maxFilters The amount of stages reserved up front, defaults to PHASE_SHAPER_META_MAX_FILTERS, the pool grows on demand <br>
+ * Pd passes symbol arguments before float arguments, whatever their order in the class. <br>
  * @returns an instance of the phase_shaper_mono_tilde object <br>
  */
-void *phase_shaper_mono_tilde_new(){
+void *phase_shaper_mono_tilde_new(t_symbol *form, t_floatarg maxFilters){
     phase_shaper_mono_tilde *x = (phase_shaper_mono_tilde *)pd_new(phase_shaper_mono_tilde_class);
 
+    x->f0_inlet = signalinlet_new(&x->x_obj, 1000);
+    x->Q_inlet = signalinlet_new(&x->x_obj, 10);
+    x->mix_inlet = signalinlet_new(&x->x_obj, 1);
     x->x_out = outlet_new(&x->x_obj, &s_signal);
-    x->p_meta = phase_shaper_meta_new(1000, 10, 1, 1);
+    x->info_outlet = outlet_new(&x->x_obj, 0);
+    x->p_meta = phase_shaper_meta_newMultichannel(1000, 10, 1, 1, 1, (int) maxFilters, sys_getsr());
+
+    if (form == gensym("tdf2"))
+        phase_shaper_meta_setForm(x->p_meta, BIQUAD_ALLPASS_FORM_TDF2);
+    else if (form == gensym("tdf2double"))
+        phase_shaper_meta_setForm(x->p_meta, BIQUAD_ALLPASS_FORM_TDF2_DOUBLE);
+    else if (form != &s_ && form != gensym("df1"))
+        pd_error(x, "phase_shaper_mono~: unknown filter structure %s, using df1", form->s_name);
 
     return (void *)x;
 }
@@ -106,9 +141,13 @@ void phase_shaper_mono_tilde_setQ(phase_shaper_mono_tilde *x, float Q){
  * @related phase_shaper_mono_tilde
  * @brief Sets the filter count parameter. <br>
  * @param x A pointer to the phase_shaper_mono_tilde object <br>
+ * The stage pool grows on demand, counts outside 1 - PHASE_SHAPER_META_FILTER_LIMIT are clamped. <br>
  * @param nFilters Sets amount of Filters <br>
  */
 void phase_shaper_mono_tilde_setFilterCount(phase_shaper_mono_tilde *x, float nFilters){
+    if (nFilters < 1 || nFilters > PHASE_SHAPER_META_FILTER_LIMIT)
+        pd_error(x, "phase_shaper_mono~: filtercount %g clamped to 1 - %d", nFilters, PHASE_SHAPER_META_FILTER_LIMIT);
+    phase_shaper_meta_prepare(x->p_meta, nFilters);
     phase_shaper_meta_setFilterCount(x->p_meta, nFilters);
 }
 
@@ -122,6 +161,112 @@ void phase_shaper_mono_tilde_setMix(phase_shaper_mono_tilde *x, float mix){
     phase_shaper_meta_setMix(x->p_meta, mix);
 }
 
+/**
+ * @related phase_shaper_mono_tilde
+ * @brief Sets the spread parameter. <br>
+ * @param x A pointer to the phase_shaper_mono_tilde object <br>
+ * @param octaves Sets the width of the frequency range of the stages in octaves <br>
+ */
+void phase_shaper_mono_tilde_setSpread(phase_shaper_mono_tilde *x, float octaves){
+  phase_shaper_meta_setSpread(x->p_meta, octaves);
+}
+
+/**
+ * @related phase_shaper_mono_tilde
+ * @brief Sets the distribution of the spread stages. <br>
+ * @param x A pointer to the phase_shaper_mono_tilde object <br>
+ * @param curve 1 spaces the stages evenly in octaves, above 1 gathers them around the frequency <br>
+ */
+void phase_shaper_mono_tilde_setCurve(phase_shaper_mono_tilde *x, float curve){
+  phase_shaper_meta_setCurve(x->p_meta, curve);
+}
+
+/**
+ * @related phase_shaper_mono_tilde
+ * @brief Selects where the dry-wet mix is applied. <br>
+ * @param x A pointer to the phase_shaper_mono_tilde object <br>
+ * @param global 1 mixes once at the output, 0 mixes inside every stage (default) <br>
+ */
+void phase_shaper_mono_tilde_setMixMode(phase_shaper_mono_tilde *x, float global){
+  phase_shaper_meta_setMixMode(x->p_meta, global != 0 ? PHASE_SHAPER_META_MIX_GLOBAL : PHASE_SHAPER_META_MIX_STAGES);
+}
+
+/**
+ * @related phase_shaper_mono_tilde
+ * @brief Sets the ramp time of the frequency, Q and mix messages. <br>
+ * @param x A pointer to the phase_shaper_mono_tilde object <br>
+ * @param ms Sets the ramp time in milliseconds <br>
+ */
+void phase_shaper_mono_tilde_setRampTime(phase_shaper_mono_tilde *x, float ms){
+    phase_shaper_meta_setRampTime(x->p_meta, ms);
+}
+
+/**
+ * @related phase_shaper_mono_tilde
+ * @brief Sends the performance counters to the info outlet and resets them. <br>
+ * @param x A pointer to the phase_shaper_mono_tilde object <br>
+ *
+ * Every counter is sent as a message of its name and value, times are in the unit sent first. <br>
+ * The memory counters are the bytes in use, their peak and the bytes reserved of the arena shared by all objects. <br>
+ * Without PHASE_SHAPER_STATS the counters do not exist and an error is posted. <br>
+ */
+void phase_shaper_mono_tilde_stats(phase_shaper_mono_tilde *x){
+#ifdef PHASE_SHAPER_STATS
+    phase_shaper_stats stats;
+    vas_mem_stats memory;
+    t_atom value;
+
+    phase_shaper_meta_getStats(x->p_meta, &stats);
+    phase_shaper_meta_resetStats(x->p_meta);
+
+    SETSYMBOL(&value, gensym(PHASE_SHAPER_STATS_UNIT));
+    outlet_anything(x->info_outlet, gensym("unit"), 1, &value);
+
+    SETFLOAT(&value, (t_float) stats.vectors);
+    outlet_anything(x->info_outlet, gensym("vectors"), 1, &value);
+
+    SETFLOAT(&value, stats.vectors ? (t_float) stats.time / stats.vectors : 0);
+    outlet_anything(x->info_outlet, gensym("vector_time"), 1, &value);
+
+    SETFLOAT(&value, (t_float) stats.worstTime);
+    outlet_anything(x->info_outlet, gensym("worst_vector_time"), 1, &value);
+
+    SETFLOAT(&value, stats.stageFrames ? (t_float) stats.cascadeTime / stats.stageFrames : 0);
+    outlet_anything(x->info_outlet, gensym("stage_time"), 1, &value);
+
+    SETFLOAT(&value, (t_float) stats.coefficientUpdates);
+    outlet_anything(x->info_outlet, gensym("coefficient_updates"), 1, &value);
+
+    SETFLOAT(&value, stats.coefficientUpdates ? (t_float) stats.coefficientTime / stats.coefficientUpdates : 0);
+    outlet_anything(x->info_outlet, gensym("coefficient_time"), 1, &value);
+
+    SETFLOAT(&value, (t_float) stats.parameterMessages);
+    outlet_anything(x->info_outlet, gensym("parameter_messages"), 1, &value);
+
+    SETFLOAT(&value, (t_float) stats.coalescedMessages);
+    outlet_anything(x->info_outlet, gensym("coalesced_messages"), 1, &value);
+
+    SETFLOAT(&value, (t_float) stats.allocations);
+    outlet_anything(x->info_outlet, gensym("allocations"), 1, &value);
+
+    SETFLOAT(&value, (t_float) stats.bypassedVectors);
+    outlet_anything(x->info_outlet, gensym("bypassed_vectors"), 1, &value);
+
+    vas_mem_getStats(&memory);
+
+    SETFLOAT(&value, (t_float) memory.bytesInUse);
+    outlet_anything(x->info_outlet, gensym("memory_in_use"), 1, &value);
+
+    SETFLOAT(&value, (t_float) memory.peakBytesInUse);
+    outlet_anything(x->info_outlet, gensym("memory_peak"), 1, &value);
+
+    SETFLOAT(&value, (t_float) memory.bytesReserved);
+    outlet_anything(x->info_outlet, gensym("memory_reserved"), 1, &value);
+#else
+    pd_error(x, "phase_shaper_mono~: built without performance counters, rebuild with make stats=yes");
+#endif
+}
+
 /**
  * @related phase_shaper_mono_tilde
  * @brief Setup for the phase_shaper_mono_tilde class <br>
@@ -132,7 +277,7 @@ void phase_shaper_mono_tilde_setup(void){
             (t_method)phase_shaper_mono_tilde_free,
             sizeof(phase_shaper_mono_tilde),
             CLASS_DEFAULT,
-            A_DEFFLOAT, 0);
+            A_DEFFLOAT, A_DEFSYM, 0);
 
       class_addmethod(phase_shaper_mono_tilde_class, (t_method)phase_shaper_mono_tilde_dsp, gensym("dsp"), 0);
 
@@ -144,5 +289,15 @@ void phase_shaper_mono_tilde_setup(void){
 
       class_addmethod(phase_shaper_mono_tilde_class, (t_method)phase_shaper_mono_tilde_setMix, gensym("mix"), A_DEFFLOAT, 0);
 
+      class_addmethod(phase_shaper_mono_tilde_class, (t_method)phase_shaper_mono_tilde_setSpread, gensym("spread"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_mono_tilde_class, (t_method)phase_shaper_mono_tilde_setCurve, gensym("curve"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_mono_tilde_class, (t_method)phase_shaper_mono_tilde_setMixMode, gensym("globalmix"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_mono_tilde_class, (t_method)phase_shaper_mono_tilde_setRampTime, gensym("smooth"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_mono_tilde_class, (t_method)phase_shaper_mono_tilde_stats, gensym("stats"), 0);
+
       CLASS_MAINSIGNALIN(phase_shaper_mono_tilde_class, phase_shaper_mono_tilde, f);
 }
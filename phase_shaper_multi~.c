@@ -0,0 +1,237 @@
+/**
+ * @file "phase_shaper_multi~.c"
+ * @author Arne Kuhle <br>
+ * @brief A Pure Data object for filtering several incoming signals with a series of allpass filters.<br>
+ *
+ * phase_shaper~ is a sound design tool. Multichannel Version (1 to 16 Channels).<br>
+ * The amount of channels is set by the first creation argument, e.g. [phase_shaper_multi~ 8] for a 7.1 bus.<br>
+ * The optional second argument sets the amount of stages reserved up front, the pool grows on demand.<br>
+ * All channels share one set of parameters, the coefficients are calculated once for all of them.<br>
+ * The channels are processed in parallel, one SIMD lane per channel.<br>
+ * The spread message places the stages across a range of octaves around the frequency, the curve message shapes their distribution.<br>
+ * globalmix 1 runs the stages fully wet and mixes the dry signal in once at the output, globalmix 0 returns to the mix inside every stage.<br>
+ */
+
+#include "m_pd.h"
+#include "phase_shaper_meta.h"
+#include "vas_mem.h"
+
+/**
+ * @brief The maximum amount of channels of a phase_shaper_multi~ object <br>
+ */
+#define PHASE_SHAPER_MULTI_MAX_CHANNELS 16
+
+static t_class *phase_shaper_multi_tilde_class;
+
+/**
+ * @struct phase_shaper_multi_tilde
+ * @brief The Pure Data struct of the phase_shaper_multi~ object. <br>
+ */
+typedef struct phase_shaper_multi_tilde{
+    t_object  x_obj; /**< Necessary for every signal object in Pure Data */
+    t_sample f; /**< Necessary for signal objects, float dummy dataspace for converting a float to signal if no signal is connected (CLASS_MAINSIGNALIN) */
+
+    int nChannels; /**< The amount of channels */
+    phase_shaper_meta *p_meta; /**< The the phase shaper meta object for signal processing on all channels */
+
+    t_inlet *inlets[PHASE_SHAPER_MULTI_MAX_CHANNELS]; /**< additional signal inlets, the first channel uses the main inlet */
+    t_outlet *outlets[PHASE_SHAPER_MULTI_MAX_CHANNELS]; /**< A signal outlet for each filtered channel */
+
+    t_sample *in[PHASE_SHAPER_MULTI_MAX_CHANNELS]; /**< The input vectors of the current DSP cycle */
+    t_sample *out[PHASE_SHAPER_MULTI_MAX_CHANNELS]; /**< The output vectors of the current DSP cycle */
+} phase_shaper_multi_tilde;
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Calculates the allpass filtered output vectors<br>
+ * @param w A pointer to the object and the vector size. <br>
+ * The function calls the phase_shaper_meta_processMultichannel method. <br>
+ * @return A pointer to the signal chain right behind the phase_shaper_multi_tilde_perform object. <br>
+ */
+t_int *phase_shaper_multi_tilde_perform(t_int *w)
+{
+    phase_shaper_multi_tilde *x = (phase_shaper_multi_tilde *)(w[1]);
+    int n = (int)(w[2]);
+
+    phase_shaper_meta_processMultichannel(x->p_meta, x->in, x->out, n);
+
+    return (w+3);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Adds phase_shaper_multi_tilde_perform to the signal chain. <br>
+ * Forwards the sample rate of the signal chain, so a restart at another rate recalculates the coefficients. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param sp A pointer to the input and output vectors <br>
+ */
+void phase_shaper_multi_tilde_dsp(phase_shaper_multi_tilde *x, t_signal **sp)
+{
+    for (int c = 0; c < x->nChannels; c++) {
+        x->in[c] = sp[c]->s_vec;
+        x->out[c] = sp[x->nChannels + c]->s_vec;
+    }
+
+    phase_shaper_meta_setSampleRate(x->p_meta, sp[0]->s_sr);
+    phase_shaper_meta_reserve(x->p_meta, sp[0]->s_n);
+    dsp_add(phase_shaper_multi_tilde_perform, 2, x, sp[0]->s_n);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Frees the phase_shaper_meta object. <br>
+ * @param x A pointer the phase_shaper_multi_tilde object <br>
+ */
+void phase_shaper_multi_tilde_free(phase_shaper_multi_tilde *x){
+    for (int c = 1; c < x->nChannels; c++)
+        inlet_free(x->inlets[c]);
+
+    for (int c = 0; c < x->nChannels; c++)
+        outlet_free(x->outlets[c]);
+
+    phase_shaper_meta_free(x->p_meta);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Creates a new phase_shaper_multi_tilde object <br>
+ * @param channels The amount of channels (1 - 16), defaults to 2 <br>
+ * @param maxFilters The amount of stages reserved up front, defaults to PHASE_SHAPER_META_MAX_FILTERS, the pool grows on demand <br>
+ * @returns an instance of the phase_shaper_multi_tilde object <br>
+ */
+void *phase_shaper_multi_tilde_new(t_floatarg channels, t_floatarg maxFilters){
+    phase_shaper_multi_tilde *x = (phase_shaper_multi_tilde *)pd_new(phase_shaper_multi_tilde_class);
+
+    x->nChannels = (int) channels;
+    if (x->nChannels < 1)
+        x->nChannels = 2;
+    if (x->nChannels > PHASE_SHAPER_MULTI_MAX_CHANNELS)
+        x->nChannels = PHASE_SHAPER_MULTI_MAX_CHANNELS;
+
+    for (int c = 1; c < x->nChannels; c++)
+        x->inlets[c] = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+
+    for (int c = 0; c < x->nChannels; c++)
+        x->outlets[c] = outlet_new(&x->x_obj, &s_signal);
+
+    x->p_meta = phase_shaper_meta_newMultichannel(1000, 10, 1, 1, x->nChannels, (int) maxFilters, sys_getsr());
+
+    return (void *)x;
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Sets the frequency adjustment parameter. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param freq Sets the frequency parameter <br>
+ */
+void phase_shaper_multi_tilde_setFrequency(phase_shaper_multi_tilde *x, float freq){
+    phase_shaper_meta_setFrequency(x->p_meta, freq);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Sets the Q factor adjustment parameter. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param Q Sets the q factor parameter <br>
+ */
+void phase_shaper_multi_tilde_setQ(phase_shaper_multi_tilde *x, float Q){
+    phase_shaper_meta_setQ(x->p_meta, Q);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Sets the filter count parameter. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * The stage pool grows on demand, counts outside 1 - PHASE_SHAPER_META_FILTER_LIMIT are clamped. <br>
+ * @param nFilters Sets amount of Filters <br>
+ */
+void phase_shaper_multi_tilde_setFilterCount(phase_shaper_multi_tilde *x, float nFilters){
+    if (nFilters < 1 || nFilters > PHASE_SHAPER_META_FILTER_LIMIT)
+        pd_error(x, "phase_shaper_multi~: filtercount %g clamped to 1 - %d", nFilters, PHASE_SHAPER_META_FILTER_LIMIT);
+    phase_shaper_meta_prepare(x->p_meta, nFilters);
+    phase_shaper_meta_setFilterCount(x->p_meta, nFilters);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Sets the Dry-Wet Mix adjustment parameter. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param mix Sets the Dry-Wet Mix parameter <br>
+ */
+void phase_shaper_multi_tilde_setMix(phase_shaper_multi_tilde *x, float mix){
+    phase_shaper_meta_setMix(x->p_meta, mix);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Sets the spread parameter. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param octaves Sets the width of the frequency range of the stages in octaves <br>
+ */
+void phase_shaper_multi_tilde_setSpread(phase_shaper_multi_tilde *x, float octaves){
+    phase_shaper_meta_setSpread(x->p_meta, octaves);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Sets the distribution of the spread stages. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param curve 1 spaces the stages evenly in octaves, above 1 gathers them around the frequency <br>
+ */
+void phase_shaper_multi_tilde_setCurve(phase_shaper_multi_tilde *x, float curve){
+    phase_shaper_meta_setCurve(x->p_meta, curve);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Selects where the dry-wet mix is applied. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param global 1 mixes once at the output, 0 mixes inside every stage (default) <br>
+ */
+void phase_shaper_multi_tilde_setMixMode(phase_shaper_multi_tilde *x, float global){
+    phase_shaper_meta_setMixMode(x->p_meta, global != 0 ? PHASE_SHAPER_META_MIX_GLOBAL : PHASE_SHAPER_META_MIX_STAGES);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Sets the ramp time of the frequency, Q and mix messages. <br>
+ * @param x A pointer to the phase_shaper_multi_tilde object <br>
+ * @param ms Sets the ramp time in milliseconds <br>
+ */
+void phase_shaper_multi_tilde_setRampTime(phase_shaper_multi_tilde *x, float ms){
+    phase_shaper_meta_setRampTime(x->p_meta, ms);
+}
+
+/**
+ * @related phase_shaper_multi_tilde
+ * @brief Setup for the phase_shaper_multi_tilde class <br>
+ */
+void phase_shaper_multi_tilde_setup(void){
+      phase_shaper_multi_tilde_class = class_new(gensym("phase_shaper_multi~"),
+            (t_newmethod)phase_shaper_multi_tilde_new,
+            (t_method)phase_shaper_multi_tilde_free,
+            sizeof(phase_shaper_multi_tilde),
+            CLASS_DEFAULT,
+            A_DEFFLOAT, A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_dsp, gensym("dsp"), 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setFrequency, gensym("freq"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setQ, gensym("q"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setFilterCount, gensym("filtercount"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setMix, gensym("mix"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setSpread, gensym("spread"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setCurve, gensym("curve"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setMixMode, gensym("globalmix"), A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_multi_tilde_class, (t_method)phase_shaper_multi_tilde_setRampTime, gensym("smooth"), A_DEFFLOAT, 0);
+
+      CLASS_MAINSIGNALIN(phase_shaper_multi_tilde_class, phase_shaper_multi_tilde, f);
+}
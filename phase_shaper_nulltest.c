@@ -0,0 +1,780 @@
+/**
+ * @file phase_shaper_nulltest.c
+ * @author Arne Kuhle <br>
+ * @brief An automated null test of the optimised cascade against the reference implementation.<br>
+ *
+ * phase_shaper_nulltest renders the breakbeat files through a chain of biquad_allpass objects, the reference scalar cascade,<br>
+ * and through phase_shaper_meta on every backend and trig mode the machine supports.<br>
+ * The spread preset places its stages across three octaves, the reference chain derives their frequencies on its own.<br>
+ * Presets deep enough for the convolution engine are additionally rendered with it forced on.<br>
+ * Every preset is also rendered in both transposed direct form II variants, in single and double precision.<br>
+ * Twelve voices of phase_shaper_voices, which batches the voices sharing their coefficients, are rendered with one and with four threads<br>
+ * while presets, mix and mix mode change and some voices fall silent. Both have to equal separate phase_shaper_meta instances bit for bit.<br>
+ * They are nulled against an exact render of the same structure in double precision, since the float reference<br>
+ * drifts from the ideal response for low frequencies. Only the double variant has to pass, the single one is reported for information.<br>
+ * Every optimised render is nulled against the reference, reporting maximum absolute error, RMS difference,<br>
+ * and the deviation of phase and group delay measured on the impulse responses.<br>
+ * A breach of any tolerance fails the test with exit status 1.<br>
+ * <br>
+ * The reference renders can be stored as golden files (-w) and later compared against (-g), so changes of the reference itself show up as well.<br>
+ * The recorded pair in audiofiles/nulltest is nulled with inverted polarity and reported for information.<br>
+ * <br>
+ * Usage: phase_shaper_nulltest [options] [input.wav ...] <br>
+ */
+
+#include "phase_shaper_meta.h"
+#include "phase_shaper_voices.h"
+#include "phase_shaper_wav.h"
+#include "biquad_allpass.h"
+#include "biquad_allpass_bank.h"
+#include "biquad_allpass_simd.h"
+#include "vas_mem.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PHASE_SHAPER_NULLTEST_BLOCK 64
+#define PHASE_SHAPER_NULLTEST_IMPULSE 16384
+#define PHASE_SHAPER_NULLTEST_BINS 32
+#define PHASE_SHAPER_NULLTEST_MAX_CHANNELS 8
+#define PHASE_SHAPER_NULLTEST_MIN_MAGNITUDE 0.1
+#define PHASE_SHAPER_NULLTEST_CACHE_BLOCK 256
+#define PHASE_SHAPER_NULLTEST_VOICES 12
+#define PHASE_SHAPER_NULLTEST_THREADS 4
+
+/**
+ * @struct phase_shaper_nulltest_preset
+ * @brief One parameter set of the test <br>
+ */
+typedef struct phase_shaper_nulltest_preset{
+    const char *name; /**< Printable name, also the golden file suffix */
+    float f0; /**< The filters center frequency */
+    float Q; /**< The filters q factor */
+    int nFilters; /**< The amount of allpass filters */
+    float mix; /**< The dry-wet mix */
+    float jumpF0; /**< A frequency applied at the middle of the file without a ramp, 0 for none */
+    float spread; /**< The width of the frequency range of the stages in octaves */
+} phase_shaper_nulltest_preset;
+
+/**
+ * @struct phase_shaper_nulltest_result
+ * @brief The deviation of one render from the reference <br>
+ */
+typedef struct phase_shaper_nulltest_result{
+    double maxError; /**< Maximum absolute sample difference */
+    double rmsError; /**< RMS of the difference */
+    double phaseError; /**< Maximum phase difference in degrees */
+    double delayError; /**< Maximum group delay difference in samples */
+} phase_shaper_nulltest_result;
+
+/**
+ * @struct phase_shaper_nulltest_options
+ * @brief The settings given on the command line <br>
+ */
+typedef struct phase_shaper_nulltest_options{
+    double maxError; /**< Tolerance of the maximum absolute error */
+    double rmsError; /**< Tolerance of the RMS difference */
+    double phaseError; /**< Tolerance of the phase deviation in degrees */
+    double delayError; /**< Tolerance of the group delay deviation in samples */
+    const char *writeGolden; /**< Directory the reference renders are written to, or NULL */
+    const char *readGolden; /**< Directory of golden files to compare the reference with, or NULL */
+} phase_shaper_nulltest_options;
+
+// presets of phase_shaper~_drums_example.pd, plus a frequency jump and a spread
+static const phase_shaper_nulltest_preset phase_shaper_nulltest_presets[] = {
+    {"punchy_kick", 120, 8, 30, 1, 0, 0},
+    {"epic_filler", 80, 32, 10, 0.5f, 0, 0},
+    {"space_wars", 3000, 2, 150, 1, 0, 0},
+    {"single", 1000, 10, 1, 1, 0, 0},
+    {"jump", 200, 4, 16, 0.8f, 2500, 0},
+    {"spread", 2000, 2, 12, 1, 4000, 3}
+};
+
+#define PHASE_SHAPER_NULLTEST_PRESETS ((int) (sizeof(phase_shaper_nulltest_presets) / sizeof(phase_shaper_nulltest_presets[0])))
+
+
+/*
+ * the center frequency of a stage relative to f0, derived from the description of biquad_allpass_bank_setSpread:
+ * the van der Corput sequence in base 2, shifted so stage 0 sits at f0, spaced evenly in octaves
+ */
+static double phase_shaper_nulltest_ratio(const phase_shaper_nulltest_preset *preset, int stage){
+
+    double position = 0, weight = 0.5;
+
+    for (int i = stage; i > 0; i /= 2, weight /= 2)
+        position += (i % 2) * weight;
+
+    return pow(2, preset->spread / 2 * (position < 0.5 ? 2 * position : 2 * position - 2));
+}
+
+
+/*
+ * the reference: one biquad_allpass chain per channel, blocks like in Pd,
+ * a jump is applied at the first block boundary behind the middle
+ */
+static void phase_shaper_nulltest_renderReference(const phase_shaper_nulltest_preset *preset, float sampleRate, float **channels, int nChannels, long nFrames){
+
+    const long jump = nFrames / 2 / PHASE_SHAPER_NULLTEST_BLOCK * PHASE_SHAPER_NULLTEST_BLOCK;
+    float scratch[PHASE_SHAPER_NULLTEST_BLOCK];
+
+    for (int c = 0; c < nChannels; c++) {
+        biquad_allpass **stages = (biquad_allpass **) vas_mem_alloc(preset->nFilters * sizeof(biquad_allpass *));
+
+        for (int s = 0; s < preset->nFilters; s++)
+            stages[s] = biquad_allpass_new((float) (preset->f0 * phase_shaper_nulltest_ratio(preset, s)), preset->Q, preset->mix, sampleRate);
+
+        for (long frame = 0; frame < nFrames; frame += PHASE_SHAPER_NULLTEST_BLOCK) {
+            const int n = nFrames - frame < PHASE_SHAPER_NULLTEST_BLOCK ? (int) (nFrames - frame) : PHASE_SHAPER_NULLTEST_BLOCK;
+            float *block = channels[c] + frame;
+
+            if (preset->jumpF0 > 0 && frame == jump) {
+                for (int s = 0; s < preset->nFilters; s++) {
+                    biquad_allpass_setFrequency(stages[s], (float) (preset->jumpF0 * phase_shaper_nulltest_ratio(preset, s)));
+                    biquad_allpass_updateParameters(stages[s]);
+                }
+            }
+
+            for (int s = 0; s < preset->nFilters; s++) {
+                biquad_allpass_filter_audio(stages[s], block, scratch, n);
+                memcpy(block, scratch, n * sizeof(float));
+            }
+        }
+
+        for (int s = 0; s < preset->nFilters; s++)
+            biquad_allpass_free(stages[s]);
+        vas_mem_free(stages);
+    }
+}
+
+
+/*
+ * the exact reference of the transposed forms: transposed direct form II with coefficients, states and signal in double,
+ * one stage after another over the whole file, which equals processing in blocks
+ */
+static void phase_shaper_nulltest_renderExact(const phase_shaper_nulltest_preset *preset, float sampleRate, float **channels, int nChannels, long nFrames){
+
+    const long jump = nFrames / 2 / PHASE_SHAPER_NULLTEST_BLOCK * PHASE_SHAPER_NULLTEST_BLOCK;
+    double *signal = (double *) vas_mem_alloc(nFrames * sizeof(double));
+
+    for (int c = 0; c < nChannels; c++) {
+
+        for (long n = 0; n < nFrames; n++)
+            signal[n] = channels[c][n];
+
+        for (int s = 0; s < preset->nFilters; s++) {
+            double state1 = 0, state2 = 0;
+            double b0 = 0, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+
+            for (long n = 0; n < nFrames; n++) {
+
+                // the coefficients of biquad_allpass_updateParameters with the mix folded in
+                if (n == 0 || (preset->jumpF0 > 0 && n == jump)) {
+                    const double w0 = 2 * M_PI * (n == 0 ? preset->f0 : preset->jumpF0) * phase_shaper_nulltest_ratio(preset, s) / sampleRate;
+                    const double alpha = sin(w0) / 2 * preset->Q;
+                    const double mix = preset->mix;
+
+                    a1 = mix * -2 * cos(w0) / (1 + alpha);
+                    a2 = mix * (1 - alpha) / (1 + alpha);
+                    b0 = (1 - mix) + a2;
+                    b1 = a1;
+                    b2 = mix;
+                }
+
+                {
+                    const double in = signal[n];
+                    const double out = b0 * in + state1;
+
+                    state1 = b1 * in - a1 * out + state2;
+                    state2 = b2 * in - a2 * out;
+                    signal[n] = out;
+                }
+            }
+        }
+
+        for (long n = 0; n < nFrames; n++)
+            channels[c][n] = (float) signal[n];
+    }
+
+    vas_mem_free(signal);
+}
+
+
+static void phase_shaper_nulltest_renderMeta(const phase_shaper_nulltest_preset *preset, float sampleRate, int backend, int trigMode,
+                                             int convolution, int form, float **channels, int nChannels, long nFrames){
+
+    const long jump = nFrames / 2 / PHASE_SHAPER_NULLTEST_BLOCK * PHASE_SHAPER_NULLTEST_BLOCK;
+    phase_shaper_meta *meta = phase_shaper_meta_newMultichannel(preset->f0, preset->Q, (float) preset->nFilters, preset->mix,
+                                                                nChannels, preset->nFilters, sampleRate);
+    float *block[PHASE_SHAPER_NULLTEST_MAX_CHANNELS];
+
+    phase_shaper_meta_setForm(meta, form);
+    phase_shaper_meta_setBackend(meta, backend);
+    phase_shaper_meta_setTrigMode(meta, trigMode);
+    phase_shaper_meta_setConvolution(meta, convolution);
+    phase_shaper_meta_setRampTime(meta, 0);
+    phase_shaper_meta_setSpread(meta, preset->spread);
+    phase_shaper_meta_reserve(meta, PHASE_SHAPER_NULLTEST_BLOCK);
+
+    for (long frame = 0; frame < nFrames; frame += PHASE_SHAPER_NULLTEST_BLOCK) {
+        const int n = nFrames - frame < PHASE_SHAPER_NULLTEST_BLOCK ? (int) (nFrames - frame) : PHASE_SHAPER_NULLTEST_BLOCK;
+
+        if (preset->jumpF0 > 0 && frame == jump)
+            phase_shaper_meta_setFrequency(meta, preset->jumpF0);
+
+        for (int c = 0; c < nChannels; c++)
+            block[c] = channels[c] + frame;
+        phase_shaper_meta_processMultichannel(meta, block, block, n);
+    }
+
+    phase_shaper_meta_free(meta);
+}
+
+
+// phase of the dft of x at bin frequency w
+static double phase_shaper_nulltest_phase(const float *x, int length, double w){
+
+    double re = 0, im = 0;
+
+    for (int n = 0; n < length; n++) {
+        re += x[n] * cos(w * n);
+        im -= x[n] * sin(w * n);
+    }
+
+    return atan2(im, re);
+}
+
+
+static double phase_shaper_nulltest_magnitude(const float *x, int length, double w){
+
+    double re = 0, im = 0;
+
+    for (int n = 0; n < length; n++) {
+        re += x[n] * cos(w * n);
+        im -= x[n] * sin(w * n);
+    }
+
+    return sqrt(re * re + im * im);
+}
+
+
+static double phase_shaper_nulltest_wrap(double phase){
+
+    while (phase > M_PI)
+        phase -= 2 * M_PI;
+    while (phase < -M_PI)
+        phase += 2 * M_PI;
+
+    return phase;
+}
+
+
+/*
+ * phase and group delay of both impulse responses at log spaced frequencies from 20 Hz to 20 kHz,
+ * the group delay is the phase slope across a narrow pair of frequencies,
+ * frequencies in a notch of the dry-wet mix are skipped, their phase is decided by rounding noise
+ */
+static void phase_shaper_nulltest_compareResponses(const float *reference, const float *candidate, float sampleRate, phase_shaper_nulltest_result *result){
+
+    const double delta = 2 * M_PI * 0.5 / sampleRate;
+
+    for (int b = 0; b < PHASE_SHAPER_NULLTEST_BINS; b++) {
+        const double f = 20 * pow(1000, (double) b / (PHASE_SHAPER_NULLTEST_BINS - 1));
+        const double w = 2 * M_PI * f / sampleRate;
+        double phaseReference, phaseCandidate, delayReference, delayCandidate;
+
+        if (f >= sampleRate / 2)
+            break;
+        if (phase_shaper_nulltest_magnitude(reference, PHASE_SHAPER_NULLTEST_IMPULSE, w) < PHASE_SHAPER_NULLTEST_MIN_MAGNITUDE)
+            continue;
+
+        phaseReference = phase_shaper_nulltest_phase(reference, PHASE_SHAPER_NULLTEST_IMPULSE, w);
+        phaseCandidate = phase_shaper_nulltest_phase(candidate, PHASE_SHAPER_NULLTEST_IMPULSE, w);
+        delayReference = -phase_shaper_nulltest_wrap(phase_shaper_nulltest_phase(reference, PHASE_SHAPER_NULLTEST_IMPULSE, w + delta) - phaseReference) / delta;
+        delayCandidate = -phase_shaper_nulltest_wrap(phase_shaper_nulltest_phase(candidate, PHASE_SHAPER_NULLTEST_IMPULSE, w + delta) - phaseCandidate) / delta;
+
+        result->phaseError = fmax(result->phaseError, fabs(phase_shaper_nulltest_wrap(phaseCandidate - phaseReference)) * 180 / M_PI);
+        result->delayError = fmax(result->delayError, fabs(delayCandidate - delayReference));
+    }
+}
+
+
+static void phase_shaper_nulltest_compare(float **reference, float **candidate, int nChannels, long nFrames, phase_shaper_nulltest_result *result){
+
+    double sum = 0;
+
+    for (int c = 0; c < nChannels; c++) {
+        for (long n = 0; n < nFrames; n++) {
+            const double e = fabs((double) candidate[c][n] - reference[c][n]);
+
+            result->maxError = fmax(result->maxError, e);
+            sum += e * e;
+        }
+    }
+
+    result->rmsError = sqrt(sum / ((double) nChannels * nFrames));
+}
+
+
+static double phase_shaper_nulltest_decibel(double value){
+    return value > 0 ? 20 * log10(value) : -INFINITY;
+}
+
+
+static int phase_shaper_nulltest_report(const char *name, const char *what, const phase_shaper_nulltest_result *result,
+                                        const phase_shaper_nulltest_options *options, int withResponse, int checked){
+
+    const int failed = checked && (result->maxError > options->maxError || result->rmsError > options->rmsError
+                       || (withResponse && (result->phaseError > options->phaseError || result->delayError > options->delayError)));
+
+    printf("%-4s %-34s %-18s max %9.3g (%7.1f dB)  rms %9.3g (%7.1f dB)",
+           !checked ? "info" : failed ? "FAIL" : "ok", name, what,
+           result->maxError, phase_shaper_nulltest_decibel(result->maxError),
+           result->rmsError, phase_shaper_nulltest_decibel(result->rmsError));
+    if (withResponse)
+        printf("  phase %8.2g deg  delay %8.2g smp", result->phaseError, result->delayError);
+    printf("\n");
+
+    return failed;
+}
+
+
+static float **phase_shaper_nulltest_channels(int nChannels, long nFrames){
+
+    float **channels = (float **) vas_mem_alloc(nChannels * sizeof(float *));
+
+    for (int c = 0; c < nChannels; c++)
+        channels[c] = (float *) vas_mem_alloc(nFrames * sizeof(float));
+
+    return channels;
+}
+
+
+static void phase_shaper_nulltest_freeChannels(float **channels, int nChannels){
+
+    for (int c = 0; c < nChannels; c++)
+        vas_mem_free(channels[c]);
+    vas_mem_free(channels);
+}
+
+
+static void phase_shaper_nulltest_copy(float **to, float **from, int nChannels, long nFrames){
+    for (int c = 0; c < nChannels; c++)
+        memcpy(to[c], from[c], nFrames * sizeof(float));
+}
+
+
+static const char *phase_shaper_nulltest_baseName(const char *path){
+
+    const char *slash = strrchr(path, '/');
+    const char *backslash = strrchr(path, '\\');
+
+    if (backslash != NULL && (slash == NULL || backslash > slash))
+        slash = backslash;
+
+    return slash != NULL ? slash + 1 : path;
+}
+
+
+// compares or stores the reference render, returns 1 on a breach
+static int phase_shaper_nulltest_golden(const phase_shaper_nulltest_options *options, const char *input, const phase_shaper_nulltest_preset *preset,
+                                        float **reference, int nChannels, long nFrames, int sampleRate){
+
+    char path[1024], stem[256];
+    char *dot;
+    int failed = 0;
+
+    // golden files are named <input>.<preset>.wav
+    snprintf(stem, sizeof(stem), "%s", phase_shaper_nulltest_baseName(input));
+    dot = strrchr(stem, '.');
+    if (dot != NULL)
+        *dot = 0;
+
+    if (options->writeGolden != NULL) {
+        phase_shaper_wav_writer writer;
+
+        snprintf(path, sizeof(path), "%s/%s.%s.wav", options->writeGolden, stem, preset->name);
+        if (phase_shaper_wav_create(&writer, path, nChannels, sampleRate, PHASE_SHAPER_WAV_FLOAT, 32) != 0
+            || phase_shaper_wav_write(&writer, reference, (int) nFrames) != 0
+            || phase_shaper_wav_finish(&writer) != 0)
+            failed = 1;
+    }
+
+    if (options->readGolden != NULL) {
+        phase_shaper_wav golden;
+        phase_shaper_nulltest_result result = {0, 0, 0, 0};
+
+        snprintf(path, sizeof(path), "%s/%s.%s.wav", options->readGolden, stem, preset->name);
+        if (phase_shaper_wav_open(&golden, path) != 0)
+            return 1;
+
+        if (golden.nChannels != nChannels || golden.nFrames != nFrames) {
+            fprintf(stderr, "%s: does not match the input\n", path);
+            failed = 1;
+        }
+        else {
+            float **stored = phase_shaper_nulltest_channels(nChannels, nFrames);
+
+            phase_shaper_wav_read(&golden, 0, (int) nFrames, stored);
+            phase_shaper_nulltest_compare(stored, reference, nChannels, nFrames, &result);
+            failed |= phase_shaper_nulltest_report(preset->name, "reference vs golden", &result, options, 0, 1);
+            phase_shaper_nulltest_freeChannels(stored, nChannels);
+        }
+
+        phase_shaper_wav_close(&golden);
+    }
+
+    return failed;
+}
+
+
+static void phase_shaper_nulltest_setVoice(phase_shaper_meta *meta, const phase_shaper_nulltest_preset *preset){
+    phase_shaper_meta_prepare(meta, (float) preset->nFilters);
+    phase_shaper_meta_setFilterCount(meta, (float) preset->nFilters);
+    phase_shaper_meta_setFrequency(meta, preset->f0);
+    phase_shaper_meta_setQ(meta, preset->Q);
+    phase_shaper_meta_setMix(meta, preset->mix);
+    phase_shaper_meta_setSpread(meta, preset->spread);
+}
+
+
+/*
+ * the changes of a voice at a block boundary, the same for phase_shaper_voices and the separate instances:
+ * one of the first three presets, one of the last three from the first quarter on, their jump and a mix of 0.5 at the middle
+ * and the global mix for every second voice from the third quarter on
+ */
+static void phase_shaper_nulltest_changeVoice(phase_shaper_meta *meta, int voice, long frame, long nFrames){
+
+    const long quarter = nFrames / 4 / PHASE_SHAPER_NULLTEST_BLOCK * PHASE_SHAPER_NULLTEST_BLOCK;
+    const phase_shaper_nulltest_preset *preset = &phase_shaper_nulltest_presets[3 + voice % 3];
+
+    if (frame == 0)
+        phase_shaper_nulltest_setVoice(meta, &phase_shaper_nulltest_presets[voice % 3]);
+    else if (frame == quarter)
+        phase_shaper_nulltest_setVoice(meta, preset);
+    else if (frame == 2 * quarter) {
+        if (preset->jumpF0 > 0)
+            phase_shaper_meta_setFrequency(meta, preset->jumpF0);
+        phase_shaper_meta_setMix(meta, 0.5f);
+    }
+    else if (frame == 3 * quarter && voice % 2 == 0)
+        phase_shaper_meta_setMixMode(meta, PHASE_SHAPER_META_MIX_GLOBAL);
+}
+
+
+// the input of every voice, a channel of the file, every second voice is silent from five to seven eighths
+static void phase_shaper_nulltest_voiceInputs(float **voices, float **dry, int nChannels, long nFrames){
+
+    for (int v = 0; v < PHASE_SHAPER_NULLTEST_VOICES; v++) {
+        memcpy(voices[v], dry[v % nChannels], nFrames * sizeof(float));
+        if (v % 2)
+            memset(voices[v] + nFrames * 5 / 8, 0, (nFrames * 7 / 8 - nFrames * 5 / 8) * sizeof(float));
+    }
+}
+
+
+static void phase_shaper_nulltest_renderSeparate(float sampleRate, float **voices, long nFrames){
+
+    for (int v = 0; v < PHASE_SHAPER_NULLTEST_VOICES; v++) {
+        phase_shaper_meta *meta = phase_shaper_meta_newMultichannel(1000, 10, 1, 1, 1, 0, sampleRate);
+
+        phase_shaper_meta_reserve(meta, PHASE_SHAPER_NULLTEST_BLOCK);
+
+        for (long frame = 0; frame < nFrames; frame += PHASE_SHAPER_NULLTEST_BLOCK) {
+            const int n = nFrames - frame < PHASE_SHAPER_NULLTEST_BLOCK ? (int) (nFrames - frame) : PHASE_SHAPER_NULLTEST_BLOCK;
+            float *block = voices[v] + frame;
+
+            phase_shaper_nulltest_changeVoice(meta, v, frame, nFrames);
+            phase_shaper_meta_processMultichannel(meta, &block, &block, n);
+        }
+
+        phase_shaper_meta_free(meta);
+    }
+}
+
+
+static void phase_shaper_nulltest_renderVoices(float sampleRate, int nThreads, float **voices, long nFrames){
+
+    phase_shaper_voices *x = phase_shaper_voices_new(PHASE_SHAPER_NULLTEST_VOICES, 1, 0, nThreads, sampleRate);
+    float *block[PHASE_SHAPER_NULLTEST_VOICES];
+
+    phase_shaper_voices_reserve(x, PHASE_SHAPER_NULLTEST_BLOCK);
+
+    for (long frame = 0; frame < nFrames; frame += PHASE_SHAPER_NULLTEST_BLOCK) {
+        const int n = nFrames - frame < PHASE_SHAPER_NULLTEST_BLOCK ? (int) (nFrames - frame) : PHASE_SHAPER_NULLTEST_BLOCK;
+
+        for (int v = 0; v < PHASE_SHAPER_NULLTEST_VOICES; v++) {
+            phase_shaper_nulltest_changeVoice(phase_shaper_voices_get(x, v), v, frame, nFrames);
+            block[v] = voices[v] + frame;
+        }
+        phase_shaper_voices_process(x, block, block, n);
+    }
+
+    phase_shaper_voices_free(x);
+}
+
+
+// batching and threads must not change a single bit, so the voices are checked without tolerance
+static int phase_shaper_nulltest_voices(const phase_shaper_nulltest_options *options, const char *input, float **dry, int nChannels,
+                                        long nFrames, float sampleRate){
+
+    float **separate = phase_shaper_nulltest_channels(PHASE_SHAPER_NULLTEST_VOICES, nFrames);
+    float **batched = phase_shaper_nulltest_channels(PHASE_SHAPER_NULLTEST_VOICES, nFrames);
+    phase_shaper_nulltest_options exact = *options;
+    char name[256];
+    int failures = 0;
+
+    exact.maxError = 0;
+    exact.rmsError = 0;
+    snprintf(name, sizeof(name), "%s/voices", phase_shaper_nulltest_baseName(input));
+
+    phase_shaper_nulltest_voiceInputs(separate, dry, nChannels, nFrames);
+    phase_shaper_nulltest_renderSeparate(sampleRate, separate, nFrames);
+
+    for (int nThreads = 1; nThreads <= PHASE_SHAPER_NULLTEST_THREADS; nThreads *= PHASE_SHAPER_NULLTEST_THREADS) {
+        phase_shaper_nulltest_result result = {0, 0, 0, 0};
+        char what[64];
+
+        snprintf(what, sizeof(what), "%d thread%s", nThreads, nThreads == 1 ? "" : "s");
+
+        phase_shaper_nulltest_voiceInputs(batched, dry, nChannels, nFrames);
+        phase_shaper_nulltest_renderVoices(sampleRate, nThreads, batched, nFrames);
+        phase_shaper_nulltest_compare(separate, batched, PHASE_SHAPER_NULLTEST_VOICES, nFrames, &result);
+
+        failures += phase_shaper_nulltest_report(name, what, &result, &exact, 0, 1);
+    }
+
+    phase_shaper_nulltest_freeChannels(batched, PHASE_SHAPER_NULLTEST_VOICES);
+    phase_shaper_nulltest_freeChannels(separate, PHASE_SHAPER_NULLTEST_VOICES);
+
+    return failures;
+}
+
+
+static int phase_shaper_nulltest_file(const phase_shaper_nulltest_options *options, const char *input){
+
+    phase_shaper_wav wav;
+    float **dry, **reference, **candidate;
+    float *impulseReference, *impulseCandidate;
+    int failures = 0;
+
+    if (phase_shaper_wav_open(&wav, input) != 0)
+        return 1;
+
+    if (wav.nChannels > PHASE_SHAPER_NULLTEST_MAX_CHANNELS) {
+        fprintf(stderr, "%s: too many channels\n", input);
+        phase_shaper_wav_close(&wav);
+        return 1;
+    }
+
+    dry = phase_shaper_nulltest_channels(wav.nChannels, wav.nFrames);
+    reference = phase_shaper_nulltest_channels(wav.nChannels, wav.nFrames);
+    candidate = phase_shaper_nulltest_channels(wav.nChannels, wav.nFrames);
+    impulseReference = (float *) vas_mem_alloc(PHASE_SHAPER_NULLTEST_IMPULSE * sizeof(float));
+    impulseCandidate = (float *) vas_mem_alloc(PHASE_SHAPER_NULLTEST_IMPULSE * sizeof(float));
+
+    phase_shaper_wav_read(&wav, 0, (int) wav.nFrames, dry);
+
+    for (int p = 0; p < PHASE_SHAPER_NULLTEST_PRESETS; p++) {
+        const phase_shaper_nulltest_preset *preset = &phase_shaper_nulltest_presets[p];
+        phase_shaper_nulltest_preset impulsePreset = *preset;
+        char name[256];
+
+        snprintf(name, sizeof(name), "%s/%s", phase_shaper_nulltest_baseName(input), preset->name);
+
+        phase_shaper_nulltest_copy(reference, dry, wav.nChannels, wav.nFrames);
+        phase_shaper_nulltest_renderReference(preset, (float) wav.sampleRate, reference, wav.nChannels, wav.nFrames);
+        failures += phase_shaper_nulltest_golden(options, input, preset, reference, wav.nChannels, wav.nFrames, wav.sampleRate);
+
+        // the responses are measured with the parameters the file starts with
+        impulsePreset.jumpF0 = 0;
+        memset(impulseReference, 0, PHASE_SHAPER_NULLTEST_IMPULSE * sizeof(float));
+        impulseReference[0] = 1;
+        phase_shaper_nulltest_renderReference(&impulsePreset, (float) wav.sampleRate, &impulseReference, 1, PHASE_SHAPER_NULLTEST_IMPULSE);
+
+        for (int backend = BIQUAD_ALLPASS_BACKEND_SCALAR; backend < BIQUAD_ALLPASS_BACKEND_COUNT; backend++) {
+            if (!biquad_allpass_simd_isSupported((biquad_allpass_backend) backend))
+                continue;
+
+            for (int trigMode = BIQUAD_ALLPASS_TRIG_EXACT; trigMode <= BIQUAD_ALLPASS_TRIG_POLYNOMIAL; trigMode++) {
+                phase_shaper_nulltest_result result = {0, 0, 0, 0};
+                char what[64];
+
+                snprintf(what, sizeof(what), "%s %s", biquad_allpass_simd_name((biquad_allpass_backend) backend),
+                         trigMode == BIQUAD_ALLPASS_TRIG_EXACT ? "exact" : "polynomial");
+
+                phase_shaper_nulltest_copy(candidate, dry, wav.nChannels, wav.nFrames);
+                phase_shaper_nulltest_renderMeta(preset, (float) wav.sampleRate, backend, trigMode, PHASE_SHAPER_META_CONVOLUTION_OFF, BIQUAD_ALLPASS_FORM_DF1,
+                                                 candidate, wav.nChannels, wav.nFrames);
+                phase_shaper_nulltest_compare(reference, candidate, wav.nChannels, wav.nFrames, &result);
+
+                memset(impulseCandidate, 0, PHASE_SHAPER_NULLTEST_IMPULSE * sizeof(float));
+                impulseCandidate[0] = 1;
+                phase_shaper_nulltest_renderMeta(&impulsePreset, (float) wav.sampleRate, backend, trigMode, PHASE_SHAPER_META_CONVOLUTION_OFF, BIQUAD_ALLPASS_FORM_DF1,
+                                                 &impulseCandidate, 1, PHASE_SHAPER_NULLTEST_IMPULSE);
+                phase_shaper_nulltest_compareResponses(impulseReference, impulseCandidate, (float) wav.sampleRate, &result);
+
+                failures += phase_shaper_nulltest_report(name, what, &result, options, 1, 1);
+            }
+        }
+
+        // the convolution engine takes over once the parameters settled, jumps are deferred by design
+        if (preset->nFilters >= PHASE_SHAPER_META_CONVOLUTION_MIN_FILTERS && preset->jumpF0 <= 0) {
+            phase_shaper_nulltest_result result = {0, 0, 0, 0};
+
+            phase_shaper_nulltest_copy(candidate, dry, wav.nChannels, wav.nFrames);
+            phase_shaper_nulltest_renderMeta(preset, (float) wav.sampleRate, BIQUAD_ALLPASS_BACKEND_AUTO, BIQUAD_ALLPASS_TRIG_EXACT,
+                                             PHASE_SHAPER_META_CONVOLUTION_ALWAYS, BIQUAD_ALLPASS_FORM_DF1, candidate, wav.nChannels, wav.nFrames);
+            phase_shaper_nulltest_compare(reference, candidate, wav.nChannels, wav.nFrames, &result);
+
+            memset(impulseCandidate, 0, PHASE_SHAPER_NULLTEST_IMPULSE * sizeof(float));
+            impulseCandidate[0] = 1;
+            phase_shaper_nulltest_renderMeta(&impulsePreset, (float) wav.sampleRate, BIQUAD_ALLPASS_BACKEND_AUTO, BIQUAD_ALLPASS_TRIG_EXACT,
+                                             PHASE_SHAPER_META_CONVOLUTION_ALWAYS, BIQUAD_ALLPASS_FORM_DF1, &impulseCandidate, 1, PHASE_SHAPER_NULLTEST_IMPULSE);
+            phase_shaper_nulltest_compareResponses(impulseReference, impulseCandidate, (float) wav.sampleRate, &result);
+
+            failures += phase_shaper_nulltest_report(name, "convolution", &result, options, 1, 1);
+        }
+
+        phase_shaper_nulltest_copy(reference, dry, wav.nChannels, wav.nFrames);
+        phase_shaper_nulltest_renderExact(preset, (float) wav.sampleRate, reference, wav.nChannels, wav.nFrames);
+        memset(impulseReference, 0, PHASE_SHAPER_NULLTEST_IMPULSE * sizeof(float));
+        impulseReference[0] = 1;
+        phase_shaper_nulltest_renderExact(&impulsePreset, (float) wav.sampleRate, &impulseReference, 1, PHASE_SHAPER_NULLTEST_IMPULSE);
+
+        for (int form = BIQUAD_ALLPASS_FORM_TDF2; form <= BIQUAD_ALLPASS_FORM_TDF2_DOUBLE; form++) {
+            phase_shaper_nulltest_result result = {0, 0, 0, 0};
+
+            phase_shaper_nulltest_copy(candidate, dry, wav.nChannels, wav.nFrames);
+            phase_shaper_nulltest_renderMeta(preset, (float) wav.sampleRate, BIQUAD_ALLPASS_BACKEND_AUTO, BIQUAD_ALLPASS_TRIG_EXACT,
+                                             PHASE_SHAPER_META_CONVOLUTION_OFF, form, candidate, wav.nChannels, wav.nFrames);
+            phase_shaper_nulltest_compare(reference, candidate, wav.nChannels, wav.nFrames, &result);
+
+            memset(impulseCandidate, 0, PHASE_SHAPER_NULLTEST_IMPULSE * sizeof(float));
+            impulseCandidate[0] = 1;
+            phase_shaper_nulltest_renderMeta(&impulsePreset, (float) wav.sampleRate, BIQUAD_ALLPASS_BACKEND_AUTO, BIQUAD_ALLPASS_TRIG_EXACT,
+                                             PHASE_SHAPER_META_CONVOLUTION_OFF, form, &impulseCandidate, 1, PHASE_SHAPER_NULLTEST_IMPULSE);
+            phase_shaper_nulltest_compareResponses(impulseReference, impulseCandidate, (float) wav.sampleRate, &result);
+
+            // single precision is no closer to the exact render than the reference, it is reported for information
+            failures += phase_shaper_nulltest_report(name, form == BIQUAD_ALLPASS_FORM_TDF2 ? "tdf2" : "tdf2 double", &result, options, 1,
+                                                     form == BIQUAD_ALLPASS_FORM_TDF2_DOUBLE);
+        }
+    }
+
+    failures += phase_shaper_nulltest_voices(options, input, dry, wav.nChannels, wav.nFrames, (float) wav.sampleRate);
+
+    vas_mem_free(impulseCandidate);
+    vas_mem_free(impulseReference);
+    phase_shaper_nulltest_freeChannels(candidate, wav.nChannels);
+    phase_shaper_nulltest_freeChannels(reference, wav.nChannels);
+    phase_shaper_nulltest_freeChannels(dry, wav.nChannels);
+    phase_shaper_wav_close(&wav);
+
+    return failures;
+}
+
+
+// nulls a recorded pair with inverted polarity, for information only
+static void phase_shaper_nulltest_pair(const char *pathA, const char *pathB){
+
+    phase_shaper_wav a, b;
+
+    if (phase_shaper_wav_open(&a, pathA) != 0)
+        return;
+    if (phase_shaper_wav_open(&b, pathB) != 0) {
+        phase_shaper_wav_close(&a);
+        return;
+    }
+
+    if (a.nChannels == b.nChannels && a.nChannels <= PHASE_SHAPER_NULLTEST_MAX_CHANNELS) {
+        const long nFrames = a.nFrames < b.nFrames ? a.nFrames : b.nFrames;
+        float **x = phase_shaper_nulltest_channels(a.nChannels, nFrames);
+        float **y = phase_shaper_nulltest_channels(a.nChannels, nFrames);
+        double peak = 0, sum = 0;
+
+        phase_shaper_wav_read(&a, 0, (int) nFrames, x);
+        phase_shaper_wav_read(&b, 0, (int) nFrames, y);
+
+        for (int c = 0; c < a.nChannels; c++) {
+            for (long n = 0; n < nFrames; n++) {
+                const double e = fabs((double) x[c][n] + y[c][n]);
+                peak = fmax(peak, e);
+                sum += e * e;
+            }
+        }
+
+        printf("info recorded pair %s + %s: max %.3g (%.1f dB)  rms %.3g (%.1f dB)\n",
+               phase_shaper_nulltest_baseName(pathA), phase_shaper_nulltest_baseName(pathB),
+               peak, phase_shaper_nulltest_decibel(peak),
+               sqrt(sum / ((double) a.nChannels * nFrames)), phase_shaper_nulltest_decibel(sqrt(sum / ((double) a.nChannels * nFrames))));
+
+        phase_shaper_nulltest_freeChannels(y, a.nChannels);
+        phase_shaper_nulltest_freeChannels(x, a.nChannels);
+    }
+
+    phase_shaper_wav_close(&b);
+    phase_shaper_wav_close(&a);
+}
+
+
+static void phase_shaper_nulltest_usage(void){
+    fprintf(stderr,
+            "usage: phase_shaper_nulltest [options] [input.wav ...]\n"
+            "inputs default to audiofiles/breakbeat_44kHz.wav and audiofiles/breakbeat_48kHz.wav\n"
+            "options:\n"
+            "  -e value    tolerance of the maximum absolute error (default 1e-3)\n"
+            "  -r value    tolerance of the RMS difference (default 1e-5)\n"
+            "  -p degrees  tolerance of the phase deviation (default 0.05)\n"
+            "  -d samples  tolerance of the group delay deviation (default 0.05)\n"
+            "  -w dir      write the reference renders as golden files\n"
+            "  -g dir      compare the reference renders with golden files\n");
+}
+
+
+int main(int argc, char **argv){
+
+    static const char *defaults[] = {"audiofiles/breakbeat_44kHz.wav", "audiofiles/breakbeat_48kHz.wav"};
+    phase_shaper_nulltest_options options = {1e-3, 1e-5, 0.05, 0.05, NULL, NULL};
+    const char **inputs = defaults;
+    int nInputs = 2;
+    int failures = 0;
+    int i;
+
+    // every run processes in the same passes, whatever the calibration would measure on this machine
+    phase_shaper_meta_pinCacheBlock(PHASE_SHAPER_NULLTEST_CACHE_BLOCK);
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i += 2) {
+        if (argv[i][1] == 0 || argv[i][2] != 0 || i + 1 >= argc) {
+            phase_shaper_nulltest_usage();
+            return 2;
+        }
+
+        switch (argv[i][1]) {
+            case 'e': options.maxError = atof(argv[i + 1]); break;
+            case 'r': options.rmsError = atof(argv[i + 1]); break;
+            case 'p': options.phaseError = atof(argv[i + 1]); break;
+            case 'd': options.delayError = atof(argv[i + 1]); break;
+            case 'w': options.writeGolden = argv[i + 1]; break;
+            case 'g': options.readGolden = argv[i + 1]; break;
+            default:
+                phase_shaper_nulltest_usage();
+                return 2;
+        }
+    }
+
+    if (i < argc) {
+        inputs = (const char **) (argv + i);
+        nInputs = argc - i;
+    }
+
+    for (int n = 0; n < nInputs; n++)
+        failures += phase_shaper_nulltest_file(&options, inputs[n]);
+
+    if (inputs == defaults)
+        phase_shaper_nulltest_pair("audiofiles/nulltest/breakbeat_wet_A.wav", "audiofiles/nulltest/breakbeat_wet_B.wav");
+
+    printf("%s: %d failure%s\n", failures ? "FAILED" : "PASSED", failures, failures == 1 ? "" : "s");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+/**
+ * @file phase_shaper_render.c
+ * @author Arne Kuhle <br>
+ * @brief A command line tool rendering WAV files through the phase_shaper cascade.<br>
+ *
+ * phase_shaper_render runs phase_shaper_meta without Pure Data, e.g. for batch processing stems.<br>
+ * Inputs are memory mapped and processed in large blocks, outputs are streamed.<br>
+ * The sample rate and channel count of every input are kept, all channels share the parameters.<br>
+ * <br>
+ * Usage: phase_shaper_render [options] -o output.wav input.wav <br>
+ *        phase_shaper_render [options] -d directory input.wav ... <br>
+ */
+
+#include "phase_shaper_meta.h"
+#include "biquad_allpass_bank.h"
+#include "phase_shaper_wav.h"
+#include "vas_mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PHASE_SHAPER_RENDER_BLOCK 4096
+#define PHASE_SHAPER_RENDER_CACHE_BLOCK 256
+
+/**
+ * @struct phase_shaper_render_options
+ * @brief The parameters given on the command line. <br>
+ */
+typedef struct phase_shaper_render_options{
+    float f0; /**< The filters center frequency */
+    float Q; /**< The filters q factor */
+    float nFilters; /**< The amount of allpass filters */
+    float mix; /**< The dry-wet mix */
+    float spread; /**< The width of the frequency range of the stages in octaves */
+    float curve; /**< The distribution of the spread stages */
+    float rampTime; /**< The ramp time in milliseconds, the spread fades in over it */
+    int globalMix; /**< Mixes the dry signal in once at the output instead of in every stage */
+    int form; /**< The filter structure, a biquad_allpass_form */
+    int blockSize; /**< Frames processed per call */
+    int format; /**< Output sample format, 0 keeps the format of the input */
+    int bitsPerSample; /**< Output bit depth of integer formats */
+    int quiet; /**< Suppresses the per file report */
+    const char *output; /**< The output file of a single input */
+    const char *directory; /**< The output directory of several inputs */
+} phase_shaper_render_options;
+
+
+static void phase_shaper_render_usage(void){
+    fprintf(stderr,
+            "usage: phase_shaper_render [options] -o output.wav input.wav\n"
+            "       phase_shaper_render [options] -d directory input.wav ...\n"
+            "options:\n"
+            "  -f hz       center frequency (default 1000)\n"
+            "  -q q        q factor (default 10)\n"
+            "  -n count    amount of allpass filters (default 1)\n"
+            "  -m mix      dry-wet mix (default 1)\n"
+            "  -p octaves  spread of the stage frequencies around the center frequency (default 0)\n"
+            "  -c curve    distribution of the spread stages, 1 spaces them evenly (default 1)\n"
+            "  -r ms       ramp time, the spread fades in over it at the start of every file (default 0)\n"
+            "  -g          mix the dry signal in once at the output instead of in every stage\n"
+            "  -t form     filter structure df1, tdf2 or tdf2double (default df1)\n"
+            "  -b frames   block size (default %d)\n"
+            "  -s format   output format 16, 24, 32 or float (default: as input)\n"
+            "  -v          no per file report\n",
+            PHASE_SHAPER_RENDER_BLOCK);
+}
+
+
+static int phase_shaper_render_file(const phase_shaper_render_options *options, const char *inputPath, const char *outputPath){
+
+    phase_shaper_wav input;
+    phase_shaper_wav_writer output;
+    phase_shaper_meta *meta;
+    float **channels;
+    float *memory;
+    clock_t start;
+    int result = 0;
+
+    if (phase_shaper_wav_open(&input, inputPath) != 0)
+        return -1;
+
+    if (phase_shaper_wav_create(&output, outputPath, input.nChannels, input.sampleRate,
+                                options->format ? options->format : input.format,
+                                options->format ? options->bitsPerSample : input.bitsPerSample) != 0) {
+        phase_shaper_wav_close(&input);
+        return -1;
+    }
+
+    meta = phase_shaper_meta_newMultichannel(options->f0, options->Q, options->nFilters, options->mix,
+                                             input.nChannels, (int) options->nFilters, (float) input.sampleRate);
+    phase_shaper_meta_setRampTime(meta, options->rampTime);
+    phase_shaper_meta_setSpread(meta, options->spread);
+    phase_shaper_meta_setCurve(meta, options->curve);
+    phase_shaper_meta_setMixMode(meta, options->globalMix ? PHASE_SHAPER_META_MIX_GLOBAL : PHASE_SHAPER_META_MIX_STAGES);
+    phase_shaper_meta_setForm(meta, options->form);
+    phase_shaper_meta_reserve(meta, options->blockSize);
+
+    // one block per channel, processed in place
+    channels = (float **) vas_mem_alloc(input.nChannels * sizeof(float *));
+    memory = (float *) vas_mem_alloc((long) input.nChannels * options->blockSize * sizeof(float));
+    for (int c = 0; c < input.nChannels; c++)
+        channels[c] = memory + (size_t) c * options->blockSize;
+
+    start = clock();
+
+    for (long frame = 0; frame < input.nFrames && result == 0; frame += options->blockSize) {
+        const int n = input.nFrames - frame < options->blockSize ? (int) (input.nFrames - frame) : options->blockSize;
+
+        phase_shaper_wav_read(&input, frame, n, channels);
+        phase_shaper_meta_processMultichannel(meta, channels, channels, n);
+        result = phase_shaper_wav_write(&output, channels, n);
+    }
+
+    if (phase_shaper_wav_finish(&output) != 0)
+        result = -1;
+
+    if (result == 0 && !options->quiet) {
+        const double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        const double duration = (double) input.nFrames / input.sampleRate;
+        vas_mem_stats memory;
+
+        vas_mem_getStats(&memory);
+
+        printf("%s -> %s: %.2f s audio in %.3f s (%.0fx real time), %ld kB in use, %ld kB peak, %ld kB reserved\n",
+               inputPath, outputPath, duration, seconds, seconds > 0 ? duration / seconds : 0,
+               memory.bytesInUse / 1024, memory.peakBytesInUse / 1024, memory.bytesReserved / 1024);
+    }
+
+    vas_mem_free(memory);
+    vas_mem_free(channels);
+    phase_shaper_meta_free(meta);
+    phase_shaper_wav_close(&input);
+
+    return result;
+}
+
+
+static int phase_shaper_render_parseFormat(phase_shaper_render_options *options, const char *value){
+
+    if (strcmp(value, "float") == 0) {
+        options->format = PHASE_SHAPER_WAV_FLOAT;
+        options->bitsPerSample = 32;
+        return 0;
+    }
+
+    options->format = PHASE_SHAPER_WAV_PCM;
+    options->bitsPerSample = atoi(value);
+
+    return options->bitsPerSample == 16 || options->bitsPerSample == 24 || options->bitsPerSample == 32 ? 0 : -1;
+}
+
+
+static int phase_shaper_render_parseForm(phase_shaper_render_options *options, const char *value){
+
+    if (strcmp(value, "df1") == 0)
+        options->form = BIQUAD_ALLPASS_FORM_DF1;
+    else if (strcmp(value, "tdf2") == 0)
+        options->form = BIQUAD_ALLPASS_FORM_TDF2;
+    else if (strcmp(value, "tdf2double") == 0)
+        options->form = BIQUAD_ALLPASS_FORM_TDF2_DOUBLE;
+    else
+        return -1;
+
+    return 0;
+}
+
+
+int main(int argc, char **argv){
+
+    phase_shaper_render_options options = {1000, 10, 1, 1, 0, 1, 0, 0, BIQUAD_ALLPASS_FORM_DF1,
+                                           PHASE_SHAPER_RENDER_BLOCK, 0, 0, 0, NULL, NULL};
+    int first = argc;
+    int failures = 0;
+
+    // every run processes in the same passes, whatever the calibration would measure on this machine
+    phase_shaper_meta_pinCacheBlock(PHASE_SHAPER_RENDER_CACHE_BLOCK);
+
+    for (int i = 1; i < argc; i++) {
+        const char *flag = argv[i];
+
+        if (flag[0] != '-' || flag[1] == 0 || flag[2] != 0) {
+            first = i;
+            break;
+        }
+
+        if (flag[1] == 'v') {
+            options.quiet = 1;
+            continue;
+        }
+
+        if (flag[1] == 'g') {
+            options.globalMix = 1;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            phase_shaper_render_usage();
+            return 2;
+        }
+
+        switch (flag[1]) {
+            case 'f': options.f0 = (float) atof(argv[++i]); break;
+            case 'q': options.Q = (float) atof(argv[++i]); break;
+            case 'n': options.nFilters = (float) atof(argv[++i]); break;
+            case 'm': options.mix = (float) atof(argv[++i]); break;
+            case 'p': options.spread = (float) atof(argv[++i]); break;
+            case 'c': options.curve = (float) atof(argv[++i]); break;
+            case 'r': options.rampTime = (float) atof(argv[++i]); break;
+            case 'b': options.blockSize = atoi(argv[++i]); break;
+            case 'o': options.output = argv[++i]; break;
+            case 'd': options.directory = argv[++i]; break;
+            case 's':
+                if (phase_shaper_render_parseFormat(&options, argv[++i]) != 0) {
+                    phase_shaper_render_usage();
+                    return 2;
+                }
+                break;
+            case 't':
+                if (phase_shaper_render_parseForm(&options, argv[++i]) != 0) {
+                    phase_shaper_render_usage();
+                    return 2;
+                }
+                break;
+            default:
+                phase_shaper_render_usage();
+                return 2;
+        }
+    }
+
+    if (first >= argc || options.blockSize < 1 || (options.output != NULL) == (options.directory != NULL)
+        || (options.output != NULL && argc - first != 1)) {
+        phase_shaper_render_usage();
+        return 2;
+    }
+
+    if (options.nFilters < 1)
+        options.nFilters = 1;
+
+    if (options.output != NULL)
+        return phase_shaper_render_file(&options, argv[first], options.output) == 0 ? 0 : 1;
+
+    // batch mode, every input keeps its file name
+    for (int i = first; i < argc; i++) {
+        const char *name = argv[i];
+        const char *slash = strrchr(name, '/');
+        const char *backslash = strrchr(name, '\\');
+        char *path;
+
+        if (backslash != NULL && (slash == NULL || backslash > slash))
+            slash = backslash;
+        if (slash != NULL)
+            name = slash + 1;
+
+        path = (char *) vas_mem_alloc((long) (strlen(options.directory) + strlen(name) + 2));
+        sprintf(path, "%s/%s", options.directory, name);
+
+        if (phase_shaper_render_file(&options, argv[i], path) != 0)
+            failures++;
+
+        vas_mem_free(path);
+    }
+
+    if (failures > 0)
+        fprintf(stderr, "%d of %d files failed\n", failures, argc - first);
+
+    return failures > 0 ? 1 : 0;
+}
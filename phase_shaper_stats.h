@@ -0,0 +1,95 @@
+/**
+ * @file phase_shaper_stats.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief Performance counters of the processing functions of phase_shaper
+ *
+ * The counters only exist if PHASE_SHAPER_STATS is defined, e.g. with make stats=yes. <br>
+ * Without it the struct and all PHASE_SHAPER_STATS_ macros vanish, a release build carries no trace of them. <br>
+ * <br>
+ * Time is read from the time stamp counter on x86, which counts cycles at the nominal clock rate, <br>
+ * and from the monotonic clock in nanoseconds elsewhere, see PHASE_SHAPER_STATS_UNIT. <br>
+ * The counters are written by the audio thread without synchronisation, except allocations, which the main thread writes. <br>
+ * Reading them from another thread may give a torn snapshot. <br>
+ */
+
+#ifndef ps_stats
+#define ps_stats
+
+#ifdef PHASE_SHAPER_STATS
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PHASE_SHAPER_STATS_UNIT "cycles"
+#elif !defined(_WIN32)
+#include <time.h>
+#define PHASE_SHAPER_STATS_UNIT "ns"
+#else
+#define PHASE_SHAPER_STATS_UNIT "none"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @struct phase_shaper_stats
+ * @brief The counters of one phase_shaper_meta instance <br>
+ */
+typedef struct phase_shaper_stats{
+    unsigned long long vectors; /**< The amount of processed vectors */
+    unsigned long long frames; /**< The amount of processed frames */
+    unsigned long long time; /**< The time spent in the process functions */
+    unsigned long long worstTime; /**< The longest time of a single vector */
+    unsigned long long stageFrames; /**< The amount of frames processed by the recursive cascade, times its stage count */
+    unsigned long long cascadeTime; /**< The time spent in the recursive cascade */
+    unsigned long long coefficientUpdates; /**< The amount of coefficient updates of the filter bank */
+    unsigned long long coefficientTime; /**< The time spent calculating coefficients */
+    unsigned long long parameterMessages; /**< The amount of frequency, q, mix and spread changes read by the audio thread */
+    unsigned long long coalescedMessages; /**< The amount of those changes that shared their coefficient update with another change read at the same time */
+    unsigned long long allocations; /**< The amount of times the main thread grew the stage pool or created the convolution engine */
+    unsigned long long bypassedVectors; /**< The amount of silent vectors the cascade was bypassed for */
+} phase_shaper_stats;
+
+/**
+ * @brief Reads the clock of the counters <br>
+ * @returns The current time in PHASE_SHAPER_STATS_UNIT <br>
+ */
+static inline unsigned long long phase_shaper_stats_now(void){
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    return (unsigned long long) __rdtsc();
+#elif !defined(_WIN32)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long) t.tv_sec * 1000000000ULL + (unsigned long long) t.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @brief Declares the start time of a measurement <br> */
+#define PHASE_SHAPER_STATS_START(start) const unsigned long long start = phase_shaper_stats_now()
+
+/** @brief Adds the time since start to a counter <br> */
+#define PHASE_SHAPER_STATS_ADD_TIME(counter, start) ((counter) += phase_shaper_stats_now() - (start))
+
+/** @brief Adds an amount to a counter <br> */
+#define PHASE_SHAPER_STATS_ADD(counter, amount) ((counter) += (unsigned long long) (amount))
+
+#else
+
+#define PHASE_SHAPER_STATS_START(start)
+#define PHASE_SHAPER_STATS_ADD_TIME(counter, start) ((void) 0)
+#define PHASE_SHAPER_STATS_ADD(counter, amount) ((void) 0)
+
+#endif
+
+#endif
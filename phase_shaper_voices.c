@@ -0,0 +1,411 @@
+#include "phase_shaper_voices.h"
+#include "phase_shaper_batch.h"
+#include "phase_shaper_atomic.h"
+#include "vas_mem.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @struct phase_shaper_voices_worker
+ * @brief The argument of a worker thread <br>
+ */
+typedef struct phase_shaper_voices_worker{
+    struct phase_shaper_voices_pool *pool; /**< The pool of the worker */
+    int range; /**< The range the worker starts with */
+} phase_shaper_voices_worker;
+
+/**
+ * @struct phase_shaper_voices_pool
+ * @brief The worker threads and the signal that wakes them for a new vector <br>
+ */
+typedef struct phase_shaper_voices_pool{
+#ifdef _WIN32
+    HANDLE threads[PHASE_SHAPER_VOICES_MAX_THREADS]; /**< The worker threads */
+    SRWLOCK lock; /**< Guards generation and quit */
+    CONDITION_VARIABLE wake; /**< Signals a new generation */
+#else
+    pthread_t threads[PHASE_SHAPER_VOICES_MAX_THREADS]; /**< The worker threads */
+    pthread_mutex_t lock; /**< Guards generation and quit */
+    pthread_cond_t wake; /**< Signals a new generation */
+#endif
+    int nWorkers; /**< The amount of worker threads */
+    unsigned int generation; /**< Counts the processed vectors */
+    int quit; /**< Set when the workers have to stop */
+    phase_shaper_voices *voices; /**< The voices the workers process */
+    phase_shaper_voices_worker workers[PHASE_SHAPER_VOICES_MAX_THREADS]; /**< The arguments of the worker threads */
+} phase_shaper_voices_pool;
+
+
+static int phase_shaper_voices_cpuCount(void){
+
+#ifdef _WIN32
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+
+#else
+
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+
+#endif
+}
+
+
+static void phase_shaper_voices_yield(void){
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+
+// claims voices of the own range first, then steals from the following ones
+static void phase_shaper_voices_work(phase_shaper_voices *x, int range){
+
+    for (int k = 0; k < x->nThreads; k++) {
+        phase_shaper_voices_range *r = &x->ranges[(range + k) % x->nThreads];
+        int v;
+
+        while ((v = phase_shaper_atomic_fetchAdd(&r->next, 1)) < r->last) {
+            const int offset = v * x->nChannels;
+            const int b = x->batchOf[v];
+
+            // the other members of a batch count as done right away, the barrier still waits for its first lane
+            if (b < 0)
+                phase_shaper_meta_processMultichannel(x->voices[v], x->in + offset, x->out + offset, x->vectorSize);
+            else if (x->batches[b]->index[0] == v)
+                phase_shaper_batch_process(x->batches[b], x->in, x->out, x->vectorSize);
+
+            phase_shaper_atomic_fetchAdd(&x->done, 1);
+        }
+    }
+}
+
+
+// fills a free batch with a voice which has just become steady and every steady voice without a batch sharing its coefficients
+static void phase_shaper_voices_group(phase_shaper_voices *x, int v){
+
+    phase_shaper_batch *batch;
+    int b;
+
+    for (b = 0; b < x->nBatches; b++) {
+        if (x->batches[b]->nMembers > 0 && phase_shaper_batch_accepts(x->batches[b], x->voices[v])) {
+            phase_shaper_batch_join(x->batches[b], x->voices[v], v);
+            x->batchOf[v] = b;
+            return;
+        }
+    }
+
+    for (b = 0; b < x->nBatches; b++) {
+        if (x->batches[b]->nMembers == 0)
+            break;
+    }
+
+    if (b == x->nBatches || !phase_shaper_batch_accepts(x->batches[b], x->voices[v]))
+        return;
+
+    batch = x->batches[b];
+    phase_shaper_batch_join(batch, x->voices[v], v);
+    x->batchOf[v] = b;
+
+    for (int u = 0; u < x->nVoices; u++) {
+        if (x->batchOf[u] >= 0 || !phase_shaper_meta_steady(x->voices[u]) || !phase_shaper_batch_accepts(batch, x->voices[u]))
+            continue;
+
+        phase_shaper_batch_join(batch, x->voices[u], u);
+        x->batchOf[u] = b;
+    }
+
+    // a single lane costs as much as a full batch
+    if (batch->nMembers == 1) {
+        phase_shaper_batch_release(batch, 0);
+        x->batchOf[v] = -1;
+    }
+}
+
+
+// releases the voices which are about to change, then groups the ones which have become steady
+static void phase_shaper_voices_regroup(phase_shaper_voices *x){
+
+    for (int b = 0; b < x->nBatches; b++) {
+        phase_shaper_batch *batch = x->batches[b];
+
+        // releasing a lane moves the last one into it, which has been checked already
+        for (int l = batch->nMembers - 1; l >= 0; l--) {
+            if (!phase_shaper_meta_steady(batch->members[l])) {
+                x->batchOf[batch->index[l]] = -1;
+                phase_shaper_batch_release(batch, l);
+            }
+        }
+
+        if (batch->nMembers == 1) {
+            x->batchOf[batch->index[0]] = -1;
+            phase_shaper_batch_release(batch, 0);
+        }
+    }
+
+    for (int v = 0; v < x->nVoices; v++) {
+        const int steady = phase_shaper_meta_steady(x->voices[v]);
+
+        if (steady && !x->steady[v] && x->batchOf[v] < 0)
+            phase_shaper_voices_group(x, v);
+        x->steady[v] = steady;
+    }
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI phase_shaper_voices_run(LPVOID argument)
+#else
+static void *phase_shaper_voices_run(void *argument)
+#endif
+{
+    const phase_shaper_voices_worker *worker = (const phase_shaper_voices_worker *) argument;
+    phase_shaper_voices_pool *pool = worker->pool;
+    unsigned int seen = 0;
+    int quit;
+
+    for (;;) {
+
+        // sleep until the next vector
+#ifdef _WIN32
+        AcquireSRWLockExclusive(&pool->lock);
+        while (pool->generation == seen && !pool->quit)
+            SleepConditionVariableSRW(&pool->wake, &pool->lock, INFINITE, 0);
+        seen = pool->generation;
+        quit = pool->quit;
+        ReleaseSRWLockExclusive(&pool->lock);
+#else
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->quit)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        seen = pool->generation;
+        quit = pool->quit;
+        pthread_mutex_unlock(&pool->lock);
+#endif
+
+        if (quit)
+            break;
+
+        // a worker waking late finds its range taken and returns to sleep
+        phase_shaper_voices_work(pool->voices, worker->range);
+    }
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+
+static phase_shaper_voices_pool *phase_shaper_voices_startPool(phase_shaper_voices *x){
+
+    phase_shaper_voices_pool *pool = (phase_shaper_voices_pool *) vas_mem_alloc(sizeof(phase_shaper_voices_pool));
+
+    pool->voices = x;
+    pool->generation = 0;
+    pool->quit = 0;
+    pool->nWorkers = 0;
+
+#ifdef _WIN32
+    InitializeSRWLock(&pool->lock);
+    InitializeConditionVariable(&pool->wake);
+#else
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+#endif
+
+    // range 0 belongs to the calling thread
+    for (int t = 1; t < x->nThreads; t++) {
+        phase_shaper_voices_worker *worker = &pool->workers[t - 1];
+
+        worker->pool = pool;
+        worker->range = t;
+
+#ifdef _WIN32
+        pool->threads[t - 1] = CreateThread(NULL, 0, phase_shaper_voices_run, worker, 0, NULL);
+        if (pool->threads[t - 1] == NULL)
+            break;
+#else
+        if (pthread_create(&pool->threads[t - 1], NULL, phase_shaper_voices_run, worker) != 0)
+            break;
+#endif
+
+        pool->nWorkers++;
+    }
+
+    return pool;
+}
+
+
+static void phase_shaper_voices_stopPool(phase_shaper_voices_pool *pool){
+
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&pool->lock);
+    pool->quit = 1;
+    WakeAllConditionVariable(&pool->wake);
+    ReleaseSRWLockExclusive(&pool->lock);
+
+    for (int t = 0; t < pool->nWorkers; t++) {
+        WaitForSingleObject(pool->threads[t], INFINITE);
+        CloseHandle(pool->threads[t]);
+    }
+#else
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int t = 0; t < pool->nWorkers; t++)
+        pthread_join(pool->threads[t], NULL);
+
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+
+    vas_mem_free(pool);
+}
+
+
+phase_shaper_voices *phase_shaper_voices_new(int nVoices, int nChannels, int maxFilters, int nThreads, float sampleRate){
+
+    phase_shaper_voices *x = (phase_shaper_voices *) vas_mem_alloc(sizeof(phase_shaper_voices));
+
+    if (nVoices < 1)
+        nVoices = 1;
+    if (nChannels < 1)
+        nChannels = 1;
+    if (nThreads < 1)
+        nThreads = phase_shaper_voices_cpuCount();
+    if (nThreads > nVoices)
+        nThreads = nVoices;
+    if (nThreads > PHASE_SHAPER_VOICES_MAX_THREADS)
+        nThreads = PHASE_SHAPER_VOICES_MAX_THREADS;
+
+    x->nVoices = nVoices;
+    x->nChannels = nChannels;
+    x->nThreads = nThreads;
+    x->vectorSize = 0;
+    x->done = 0;
+
+    x->voices = (phase_shaper_meta **) vas_mem_alloc(nVoices * sizeof(phase_shaper_meta *));
+    for (int v = 0; v < nVoices; v++)
+        x->voices[v] = phase_shaper_meta_newMultichannel(1000, 10, 1, 1, nChannels, maxFilters, sampleRate);
+
+    x->ranges = (phase_shaper_voices_range *) vas_mem_alloc(nThreads * sizeof(phase_shaper_voices_range));
+
+    // every batch holds at least two voices
+    x->nBatches = nChannels == 1 && phase_shaper_batch_lanes() > 1 ? nVoices / 2 : 0;
+    x->batches = (phase_shaper_batch **) vas_mem_alloc((x->nBatches > 0 ? x->nBatches : 1) * sizeof(phase_shaper_batch *));
+    for (int b = 0; b < x->nBatches; b++)
+        x->batches[b] = phase_shaper_batch_new(x->voices[0]->maxFilters, sampleRate);
+
+    x->batchOf = (int *) vas_mem_alloc(nVoices * sizeof(int));
+    x->steady = (int *) vas_mem_alloc(nVoices * sizeof(int));
+    for (int v = 0; v < nVoices; v++)
+        x->batchOf[v] = -1;
+
+    // the workers sleep until the first vector, if not all of them could be started the ranges are spread over fewer threads
+    x->pool = NULL;
+    if (nThreads > 1) {
+        x->pool = phase_shaper_voices_startPool(x);
+        x->nThreads = x->pool->nWorkers + 1;
+    }
+
+    // contiguous ranges of nearly equal size, stealing evens out voices of different cost
+    for (int t = 0; t < x->nThreads; t++) {
+        x->ranges[t].last = (int) ((long) nVoices * (t + 1) / x->nThreads);
+        x->ranges[t].next = x->ranges[t].last;
+    }
+
+    return x;
+}
+
+
+void phase_shaper_voices_free(phase_shaper_voices *x){
+
+    if (x->pool != NULL)
+        phase_shaper_voices_stopPool(x->pool);
+
+    for (int v = 0; v < x->nVoices; v++)
+        phase_shaper_meta_free(x->voices[v]);
+
+    for (int b = 0; b < x->nBatches; b++)
+        phase_shaper_batch_free(x->batches[b]);
+
+    vas_mem_free(x->steady);
+    vas_mem_free(x->batchOf);
+    vas_mem_free(x->batches);
+    vas_mem_free(x->ranges);
+    vas_mem_free(x->voices);
+    vas_mem_free(x);
+}
+
+
+phase_shaper_meta *phase_shaper_voices_get(phase_shaper_voices *x, int voice){
+
+    if (voice < 0 || voice >= x->nVoices)
+        return NULL;
+
+    return x->voices[voice];
+}
+
+
+void phase_shaper_voices_setSampleRate(phase_shaper_voices *x, float sampleRate){
+    for (int v = 0; v < x->nVoices; v++)
+        phase_shaper_meta_setSampleRate(x->voices[v], sampleRate);
+}
+
+
+void phase_shaper_voices_reserve(phase_shaper_voices *x, int vectorSize){
+    for (int v = 0; v < x->nVoices; v++)
+        phase_shaper_meta_reserve(x->voices[v], vectorSize);
+
+    for (int b = 0; b < x->nBatches; b++)
+        phase_shaper_batch_reserve(x->batches[b], vectorSize);
+}
+
+
+void phase_shaper_voices_process(phase_shaper_voices *x, float **in, float **out, int vectorSize){
+
+    x->in = in;
+    x->out = out;
+    x->vectorSize = vectorSize;
+    phase_shaper_atomic_store(&x->done, 0);
+
+    phase_shaper_voices_regroup(x);
+
+    // the buffers are written before the ranges open, a worker claiming a voice sees them
+    for (int t = 0; t < x->nThreads; t++)
+        phase_shaper_atomic_store(&x->ranges[t].next, (int) ((long) x->nVoices * t / x->nThreads));
+
+    if (x->pool != NULL) {
+#ifdef _WIN32
+        AcquireSRWLockExclusive(&x->pool->lock);
+        x->pool->generation++;
+        WakeAllConditionVariable(&x->pool->wake);
+        ReleaseSRWLockExclusive(&x->pool->lock);
+#else
+        pthread_mutex_lock(&x->pool->lock);
+        x->pool->generation++;
+        pthread_cond_broadcast(&x->pool->wake);
+        pthread_mutex_unlock(&x->pool->lock);
+#endif
+    }
+
+    phase_shaper_voices_work(x, 0);
+
+    // the barrier: only voices a worker claimed but not yet finished are left
+    while (phase_shaper_atomic_load(&x->done) < x->nVoices)
+        phase_shaper_voices_yield();
+}
@@ -0,0 +1,136 @@
+/**
+ * @file phase_shaper_voices.h
+ * @author Arne Kuhle <br>
+ * @date 17 Oct 2026
+ * @brief Many phase_shaper_meta voices processed in parallel <br>
+ *
+ * phase_shaper_voices owns a set of independent phase_shaper_meta voices and a fixed pool of worker threads. <br>
+ * The voices are split into one range per thread. Every thread works through its own range first and then steals
+ * the remaining voices of the other ranges, one voice at a time. <br>
+ * phase_shaper_voices_process returns once every voice has been processed, so no latency is added. <br>
+ * The calling thread takes part in the work and can finish a vector on its own, late workers only shorten the wait. <br>
+ * <br>
+ * Every voice is processed by exactly one thread per vector and only touches its own state and buffers, <br>
+ * so the output is identical to processing the voices one after another, independent of the thread count. <br>
+ * <br>
+ * Single channel voices with identical coefficients are grouped into a phase_shaper_batch, which filters them as the SIMD lanes
+ * of one cascade. A voice joins once it becomes steady (see phase_shaper_meta_steady) and leaves before its parameters change,
+ * the grouping runs on the calling thread at the start of a vector. The output does not change. <br>
+ * <br>
+ * The parameters of a voice are set through its phase_shaper_meta object, see phase_shaper_voices_get. <br>
+ * Workers never allocate, all memory is taken by phase_shaper_voices_new and phase_shaper_voices_reserve. <br>
+ */
+
+#ifndef ps_voices
+#define ps_voices
+
+#include "phase_shaper_meta.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The largest thread pool, including the calling thread <br>
+ */
+#define PHASE_SHAPER_VOICES_MAX_THREADS 64
+
+struct phase_shaper_voices_pool;
+struct phase_shaper_batch;
+
+/**
+ * @struct phase_shaper_voices_range
+ * @brief The voices a thread starts with, one cache line each so the counters do not share lines <br>
+ */
+typedef struct phase_shaper_voices_range{
+    volatile int next; /**< The next voice to claim, claimed by an atomic increment */
+    int last; /**< The index behind the last voice of the range */
+    char padding[64 - 2 * sizeof(int)]; /**< Fills the cache line */
+} phase_shaper_voices_range;
+
+/**
+ * @struct phase_shaper_voices
+ * @brief The struct of a set of voices with its thread pool <br>
+ */
+typedef struct phase_shaper_voices{
+    int nVoices; /**< The amount of voices */
+    int nChannels; /**< The amount of channels of every voice */
+    int nThreads; /**< The amount of threads processing a vector, including the calling thread */
+    phase_shaper_meta **voices; /**< The voices */
+    phase_shaper_voices_range *ranges; /**< One range of voices per thread */
+    float **in; /**< The input buffers of the current vector */
+    float **out; /**< The output buffers of the current vector */
+    int vectorSize; /**< The length of the current vector */
+    volatile int done; /**< The amount of voices processed in the current vector */
+    int nBatches; /**< The amount of batches, 0 for multichannel voices or without SIMD lanes */
+    struct phase_shaper_batch **batches; /**< The batches, a batch is processed by the thread claiming the voice of its first lane */
+    int *batchOf; /**< The batch of each voice, -1 while the voice processes on its own */
+    int *steady; /**< 1 for each voice which was steady at the start of the last vector */
+    struct phase_shaper_voices_pool *pool; /**< The worker threads, NULL with a single thread */
+} phase_shaper_voices;
+
+/**
+ * @related phase_shaper_voices
+ * @brief Creates a new phase_shaper_voices object <br>
+ * @param nVoices The amount of voices <br>
+ * @param nChannels The amount of channels of every voice <br>
+ * @param maxFilters The size of the stage pool of every voice, 0 for PHASE_SHAPER_META_MAX_FILTERS <br>
+ * @param nThreads The amount of threads including the calling one, 0 for one per cpu core <br>
+ * @param sampleRate The systems sample rate <br>
+ * @returns an instance of the phase_shaper_voices object <br>
+ *
+ * The thread count is limited to the voice count and to PHASE_SHAPER_VOICES_MAX_THREADS. <br>
+ * The worker threads are started here and sleep while no vector is processed. <br>
+ */
+phase_shaper_voices *phase_shaper_voices_new(int nVoices, int nChannels, int maxFilters, int nThreads, float sampleRate);
+
+/**
+ * @related phase_shaper_voices
+ * @brief Stops the worker threads and frees the phase_shaper_voices object and its voices. <br>
+ * @param x A pointer the phase_shaper_voices object <br>
+ */
+void phase_shaper_voices_free(phase_shaper_voices *x);
+
+/**
+ * @related phase_shaper_voices
+ * @brief Returns a voice for setting its parameters <br>
+ * @param x A pointer to the phase_shaper_voices object <br>
+ * @param voice The index of the voice <br>
+ * @returns The phase_shaper_meta object of the voice, NULL for an invalid index <br>
+ */
+phase_shaper_meta *phase_shaper_voices_get(phase_shaper_voices *x, int voice);
+
+/**
+ * @related phase_shaper_voices
+ * @brief Sets the sample rate of all voices. <br>
+ * @param x A pointer to the phase_shaper_voices object <br>
+ * @param sampleRate The sample rate in Hz <br>
+ */
+void phase_shaper_voices_setSampleRate(phase_shaper_voices *x, float sampleRate);
+
+/**
+ * @related phase_shaper_voices
+ * @brief Allocates the buffers of all voices for a vector size <br>
+ * @param x A pointer to the phase_shaper_voices object <br>
+ * @param vectorSize The longest vector passed to phase_shaper_voices_process <br>
+ */
+void phase_shaper_voices_reserve(phase_shaper_voices *x, int vectorSize);
+
+/**
+ * @related phase_shaper_voices
+ * @brief Processes one vector of every voice <br>
+ * @param x A pointer to the phase_shaper_voices object <br>
+ * @param in nVoices * nChannels input buffers, all channels of voice 0 first <br>
+ * @param out nVoices * nChannels output buffers in the same order <br>
+ * @param vectorSize Amount of samples per buffer <br>
+ *
+ * An output buffer may be the input buffer of the same channel, but not a buffer of another voice. <br>
+ * Returns after every voice has been processed. Must not be called from several threads at once. <br>
+ */
+void phase_shaper_voices_process(phase_shaper_voices *x, float **in, float **out, int vectorSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
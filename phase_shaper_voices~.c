@@ -0,0 +1,323 @@
+/**
+ * @file "phase_shaper_voices~.c"
+ * @author Arne Kuhle <br>
+ * @brief A Pure Data object hosting many phase shaper voices, processed in parallel.<br>
+ *
+ * phase_shaper_voices~ replaces a large amount of phase_shaper_mono~ objects. Each voice filters its own signal.<br>
+ * The first creation argument sets the amount of voices (1 to 256), each with a signal inlet and outlet.<br>
+ * The optional second argument sets the amount of threads including Pd's audio thread, 0 uses one per cpu core.<br>
+ * The optional third argument sets the amount of stages reserved up front for every voice, the pools grow on demand.<br>
+ * <br>
+ * The messages freq, q, filtercount, mix, globalmix, spread, curve and smooth take a value for all voices, or a voice index (starting at 0) and a value.<br>
+ * The output is the same as with one phase_shaper_mono~ per voice and does not depend on the thread count.<br>
+ * Voices with the same settings are filtered together in the lanes of one SIMD cascade, so many drum voices on one preset cost less than separate objects.<br>
+ */
+
+#include "m_pd.h"
+#include "phase_shaper_voices.h"
+#include "vas_mem.h"
+
+/**
+ * @brief The maximum amount of voices of a phase_shaper_voices~ object <br>
+ */
+#define PHASE_SHAPER_VOICES_TILDE_MAX_VOICES 256
+
+static t_class *phase_shaper_voices_tilde_class;
+
+/**
+ * @struct phase_shaper_voices_tilde
+ * @brief The Pure Data struct of the phase_shaper_voices~ object. <br>
+ */
+typedef struct phase_shaper_voices_tilde{
+    t_object  x_obj; /**< Necessary for every signal object in Pure Data */
+    t_sample f; /**< Necessary for signal objects, float dummy dataspace for converting a float to signal if no signal is connected (CLASS_MAINSIGNALIN) */
+
+    int nVoices; /**< The amount of voices */
+    phase_shaper_voices *p_voices; /**< The voices and their worker threads */
+
+    t_inlet **inlets; /**< additional signal inlets, the first voice uses the main inlet */
+    t_outlet **outlets; /**< A signal outlet for each voice */
+
+    t_sample **signals; /**< The input vectors of the current DSP cycle */
+    t_sample **in; /**< Copies of the input vectors, Pd may reuse an input vector as output of another voice */
+    t_sample **out; /**< The output vectors of the current DSP cycle */
+    t_sample *copies; /**< The memory of the input copies */
+    int vectorSize; /**< The vector size the copies are allocated for */
+} phase_shaper_voices_tilde;
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Calculates the allpass filtered output vectors of all voices<br>
+ * @param w A pointer to the object and the vector size. <br>
+ * The function copies the inputs and calls the phase_shaper_voices_process method. <br>
+ * @return A pointer to the signal chain right behind the phase_shaper_voices_tilde_perform object. <br>
+ */
+t_int *phase_shaper_voices_tilde_perform(t_int *w)
+{
+    phase_shaper_voices_tilde *x = (phase_shaper_voices_tilde *)(w[1]);
+    int n = (int)(w[2]);
+
+    for (int v = 0; v < x->nVoices; v++)
+        memcpy(x->in[v], x->signals[v], n * sizeof(t_sample));
+
+    phase_shaper_voices_process(x->p_voices, x->in, x->out, n);
+
+    return (w+3);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Adds phase_shaper_voices_tilde_perform to the signal chain. <br>
+ * Forwards the sample rate of the signal chain and allocates the input copies for the vector size. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param sp A pointer to the input and output vectors <br>
+ */
+void phase_shaper_voices_tilde_dsp(phase_shaper_voices_tilde *x, t_signal **sp)
+{
+    const int n = sp[0]->s_n;
+
+    if (n > x->vectorSize) {
+        vas_mem_free(x->copies);
+        x->copies = (t_sample *) vas_mem_alloc((long) x->nVoices * n * sizeof(t_sample));
+        x->vectorSize = n;
+    }
+
+    for (int v = 0; v < x->nVoices; v++) {
+        x->signals[v] = sp[v]->s_vec;
+        x->in[v] = x->copies + (size_t) v * n;
+        x->out[v] = sp[x->nVoices + v]->s_vec;
+    }
+
+    phase_shaper_voices_setSampleRate(x->p_voices, sp[0]->s_sr);
+    phase_shaper_voices_reserve(x->p_voices, n);
+    dsp_add(phase_shaper_voices_tilde_perform, 2, x, n);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Stops the threads and frees the voices. <br>
+ * @param x A pointer the phase_shaper_voices_tilde object <br>
+ */
+void phase_shaper_voices_tilde_free(phase_shaper_voices_tilde *x){
+    for (int v = 1; v < x->nVoices; v++)
+        inlet_free(x->inlets[v]);
+
+    for (int v = 0; v < x->nVoices; v++)
+        outlet_free(x->outlets[v]);
+
+    phase_shaper_voices_free(x->p_voices);
+
+    vas_mem_free(x->copies);
+    vas_mem_free(x->out);
+    vas_mem_free(x->in);
+    vas_mem_free(x->signals);
+    vas_mem_free(x->outlets);
+    vas_mem_free(x->inlets);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Creates a new phase_shaper_voices_tilde object <br>
+ * @param voices The amount of voices (1 - 256), defaults to 8 <br>
+ * @param threads The amount of threads, 0 for one per cpu core <br>
+ * @param maxFilters The amount of stages reserved up front for every voice, defaults to PHASE_SHAPER_META_MAX_FILTERS, the pools grow on demand <br>
+ * @returns an instance of the phase_shaper_voices_tilde object <br>
+ */
+void *phase_shaper_voices_tilde_new(t_floatarg voices, t_floatarg threads, t_floatarg maxFilters){
+    phase_shaper_voices_tilde *x = (phase_shaper_voices_tilde *)pd_new(phase_shaper_voices_tilde_class);
+
+    x->nVoices = (int) voices;
+    if (x->nVoices < 1)
+        x->nVoices = 8;
+    if (x->nVoices > PHASE_SHAPER_VOICES_TILDE_MAX_VOICES)
+        x->nVoices = PHASE_SHAPER_VOICES_TILDE_MAX_VOICES;
+
+    x->inlets = (t_inlet **) vas_mem_alloc(x->nVoices * sizeof(t_inlet *));
+    x->outlets = (t_outlet **) vas_mem_alloc(x->nVoices * sizeof(t_outlet *));
+    x->signals = (t_sample **) vas_mem_alloc(x->nVoices * sizeof(t_sample *));
+    x->in = (t_sample **) vas_mem_alloc(x->nVoices * sizeof(t_sample *));
+    x->out = (t_sample **) vas_mem_alloc(x->nVoices * sizeof(t_sample *));
+    x->copies = NULL;
+    x->vectorSize = 0;
+
+    for (int v = 1; v < x->nVoices; v++)
+        x->inlets[v] = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+
+    for (int v = 0; v < x->nVoices; v++)
+        x->outlets[v] = outlet_new(&x->x_obj, &s_signal);
+
+    x->p_voices = phase_shaper_voices_new(x->nVoices, 1, (int) maxFilters, (int) threads, sys_getsr());
+
+    return (void *)x;
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Applies a setter to all voices or to the voice given as first argument. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector of the message, for the error message <br>
+ * @param argc The amount of arguments, 1 or 2 <br>
+ * @param argv The value, or the voice index and the value <br>
+ * @param setter The phase_shaper_meta setter <br>
+ */
+static void phase_shaper_voices_tilde_forward(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv,
+                                              void (*setter)(phase_shaper_meta *, float)){
+    if (argc == 1) {
+        for (int v = 0; v < x->nVoices; v++)
+            setter(phase_shaper_voices_get(x->p_voices, v), atom_getfloat(argv));
+    }
+    else if (argc == 2 && phase_shaper_voices_get(x->p_voices, (int) atom_getfloat(argv)) != NULL)
+        setter(phase_shaper_voices_get(x->p_voices, (int) atom_getfloat(argv)), atom_getfloat(argv + 1));
+    else
+        pd_error(x, "phase_shaper_voices~: %s expects a value or a voice index (0 - %d) and a value", s->s_name, x->nVoices - 1);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Sets the frequency adjustment parameter. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv The frequency, or a voice index and the frequency <br>
+ */
+void phase_shaper_voices_tilde_setFrequency(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_meta_setFrequency);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Sets the Q factor adjustment parameter. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv The q factor, or a voice index and the q factor <br>
+ */
+void phase_shaper_voices_tilde_setQ(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_meta_setQ);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Prepares a voice for a filter count and sets it. <br>
+ * @param voice The phase_shaper_meta object of the voice <br>
+ * @param nFilters The filter count <br>
+ */
+static void phase_shaper_voices_tilde_filterCount(phase_shaper_meta *voice, float nFilters){
+    phase_shaper_meta_prepare(voice, nFilters);
+    phase_shaper_meta_setFilterCount(voice, nFilters);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Sets the filter count parameter. <br>
+ * The stage pools grow on demand, counts outside 1 - PHASE_SHAPER_META_FILTER_LIMIT are clamped. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv The filter count, or a voice index and the filter count <br>
+ */
+void phase_shaper_voices_tilde_setFilterCount(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    const float nFilters = argc > 0 ? atom_getfloat(argv + argc - 1) : 1;
+
+    if (nFilters < 1 || nFilters > PHASE_SHAPER_META_FILTER_LIMIT)
+        pd_error(x, "phase_shaper_voices~: filtercount %g clamped to 1 - %d", nFilters, PHASE_SHAPER_META_FILTER_LIMIT);
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_voices_tilde_filterCount);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Sets the Dry-Wet Mix adjustment parameter. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv The mix, or a voice index and the mix <br>
+ */
+void phase_shaper_voices_tilde_setMix(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_meta_setMix);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Sets the spread parameter. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv The spread in octaves, or a voice index and the spread <br>
+ */
+void phase_shaper_voices_tilde_setSpread(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_meta_setSpread);
+}
+
+// the float setter forwarded by the globalmix message
+static void phase_shaper_voices_tilde_mixMode(phase_shaper_meta *voice, float global){
+    phase_shaper_meta_setMixMode(voice, global != 0 ? PHASE_SHAPER_META_MIX_GLOBAL : PHASE_SHAPER_META_MIX_STAGES);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Selects where the dry-wet mix is applied. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv 1 to mix once at the output or 0 to mix inside every stage, or a voice index and the flag <br>
+ */
+void phase_shaper_voices_tilde_setMixMode(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_voices_tilde_mixMode);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Sets the distribution of the spread stages. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv The curve, or a voice index and the curve <br>
+ */
+void phase_shaper_voices_tilde_setCurve(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_meta_setCurve);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Sets the ramp time of the frequency, Q and mix messages. <br>
+ * @param x A pointer to the phase_shaper_voices_tilde object <br>
+ * @param s The selector <br>
+ * @param argc The amount of arguments <br>
+ * @param argv The ramp time in milliseconds, or a voice index and the ramp time <br>
+ */
+void phase_shaper_voices_tilde_setRampTime(phase_shaper_voices_tilde *x, t_symbol *s, int argc, t_atom *argv){
+    phase_shaper_voices_tilde_forward(x, s, argc, argv, phase_shaper_meta_setRampTime);
+}
+
+/**
+ * @related phase_shaper_voices_tilde
+ * @brief Setup for the phase_shaper_voices_tilde class <br>
+ */
+void phase_shaper_voices_tilde_setup(void){
+      phase_shaper_voices_tilde_class = class_new(gensym("phase_shaper_voices~"),
+            (t_newmethod)phase_shaper_voices_tilde_new,
+            (t_method)phase_shaper_voices_tilde_free,
+            sizeof(phase_shaper_voices_tilde),
+            CLASS_DEFAULT,
+            A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_dsp, gensym("dsp"), 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setFrequency, gensym("freq"), A_GIMME, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setQ, gensym("q"), A_GIMME, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setFilterCount, gensym("filtercount"), A_GIMME, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setMix, gensym("mix"), A_GIMME, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setSpread, gensym("spread"), A_GIMME, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setCurve, gensym("curve"), A_GIMME, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setMixMode, gensym("globalmix"), A_GIMME, 0);
+
+      class_addmethod(phase_shaper_voices_tilde_class, (t_method)phase_shaper_voices_tilde_setRampTime, gensym("smooth"), A_GIMME, 0);
+
+      CLASS_MAINSIGNALIN(phase_shaper_voices_tilde_class, phase_shaper_voices_tilde, f);
+}
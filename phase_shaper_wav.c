@@ -0,0 +1,345 @@
+#include "phase_shaper_wav.h"
+#include "vas_mem.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PHASE_SHAPER_WAV_EXTENSIBLE 0xFFFE
+#define PHASE_SHAPER_WAV_HEADER 44
+
+
+static unsigned int phase_shaper_wav_get16(const unsigned char *p){
+    return p[0] | (p[1] << 8);
+}
+
+
+static unsigned int phase_shaper_wav_get32(const unsigned char *p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+
+static void phase_shaper_wav_put16(unsigned char *p, unsigned int value){
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+}
+
+
+static void phase_shaper_wav_put32(unsigned char *p, unsigned int value){
+    phase_shaper_wav_put16(p, value & 0xFFFF);
+    phase_shaper_wav_put16(p + 2, value >> 16);
+}
+
+
+static int phase_shaper_wav_map(phase_shaper_wav *x, const char *path){
+
+#ifdef _WIN32
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER size;
+
+    if (file == INVALID_HANDLE_VALUE)
+        return -1;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return -1;
+    }
+
+    x->handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (x->handle == NULL)
+        return -1;
+
+    x->mapping = MapViewOfFile(x->handle, FILE_MAP_READ, 0, 0, 0);
+    if (x->mapping == NULL) {
+        CloseHandle(x->handle);
+        return -1;
+    }
+
+    x->mappingSize = (size_t) size.QuadPart;
+    return 0;
+
+#else
+
+    struct stat status;
+    const int file = open(path, O_RDONLY);
+
+    if (file < 0)
+        return -1;
+
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        close(file);
+        return -1;
+    }
+
+    x->mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (x->mapping == MAP_FAILED) {
+        x->mapping = NULL;
+        return -1;
+    }
+
+    // the file is read front to back exactly once
+    madvise(x->mapping, (size_t) status.st_size, MADV_SEQUENTIAL);
+
+    x->handle = NULL;
+    x->mappingSize = (size_t) status.st_size;
+    return 0;
+
+#endif
+}
+
+
+int phase_shaper_wav_open(phase_shaper_wav *x, const char *path){
+
+    const unsigned char *p, *end;
+    int haveFormat = 0;
+
+    memset(x, 0, sizeof(phase_shaper_wav));
+
+    if (phase_shaper_wav_map(x, path) != 0) {
+        fprintf(stderr, "%s: cannot map file\n", path);
+        return -1;
+    }
+
+    p = (const unsigned char *) x->mapping;
+    end = p + x->mappingSize;
+
+    if (x->mappingSize < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        phase_shaper_wav_close(x);
+        return -1;
+    }
+
+    // walk the chunks, they are padded to even sizes
+    for (p += 12; end - p >= 8; ) {
+        const size_t size = phase_shaper_wav_get32(p + 4);
+        const unsigned char *body = p + 8;
+
+        if (memcmp(p, "fmt ", 4) == 0 && size >= 16 && (size_t) (end - body) >= size) {
+            x->format = phase_shaper_wav_get16(body);
+            x->nChannels = phase_shaper_wav_get16(body + 2);
+            x->sampleRate = (int) phase_shaper_wav_get32(body + 4);
+            x->bitsPerSample = phase_shaper_wav_get16(body + 14);
+            if (x->format == PHASE_SHAPER_WAV_EXTENSIBLE && size >= 26)
+                x->format = phase_shaper_wav_get16(body + 24);
+            haveFormat = 1;
+        }
+        else if (memcmp(p, "data", 4) == 0 && haveFormat) {
+            const size_t available = (size_t) (end - body) < size ? (size_t) (end - body) : size;
+            const int frameSize = x->nChannels * x->bitsPerSample / 8;
+
+            if (frameSize <= 0)
+                break;
+
+            x->data = body;
+            x->nFrames = (long) (available / frameSize);
+            break;
+        }
+
+        if ((size_t) (end - body) < size + (size & 1))
+            break;
+        p = body + size + (size & 1);
+    }
+
+    if (x->data == NULL || x->nChannels < 1
+        || !((x->format == PHASE_SHAPER_WAV_PCM && (x->bitsPerSample == 16 || x->bitsPerSample == 24 || x->bitsPerSample == 32))
+             || (x->format == PHASE_SHAPER_WAV_FLOAT && x->bitsPerSample == 32))) {
+        fprintf(stderr, "%s: unsupported WAV format\n", path);
+        phase_shaper_wav_close(x);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void phase_shaper_wav_read(const phase_shaper_wav *x, long firstFrame, int nFrames, float **channels){
+
+    const int bytes = x->bitsPerSample / 8;
+    const unsigned char *p = x->data + (size_t) firstFrame * x->nChannels * bytes;
+
+    for (int i = 0; i < nFrames; i++) {
+        for (int c = 0; c < x->nChannels; c++, p += bytes) {
+            float value;
+
+            if (x->format == PHASE_SHAPER_WAV_FLOAT) {
+                const unsigned int bits = phase_shaper_wav_get32(p);
+                memcpy(&value, &bits, sizeof(float));
+            }
+            else if (bytes == 2)
+                value = (short) phase_shaper_wav_get16(p) * (1.0f / 32768);
+            else if (bytes == 3)
+                value = (int) (((unsigned int) p[0] << 8) | ((unsigned int) p[1] << 16) | ((unsigned int) p[2] << 24)) * (1.0f / 2147483648.0f);
+            else
+                value = (int) phase_shaper_wav_get32(p) * (1.0f / 2147483648.0f);
+
+            channels[c][i] = value;
+        }
+    }
+}
+
+
+void phase_shaper_wav_close(phase_shaper_wav *x){
+
+    if (x->mapping == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(x->mapping);
+    CloseHandle(x->handle);
+#else
+    munmap(x->mapping, x->mappingSize);
+#endif
+
+    x->mapping = NULL;
+    x->data = NULL;
+}
+
+
+static void phase_shaper_wav_header(phase_shaper_wav_writer *x, unsigned char *header, int sampleRate){
+
+    const int frameSize = x->nChannels * x->bitsPerSample / 8;
+    const unsigned long dataSize = (unsigned long) x->nFrames * frameSize;
+
+    memcpy(header, "RIFF", 4);
+    phase_shaper_wav_put32(header + 4, (unsigned int) (PHASE_SHAPER_WAV_HEADER - 8 + dataSize));
+    memcpy(header + 8, "WAVEfmt ", 8);
+    phase_shaper_wav_put32(header + 16, 16);
+    phase_shaper_wav_put16(header + 20, x->format);
+    phase_shaper_wav_put16(header + 22, x->nChannels);
+    phase_shaper_wav_put32(header + 24, sampleRate);
+    phase_shaper_wav_put32(header + 28, sampleRate * frameSize);
+    phase_shaper_wav_put16(header + 32, frameSize);
+    phase_shaper_wav_put16(header + 34, x->bitsPerSample);
+    memcpy(header + 36, "data", 4);
+    phase_shaper_wav_put32(header + 40, (unsigned int) dataSize);
+}
+
+
+int phase_shaper_wav_create(phase_shaper_wav_writer *x, const char *path, int nChannels, int sampleRate, int format, int bitsPerSample){
+
+    unsigned char header[PHASE_SHAPER_WAV_HEADER];
+
+    memset(x, 0, sizeof(phase_shaper_wav_writer));
+
+    x->nChannels = nChannels;
+    x->format = format;
+    x->bitsPerSample = format == PHASE_SHAPER_WAV_FLOAT ? 32 : bitsPerSample;
+
+    if (nChannels < 1 || (x->bitsPerSample != 16 && x->bitsPerSample != 24 && x->bitsPerSample != 32)) {
+        fprintf(stderr, "%s: unsupported output format\n", path);
+        return -1;
+    }
+
+    x->file = fopen(path, "wb");
+    if (x->file == NULL) {
+        fprintf(stderr, "%s: cannot create file\n", path);
+        return -1;
+    }
+
+    // the sample rate stays in the header, the sizes are patched by finish
+    phase_shaper_wav_header(x, header, sampleRate);
+    if (fwrite(header, 1, sizeof(header), x->file) != sizeof(header)) {
+        fprintf(stderr, "%s: write failed\n", path);
+        fclose(x->file);
+        x->file = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int phase_shaper_wav_write(phase_shaper_wav_writer *x, float **channels, int nFrames){
+
+    const int bytes = x->bitsPerSample / 8;
+    const size_t size = (size_t) nFrames * x->nChannels * bytes;
+    const double fullScale = (double) (1u << (x->bitsPerSample - 1));
+    unsigned char *p;
+
+    if (nFrames > x->bufferFrames) {
+        vas_mem_free(x->buffer);
+        x->buffer = (unsigned char *) vas_mem_alloc((long) size);
+        x->bufferFrames = nFrames;
+    }
+
+    p = x->buffer;
+    for (int i = 0; i < nFrames; i++) {
+        for (int c = 0; c < x->nChannels; c++, p += bytes) {
+            float value = channels[c][i];
+            double scaled;
+            unsigned int sample;
+
+            if (x->format == PHASE_SHAPER_WAV_FLOAT) {
+                unsigned int bits;
+                memcpy(&bits, &value, sizeof(float));
+                phase_shaper_wav_put32(p, bits);
+                continue;
+            }
+
+            // the inverse of the scaling in phase_shaper_wav_read, clipped to the integer range
+            scaled = value * fullScale;
+            scaled = scaled < 0 ? scaled - 0.5 : scaled + 0.5;
+            if (scaled >= fullScale)
+                scaled = fullScale - 1;
+            else if (scaled <= -fullScale)
+                scaled = -fullScale;
+            sample = (unsigned int) (int) scaled;
+
+            if (bytes == 2)
+                phase_shaper_wav_put16(p, sample);
+            else if (bytes == 3) {
+                p[0] = sample & 0xFF;
+                p[1] = (sample >> 8) & 0xFF;
+                p[2] = (sample >> 16) & 0xFF;
+            }
+            else
+                phase_shaper_wav_put32(p, sample);
+        }
+    }
+
+    if (fwrite(x->buffer, 1, size, x->file) != size) {
+        fprintf(stderr, "write failed\n");
+        return -1;
+    }
+
+    x->nFrames += nFrames;
+    return 0;
+}
+
+
+int phase_shaper_wav_finish(phase_shaper_wav_writer *x){
+
+    unsigned char sizes[4];
+    const unsigned long dataSize = (unsigned long) x->nFrames * x->nChannels * (x->bitsPerSample / 8);
+    int result = 0;
+
+    if (x->file == NULL)
+        return -1;
+
+    phase_shaper_wav_put32(sizes, (unsigned int) (PHASE_SHAPER_WAV_HEADER - 8 + dataSize));
+    if (fseek(x->file, 4, SEEK_SET) != 0 || fwrite(sizes, 1, 4, x->file) != 4)
+        result = -1;
+
+    phase_shaper_wav_put32(sizes, (unsigned int) dataSize);
+    if (fseek(x->file, 40, SEEK_SET) != 0 || fwrite(sizes, 1, 4, x->file) != 4)
+        result = -1;
+
+    if (fclose(x->file) != 0)
+        result = -1;
+    if (result != 0)
+        fprintf(stderr, "finishing the WAV file failed\n");
+
+    vas_mem_free(x->buffer);
+    x->buffer = NULL;
+    x->file = NULL;
+    return result;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file phase_shaper_wav.h
+ * @author Arne Kuhle
+ * @date 17 Oct 2026
+ * @brief Minimal WAV file access for the offline tools of phase_shaper
+ *
+ * Input files are memory mapped and converted block by block, output files are streamed and their sizes patched on close. <br>
+ * Supported are 16, 24 and 32 bit integer PCM and 32 bit float, plain or WAVE_FORMAT_EXTENSIBLE, with any amount of channels. <br>
+ * All functions return 0 on success and -1 on failure, a description of the failure is printed to stderr. <br>
+ */
+
+#ifndef phase_shaper_wav_h
+#define phase_shaper_wav_h
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Sample format of integer PCM files */
+#define PHASE_SHAPER_WAV_PCM 1
+/** @brief Sample format of IEEE float files */
+#define PHASE_SHAPER_WAV_FLOAT 3
+
+/**
+ * @struct phase_shaper_wav
+ * @brief A memory mapped WAV file opened for reading <br>
+ */
+typedef struct phase_shaper_wav{
+    int nChannels; /**< The amount of interleaved channels */
+    int sampleRate; /**< The sample rate in Hz */
+    int format; /**< PHASE_SHAPER_WAV_PCM or PHASE_SHAPER_WAV_FLOAT */
+    int bitsPerSample; /**< 16, 24 or 32 */
+    long nFrames; /**< The amount of frames in the data chunk */
+    const unsigned char *data; /**< The first byte of the data chunk inside the mapping */
+    void *mapping; /**< The start of the mapped file */
+    size_t mappingSize; /**< The size of the mapped file in bytes */
+    void *handle; /**< Platform handle of the mapping, unused on POSIX */
+} phase_shaper_wav;
+
+/**
+ * @struct phase_shaper_wav_writer
+ * @brief A WAV file opened for streaming output <br>
+ */
+typedef struct phase_shaper_wav_writer{
+    FILE *file; /**< The output file */
+    int nChannels; /**< The amount of interleaved channels */
+    int format; /**< PHASE_SHAPER_WAV_PCM or PHASE_SHAPER_WAV_FLOAT */
+    int bitsPerSample; /**< 16, 24 or 32 */
+    long nFrames; /**< The amount of frames written so far */
+    unsigned char *buffer; /**< Conversion buffer of one block */
+    long bufferFrames; /**< Capacity of the conversion buffer in frames */
+} phase_shaper_wav_writer;
+
+/**
+ * @related phase_shaper_wav
+ * @brief Maps a WAV file and parses its header <br>
+ * @param x The file to fill in <br>
+ * @param path The path of the file <br>
+ * @returns 0 on success, -1 on failure <br>
+ */
+int phase_shaper_wav_open(phase_shaper_wav *x, const char *path);
+
+/**
+ * @related phase_shaper_wav
+ * @brief Converts frames of the file to float, one vector per channel <br>
+ * @param x The file <br>
+ * @param firstFrame The first frame to read <br>
+ * @param nFrames The amount of frames, must not exceed the end of the file <br>
+ * @param channels nChannels vectors receiving nFrames samples each <br>
+ */
+void phase_shaper_wav_read(const phase_shaper_wav *x, long firstFrame, int nFrames, float **channels);
+
+/**
+ * @related phase_shaper_wav
+ * @brief Unmaps the file <br>
+ * @param x The file <br>
+ */
+void phase_shaper_wav_close(phase_shaper_wav *x);
+
+/**
+ * @related phase_shaper_wav_writer
+ * @brief Creates a WAV file and writes a header with empty sizes <br>
+ * @param x The writer to fill in <br>
+ * @param path The path of the file <br>
+ * @param nChannels The amount of channels <br>
+ * @param sampleRate The sample rate in Hz <br>
+ * @param format PHASE_SHAPER_WAV_PCM or PHASE_SHAPER_WAV_FLOAT <br>
+ * @param bitsPerSample 16, 24 or 32, float files always use 32 <br>
+ * @returns 0 on success, -1 on failure <br>
+ */
+int phase_shaper_wav_create(phase_shaper_wav_writer *x, const char *path, int nChannels, int sampleRate, int format, int bitsPerSample);
+
+/**
+ * @related phase_shaper_wav_writer
+ * @brief Appends frames to the file, integer formats are clipped to [-1, 1] <br>
+ * @param x The writer <br>
+ * @param channels nChannels vectors holding nFrames samples each <br>
+ * @param nFrames The amount of frames <br>
+ * @returns 0 on success, -1 on failure <br>
+ */
+int phase_shaper_wav_write(phase_shaper_wav_writer *x, float **channels, int nFrames);
+
+/**
+ * @related phase_shaper_wav_writer
+ * @brief Patches the sizes in the header and closes the file <br>
+ * @param x The writer <br>
+ * @returns 0 on success, -1 on failure <br>
+ */
+int phase_shaper_wav_finish(phase_shaper_wav_writer *x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
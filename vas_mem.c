@@ -1,69 +1,400 @@
-
 #ifndef vas_memory_c
 #define vas_memory_c
 
 #include "vas_mem.h"
+#include <stdint.h>
 
-void *vas_mem_alloc(long size)
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define VAS_MEM_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define VAS_MEM_PAUSE() __asm__ __volatile__("yield")
+#else
+#define VAS_MEM_PAUSE()
+#endif
+
+#define VAS_MEM_STEPS 8 /* size classes per power of two, a block wastes at most an eighth */
+#define VAS_MEM_CLASSES (10 * VAS_MEM_STEPS + 1) /* 128 bytes to 128 kilobytes */
+#define VAS_MEM_LARGE -1
+#define VAS_MEM_SPINS 64 /* busy waits before the lock gives up the time slice */
+
+/* precedes every block, one cache line so the block stays aligned */
+typedef union vas_mem_header
 {
-    
-#ifdef MAXMSPSDK
-    
-    return sysmem_newptrclear(size);
+    struct
+    {
+        void *base; /* start of the system allocation of a large block, NULL for a carved block */
+        long size; /* requested size */
+        long alignment;
+        long blockSize; /* bytes carved for the block including this header, at least its class size */
+    } info;
+    char padding[VAS_MEM_ALIGNMENT];
+} vas_mem_header;
 
-#elif defined(PUREDATA)
-    
-    return malloc(size);
-    
+/* a free block keeps the link to the next one in its payload */
+typedef struct vas_mem_freeBlock
+{
+    struct vas_mem_freeBlock *next;
+} vas_mem_freeBlock;
+
+/* precedes every chunk, links all chunks for the release */
+typedef union vas_mem_chunk
+{
+    struct
+    {
+        union vas_mem_chunk *next;
+        void *base;
+    } info;
+    char padding[VAS_MEM_ALIGNMENT];
+} vas_mem_chunk;
+
+static struct
+{
+    vas_mem_freeBlock *freeList[VAS_MEM_CLASSES];
+    char *carve; /* untouched rest of the newest chunk, shared by all size classes */
+    char *carveEnd;
+    vas_mem_chunk *chunks;
+    vas_mem_stats stats;
+    volatile int lock;
+} vas_mem_arena;
+
+static void vas_mem_lock(void)
+{
+    int spins = 0;
+
+#ifdef _MSC_VER
+    while(_InterlockedExchange((volatile long *) &vas_mem_arena.lock, 1))
+    {
+        while(vas_mem_arena.lock)
 #else
-    
-    return malloc(size);
-    
+    while(__atomic_exchange_n(&vas_mem_arena.lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while(__atomic_load_n(&vas_mem_arena.lock, __ATOMIC_RELAXED))
 #endif
-    
+        {
+            /* the holder never calls the system while it keeps the lock, a short wait is the common case */
+            if(spins++ < VAS_MEM_SPINS)
+                VAS_MEM_PAUSE();
+            else
+#ifdef _WIN32
+                SwitchToThread();
+#else
+                sched_yield();
+#endif
+        }
+    }
 }
 
-void *vas_mem_resize(void *ptr, long size)
+static void vas_mem_unlock(void)
 {
-    
+#ifdef _MSC_VER
+    _InterlockedExchange((volatile long *) &vas_mem_arena.lock, 0);
+#else
+    __atomic_store_n(&vas_mem_arena.lock, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+static void *vas_mem_systemAlloc(long size)
+{
+
 #ifdef MAXMSPSDK
-    
-    return sysmem_resizeptrclear(ptr, size);
-    
-#elif defined(PUREDATA)
 
-    void *tmp = realloc(ptr, size);
-    memset(tmp, 0, size);
-    return tmp;
+    return sysmem_newptr(size);
 
-    
 #else
 
-    void *tmp = realloc(ptr, size);
-    memset(tmp, 0, size);
-    return tmp;
- 
+    return malloc(size);
+
 #endif
-    
+
 }
 
-void vas_mem_free(void *ptr)
+static void vas_mem_systemFree(void *ptr)
 {
-    
+
 #ifdef MAXMSPSDK
-    if(ptr)
-        sysmem_freeptr(ptr);
-    
-#elif defined(PUREDATA)
-    if(ptr)
-        free(ptr);
-    
+
+    sysmem_freeptr(ptr);
+
 #else
-    if(ptr)
-        free(ptr);
-    
+
+    free(ptr);
+
 #endif
-    
+
+}
+
+static char *vas_mem_alignUp(char *ptr, long alignment)
+{
+    return (char *) (((uintptr_t) ptr + alignment - 1) & ~(uintptr_t) (alignment - 1));
+}
+
+static long vas_mem_classSize(int sizeClass)
+{
+    const long base = (long) VAS_MEM_MIN_CLASS_SIZE << (sizeClass / VAS_MEM_STEPS);
+    const long size = base + sizeClass % VAS_MEM_STEPS * base / VAS_MEM_STEPS;
+
+    /* the small classes round up to a cache line, neighbours may coincide */
+    return (size + VAS_MEM_ALIGNMENT - 1) & ~(long) (VAS_MEM_ALIGNMENT - 1);
+}
+
+/* the smallest class holding size bytes including the header, VAS_MEM_LARGE if none does */
+static int vas_mem_sizeClass(long size)
+{
+    int sizeClass = 0;
+
+    while(sizeClass < VAS_MEM_CLASSES && vas_mem_classSize(sizeClass) < size)
+        sizeClass++;
+
+    return sizeClass < VAS_MEM_CLASSES ? sizeClass : VAS_MEM_LARGE;
+}
+
+/* the largest class a block of blockSize bytes can serve */
+static int vas_mem_floorClass(long blockSize)
+{
+    const int sizeClass = vas_mem_sizeClass(blockSize);
+
+    if(sizeClass == VAS_MEM_LARGE)
+        return VAS_MEM_CLASSES - 1;
+
+    return vas_mem_classSize(sizeClass) > blockSize ? sizeClass - 1 : sizeClass;
+}
+
+/* called with the lock held */
+static void vas_mem_pushFree(vas_mem_header *header, long blockSize)
+{
+    vas_mem_freeBlock *block = (vas_mem_freeBlock *) (header + 1);
+    const int sizeClass = vas_mem_floorClass(blockSize);
+
+    header->info.base = NULL;
+    header->info.blockSize = blockSize;
+    block->next = vas_mem_arena.freeList[sizeClass];
+    vas_mem_arena.freeList[sizeClass] = block;
+}
+
+/* called with the lock held, NULL if the arena needs another chunk */
+static vas_mem_header *vas_mem_takeBlock(int sizeClass)
+{
+    const long classSize = vas_mem_classSize(sizeClass);
+    vas_mem_freeBlock *block = vas_mem_arena.freeList[sizeClass];
+    vas_mem_header *header;
+
+    if(block)
+    {
+        vas_mem_arena.freeList[sizeClass] = block->next;
+        return (vas_mem_header *) block - 1;
+    }
+
+    if(vas_mem_arena.carveEnd - vas_mem_arena.carve < classSize)
+        return NULL;
+
+    header = (vas_mem_header *) vas_mem_arena.carve;
+    header->info.blockSize = classSize;
+    vas_mem_arena.carve += classSize;
+    return header;
+}
+
+/* called without the lock */
+static vas_mem_chunk *vas_mem_newChunk(void)
+{
+    void *base = vas_mem_systemAlloc(VAS_MEM_CHUNK_SIZE + sizeof(vas_mem_chunk) + VAS_MEM_ALIGNMENT);
+    vas_mem_chunk *chunk;
+
+    if(!base)
+        return NULL;
+
+    chunk = (vas_mem_chunk *) vas_mem_alignUp((char *) base, VAS_MEM_ALIGNMENT);
+    chunk->info.base = base;
+    return chunk;
+}
+
+/* called with the lock held, the rest of the previous chunk goes to the free lists */
+static void vas_mem_addChunk(vas_mem_chunk *chunk)
+{
+    if(vas_mem_arena.carveEnd - vas_mem_arena.carve >= VAS_MEM_MIN_CLASS_SIZE)
+        vas_mem_pushFree((vas_mem_header *) vas_mem_arena.carve, (long) (vas_mem_arena.carveEnd - vas_mem_arena.carve));
+
+    chunk->info.next = vas_mem_arena.chunks;
+    vas_mem_arena.chunks = chunk;
+    vas_mem_arena.stats.bytesReserved += VAS_MEM_CHUNK_SIZE + sizeof(vas_mem_chunk) + VAS_MEM_ALIGNMENT;
+
+    vas_mem_arena.carve = (char *) (chunk + 1);
+    vas_mem_arena.carveEnd = (char *) (chunk + 1) + VAS_MEM_CHUNK_SIZE;
+}
+
+/* called with the lock held once no block is alive, returns the chunks for vas_mem_releaseChunks */
+static vas_mem_chunk *vas_mem_detachChunks(void)
+{
+    vas_mem_chunk *chunks = vas_mem_arena.chunks;
+
+    memset(vas_mem_arena.freeList, 0, sizeof(vas_mem_arena.freeList));
+    vas_mem_arena.carve = vas_mem_arena.carveEnd = NULL;
+    vas_mem_arena.chunks = NULL;
+    vas_mem_arena.stats.bytesReserved = 0;
+
+    return chunks;
+}
+
+/* called without the lock */
+static void vas_mem_releaseChunks(vas_mem_chunk *chunk)
+{
+    while(chunk)
+    {
+        vas_mem_chunk *next = chunk->info.next;
+        vas_mem_systemFree(chunk->info.base);
+        chunk = next;
+    }
+}
+
+void *vas_mem_alignedAlloc(long size, long alignment)
+{
+    vas_mem_header *header;
+    int sizeClass;
+
+    if(size < 0)
+        return NULL;
+
+    if(alignment < VAS_MEM_ALIGNMENT)
+        alignment = VAS_MEM_ALIGNMENT;
+
+    sizeClass = alignment > VAS_MEM_ALIGNMENT ? VAS_MEM_LARGE : vas_mem_sizeClass(size + (long) sizeof(vas_mem_header));
+
+    if(sizeClass == VAS_MEM_LARGE)
+    {
+        const long reserved = size + (long) sizeof(vas_mem_header) + alignment;
+        void *base = vas_mem_systemAlloc(reserved);
+
+        if(!base)
+            return NULL;
+
+        header = (vas_mem_header *) vas_mem_alignUp((char *) base + sizeof(vas_mem_header), alignment) - 1;
+        header->info.base = base;
+        header->info.blockSize = 0;
+
+        vas_mem_lock();
+        vas_mem_arena.stats.bytesReserved += reserved;
+    }
+    else
+    {
+        vas_mem_lock();
+
+        /* the lock is dropped while the system hands out a chunk, another thread may have refilled the arena meanwhile */
+        while(!(header = vas_mem_takeBlock(sizeClass)))
+        {
+            vas_mem_chunk *chunk;
+
+            vas_mem_unlock();
+            chunk = vas_mem_newChunk();
+
+            if(!chunk)
+                return NULL;
+
+            vas_mem_lock();
+            vas_mem_addChunk(chunk);
+        }
+
+        header->info.base = NULL;
+    }
+
+    header->info.size = size;
+    header->info.alignment = alignment;
+
+    vas_mem_arena.stats.bytesInUse += size;
+    if(vas_mem_arena.stats.bytesInUse > vas_mem_arena.stats.peakBytesInUse)
+        vas_mem_arena.stats.peakBytesInUse = vas_mem_arena.stats.bytesInUse;
+    vas_mem_arena.stats.allocations++;
+    vas_mem_arena.stats.totalAllocations++;
+
+    vas_mem_unlock();
+
+    memset(header + 1, 0, size);
+    return header + 1;
+}
+
+void *vas_mem_alloc(long size)
+{
+    return vas_mem_alignedAlloc(size, VAS_MEM_ALIGNMENT);
+}
+
+void *vas_mem_resize(void *ptr, long size)
+{
+    vas_mem_header *header;
+    void *tmp;
+
+    if(!ptr)
+        return vas_mem_alloc(size);
+
+    header = (vas_mem_header *) ptr - 1;
+
+    // the block is still large enough, no need to move it
+    if(!header->info.base && size >= 0 && size <= header->info.blockSize - (long) sizeof(vas_mem_header))
+    {
+        if(size > header->info.size)
+            memset((char *) ptr + header->info.size, 0, size - header->info.size);
+
+        vas_mem_lock();
+        vas_mem_arena.stats.bytesInUse += size - header->info.size;
+        if(vas_mem_arena.stats.bytesInUse > vas_mem_arena.stats.peakBytesInUse)
+            vas_mem_arena.stats.peakBytesInUse = vas_mem_arena.stats.bytesInUse;
+        vas_mem_unlock();
+
+        header->info.size = size;
+        return ptr;
+    }
+
+    tmp = vas_mem_alignedAlloc(size, header->info.alignment);
+
+    if(!tmp)
+        return NULL;
+
+    memcpy(tmp, ptr, size < header->info.size ? size : header->info.size);
+    vas_mem_free(ptr);
+    return tmp;
+}
+
+void vas_mem_free(void *ptr)
+{
+    vas_mem_header *header;
+    vas_mem_chunk *released = NULL;
+    void *base;
+
+    if(!ptr)
+        return;
+
+    header = (vas_mem_header *) ptr - 1;
+    base = header->info.base;
+
+    vas_mem_lock();
+
+    vas_mem_arena.stats.bytesInUse -= header->info.size;
+    vas_mem_arena.stats.allocations--;
+
+    if(base)
+        vas_mem_arena.stats.bytesReserved -= header->info.size + (long) sizeof(vas_mem_header) + header->info.alignment;
+    else
+        vas_mem_pushFree(header, header->info.blockSize);
+
+    if(vas_mem_arena.stats.allocations == 0)
+        released = vas_mem_detachChunks();
+
+    vas_mem_unlock();
+
+    if(base)
+        vas_mem_systemFree(base);
+    vas_mem_releaseChunks(released);
+}
+
+void vas_mem_getStats(vas_mem_stats *stats)
+{
+    vas_mem_lock();
+    *stats = vas_mem_arena.stats;
+    vas_mem_unlock();
 }
 
 #endif
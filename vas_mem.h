@@ -9,6 +9,11 @@
  * @details Wrapper for memory allocation <br>
  * Max/MSP SDK suggests using the Max/MSP "sysmem_" - routines instead of malloc/calloc/free. <br>
  * So for Max/MSP define the Preprocessor macro "MAXMSPSDK". <br>
+ * <br>
+ * All instances of a library share one arena. Small blocks come in eight size classes per power of two, carved from chunks
+ * shared by all classes and recycled through free lists. Blocks above VAS_MEM_MAX_CLASS_SIZE come from the system directly,
+ * as do the chunks, neither is requested while the arena is locked. <br>
+ * Every block starts on a cache line and is cleared. The chunks are returned to the system when the last block is freed. <br>
  */
 
 #ifndef vas_memory_h
@@ -25,16 +30,70 @@
 #include "ext_obex.h"
 #endif
 
+/** @brief Alignment of every block in bytes, one cache line */
+#define VAS_MEM_ALIGNMENT 64
+
+/** @brief Size of the smallest block in bytes, including the block header */
+#define VAS_MEM_MIN_CLASS_SIZE 128
+
+/** @brief Size of the largest carved block in bytes, including the block header */
+#define VAS_MEM_MAX_CLASS_SIZE (128 * 1024)
+
+/** @brief Size of the chunks the blocks are carved from */
+#define VAS_MEM_CHUNK_SIZE (256 * 1024)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Footprint of the arena <br>
+ */
+typedef struct vas_mem_stats
+{
+    long bytesInUse; /**< Bytes requested by all live blocks */
+    long peakBytesInUse; /**< Maximum of bytesInUse since the first allocation */
+    long bytesReserved; /**< Bytes taken from the system, chunks and large blocks */
+    long allocations; /**< Amount of live blocks */
+    long totalAllocations; /**< Amount of allocations since the first allocation */
+} vas_mem_stats;
+
+/**
+ * @brief Allocates a cleared block aligned to VAS_MEM_ALIGNMENT <br>
+ * @param size The size of the block in bytes <br>
+ * @returns The block or NULL <br>
+ */
 void *vas_mem_alloc(long size);
 
+/**
+ * @brief Allocates a cleared block with a custom alignment, e.g. for SIMD state <br>
+ * @param size The size of the block in bytes <br>
+ * @param alignment A power of two, values below VAS_MEM_ALIGNMENT give VAS_MEM_ALIGNMENT <br>
+ * @returns The block or NULL <br>
+ */
+void *vas_mem_alignedAlloc(long size, long alignment);
+
+/**
+ * @brief Resizes a block, keeping its contents and alignment <br>
+ * Grown space is cleared. A block which is still large enough is not moved. <br>
+ * @param ptr The block or NULL <br>
+ * @param size The new size of the block in bytes <br>
+ * @returns The resized block or NULL, in which case ptr is still valid <br>
+ */
 void *vas_mem_resize(void *ptr, long size);
 
+/**
+ * @brief Frees a block of vas_mem_alloc, vas_mem_alignedAlloc or vas_mem_resize <br>
+ * @param ptr The block or NULL <br>
+ */
 void vas_mem_free(void *ptr);
 
+/**
+ * @brief Reports the footprint of the arena <br>
+ * @param stats Receives the current numbers <br>
+ */
+void vas_mem_getStats(vas_mem_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif